@@ -0,0 +1,71 @@
+/**
+ * @file Backlog.h
+ * @brief Store-and-forward ring of the last reported samples, replayed when the host asks for them.
+ *
+ * Every reported sample is also written into a small SRAM ring together with its micros() timestamp and
+ * sequence number (0 for the first reported sample after reset, the live stream carries its low 16 bits).
+ * Nothing extra is sent while the host is listening. A host that was away (restart, port reopened) or
+ * noticed a gap in the sequence numbers sends PACKET_CMD_REPLAY with the (low 16 bits of the) first sequence
+ * it is missing, or without a payload for everything stored, and
+ * the stored samples from there up to the last one reported before the command are sent in PACKET_BACKLOG
+ * chunks next to the live stream.
+ *
+ * Wrap periods:
+ * - time: micros() is 32 bits and wraps every 2^32 us (71.6 min). The host takes the age of a record as the
+ *   chunk time minus the record time, which is only unambiguous below that: the whole ring (BACKLOG_SAMPLES)
+ *   fits in it up to a 134 s sample interval, older records of slower intervals are placed one wrap too late.
+ * - sequence: the live stream and PACKET_CMD_REPLAY carry the low 16 bits, which wrap every 65536 samples
+ *   (9.1 h at the default 500 ms, 65.5 s at the 1 ms minimum interval).
+ *
+ * Record encoding matches the other packets:
+ * - distance: hundredths of a centimeter, 0xFFFF if out of range
+ * - photo: raw ADC value
+ */
+
+#ifndef Backlog_h
+#define Backlog_h
+
+#include <Arduino.h>
+#include "Packet.h"
+
+#ifndef BACKLOG_SAMPLES
+#define BACKLOG_SAMPLES 32 // [samples] 8 bytes each, 16 s at the default 500 ms interval
+#endif
+#define BACKLOG_CHUNK_SAMPLES 5 // Records per PACKET_BACKLOG
+#define BACKLOG_CHUNK_HEADER 8	// device time, first sequence
+
+class Backlog
+{
+public:
+	Backlog();
+
+	void add(uint32_t time, float distance, int photo);
+	void replay();
+	void replay(uint16_t from);
+
+	bool hasPending() const;
+	uint8_t fill(PacketWriter *packet) const;
+	void advance(uint8_t count);
+
+	uint32_t sequence() const;
+	uint32_t oldest() const;
+
+private:
+	typedef struct
+	{
+		uint32_t time;	   // [us] micros() when the sample was taken
+		uint16_t distance; // [0.01 cm]
+		uint16_t photo;	   // ADC value
+	} Record;
+
+	uint32_t cursor() const;
+
+	Record _records[BACKLOG_SAMPLES];
+	uint8_t _head;		   // Index of the oldest record
+	uint8_t _count;
+	uint32_t _sequence;	   // Sequence number of the next record
+	uint32_t _replayNext;  // Next sequence to replay
+	uint32_t _replayEnd;   // Replay stops before this sequence
+};
+
+#endif
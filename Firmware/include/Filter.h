@@ -0,0 +1,137 @@
+/**
+ * @file Filter.h
+ * @brief Integer distance filters for the sensor pipeline: running median followed by a constant velocity
+ * Kalman filter.
+ *
+ * Distances are handled in 0.01 cm (uint16, up to 655.35 cm), the same unit the packets use. The median
+ * removes single wild pings (multipath, missed echoes returning 0), the Kalman filter smooths what is
+ * left without the lag of a plain average. Both run in a fixed number of steps per sample: the median
+ * moves at most Window values, the Kalman update is a fixed sequence of 32 bit and 64 bit operations
+ * with two 32 bit divisions.
+ */
+
+#ifndef Filter_h
+#define Filter_h
+
+#include <Arduino.h>
+
+#define KALMAN_FRAC_BITS 8 // Fraction bits of the position and velocity state
+#define KALMAN_GAIN_BITS 15
+
+/**
+ * @brief Running median over the last Window samples.
+ *
+ * Keeps the samples in arrival order and in sorted order, a new sample replaces the oldest one in the
+ * sorted array and is moved to its place.
+ */
+template <uint8_t Window>
+class MedianFilter
+{
+	static_assert(Window % 2 == 1 && Window <= 15, "MedianFilter window must be odd and at most 15");
+
+public:
+	MedianFilter() : _next(0), _filled(false) {}
+
+	uint16_t operator()(uint16_t value)
+	{
+		if (!_filled)
+		{
+			for (uint8_t i = 0; i < Window; i++)
+			{
+				_history[i] = value;
+				_sorted[i] = value;
+			}
+			_filled = true;
+			return value;
+		}
+
+		uint16_t oldest = _history[_next];
+		_history[_next] = value;
+		_next = (_next + 1) % Window;
+
+		uint8_t i = 0;
+		while (_sorted[i] != oldest)
+			i++;
+		while (i > 0 && _sorted[i - 1] > value)
+		{
+			_sorted[i] = _sorted[i - 1];
+			i--;
+		}
+		while (i < Window - 1 && _sorted[i + 1] < value)
+		{
+			_sorted[i] = _sorted[i + 1];
+			i++;
+		}
+		_sorted[i] = value;
+
+		return _sorted[Window / 2];
+	}
+
+	void reset()
+	{
+		_next = 0;
+		_filled = false;
+	}
+
+private:
+	uint16_t _history[Window];
+	uint16_t _sorted[Window];
+	uint8_t _next;
+	bool _filled;
+};
+
+/**
+ * @brief Constant velocity Kalman filter in fixed point, one step per sample.
+ */
+class KalmanFilter
+{
+public:
+	KalmanFilter(uint16_t measurementNoise, uint16_t processNoise);
+
+	uint16_t update(uint16_t measurement);
+	void reset();
+
+	int16_t velocity() const;
+
+private:
+	int32_t _position; // [0.01 cm << KALMAN_FRAC_BITS]
+	int32_t _velocity; // [0.01 cm / sample << KALMAN_FRAC_BITS]
+	int32_t _p00;	   // Covariance [(0.01 cm)^2]
+	int32_t _p01;
+	int32_t _p11;
+	int32_t _r; // Measurement variance
+	int32_t _q; // Process (acceleration) variance
+	bool _initialized;
+};
+
+/**
+ * @brief Pipeline filter for a float [cm] distance channel: median, then Kalman.
+ *
+ * @tparam Window Median window (3, 5 or 7)
+ * @tparam MeasurementNoise Standard deviation of one ping [0.01 cm]
+ * @tparam ProcessNoise Standard deviation of the acceleration between two samples [0.01 cm / sample^2]
+ */
+template <uint8_t Window, uint16_t MeasurementNoise, uint16_t ProcessNoise>
+class DistanceFilter
+{
+public:
+	DistanceFilter() : _kalman(MeasurementNoise, ProcessNoise) {}
+
+	float operator()(float distance)
+	{
+		uint16_t raw = distance >= 655.35f ? 65535 : distance <= 0.0f ? 0 : (uint16_t)(distance * 100.0f + 0.5f);
+		return _kalman.update(_median(raw)) / 100.0f;
+	}
+
+	void reset()
+	{
+		_median.reset();
+		_kalman.reset();
+	}
+
+private:
+	MedianFilter<Window> _median;
+	KalmanFilter _kalman;
+};
+
+#endif
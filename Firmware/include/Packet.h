@@ -0,0 +1,115 @@
+/**
+ * @file Packet.h
+ * @brief Variable length, typed packet framing used next to the fixed 11 byte Message.
+ *
+ * Packet layout:
+ *   start (0x56) | type | len | payload[len] | cs | end (0xAA)
+ *
+ * The check sum is the XOR of every byte before it, the same rule the Message frame uses.
+ */
+
+#ifndef Packet_h
+#define Packet_h
+
+#include <Arduino.h>
+
+#define PACKET_START 0x56
+#define PACKET_END 0xAA
+#define PACKET_HEADER_SIZE 3 // start, type, len
+#define PACKET_TRAILER_SIZE 2 // cs, end
+#define PACKET_MAX_PAYLOAD 48
+#define PACKET_MAX_SIZE (PACKET_HEADER_SIZE + PACKET_MAX_PAYLOAD + PACKET_TRAILER_SIZE)
+#define PACKET_RX_MAX_PAYLOAD 8 // Host -> device packets are short commands
+
+// Packet types
+#define PACKET_STREAM_KEY 0x01	 // Compressed sample block, first sample is absolute (see StreamEncoder.h)
+#define PACKET_STREAM_DELTA 0x02 // Compressed sample block, every sample is a delta
+#define PACKET_SONIC_ARRAY 0x03	 // uint8 count, count * uint16 distance [0.01 cm]
+#define PACKET_SONIC_RAW 0x04	 // uint16 raw distance [0.01 cm], uint16 filtered distance [0.01 cm] of the reported sample
+#define PACKET_BURST_DATA 0x05	 // uint8 burst id, uint16 rate [Hz], uint16 total samples, uint16 offset, uint8 samples [ADC >> 2]
+#define PACKET_BACKLOG 0x06		 // uint32 device time [us], uint32 first sequence, records: uint32 time [us], uint16 distance [0.01 cm], uint16 photo
+#define PACKET_SAMPLE 0x07		 // uint16 sequence, uint32 time [us], uint16 distance [0.01 cm], uint16 photo
+
+// Host -> device commands
+#define PACKET_CMD_BAUD 0x10		 // uint32 baud rate, the device switches after its LINK_STATUS reply
+#define PACKET_CMD_BAUD_CONFIRM 0x11 // Sent by the host at the new baud rate
+#define PACKET_CMD_PING 0x12		 // Link keep alive, answered with LINK_STATUS
+#define PACKET_CMD_SET_INTERVAL 0x13	// uint32 sample interval [ms]
+#define PACKET_CMD_PAUSE 0x14			// Stop sampling
+#define PACKET_CMD_RESUME 0x15			// Continue sampling
+#define PACKET_CMD_GET_STATS 0x16		// Answered with PACKET_STATS
+#define PACKET_CMD_SET_COMPRESSION 0x17 // uint8 0 - Message frames, 1 - compressed stream
+#define PACKET_CMD_SET_DEADBAND 0x18	// uint16 distance [0.01 cm], uint16 photo [ADC], uint32 heartbeat [ms] (0 - report every sample)
+#define PACKET_CMD_BURST 0x19			// uint16 rate [Hz], capture a photo cell burst and send it in PACKET_BURST_DATA
+#define PACKET_CMD_REPLAY 0x1A			// uint16 first sequence (none - everything), replay the stored samples in PACKET_BACKLOG
+#define PACKET_CMD_TIME 0x1B			// uint32 tag, answered with PACKET_TIME for the host clock synchronization
+
+// Device -> host replies
+#define PACKET_LINK_STATUS 0x20 // state, uint32 requested baud, uint32 effective baud, uint16 rx errors, uint16 fallbacks,
+								// uint16 tx dropped, uint16 rx overruns, uint16 rx frame errors
+#define PACKET_STATS 0x21 // uint32 interval [ms], uint8 flags (STATS_FLAG_*), uint32 samples, uint32 uptime [ms],
+						  // uint16 rx errors, uint16 tx dropped, uint16 rx overruns, uint16 rx frame errors, uint32 samples sent
+#define PACKET_ACK 0x22	  // uint8 command type, uint8 result (ACK_*), sent for every command without its own reply
+#define PACKET_TIME 0x23  // uint32 tag of the PACKET_CMD_TIME, uint32 device time [us] when the command was handled
+
+// PACKET_ACK results
+#define ACK_OK 0
+#define ACK_BAD_ARGUMENT 1
+#define ACK_UNKNOWN_COMMAND 2
+
+// PACKET_STATS flags
+#define STATS_FLAG_PAUSED 0x01
+#define STATS_FLAG_COMPRESSED 0x02
+#define STATS_FLAG_REPORT_ON_CHANGE 0x04
+
+// LINK_STATUS states
+#define LINK_STATE_DEFAULT 0   // Running at the default baud rate
+#define LINK_STATE_ACCEPTED 1  // Switching, waiting for PACKET_CMD_BAUD_CONFIRM
+#define LINK_STATE_REJECTED 2  // Requested baud rate not supported
+#define LINK_STATE_CONFIRMED 3 // Running at the negotiated baud rate
+
+class PacketWriter
+{
+public:
+	PacketWriter();
+
+	void begin(uint8_t type);
+	bool put(uint8_t value);
+	bool putVarint(uint32_t value);
+	bool putZigzag(int32_t value);
+	bool putUint16(uint16_t value);
+	bool putUint32(uint32_t value);
+	uint8_t finish();
+
+	const uint8_t *data() const;
+	uint8_t size() const;
+	uint8_t payloadSize() const;
+
+private:
+	uint8_t _buffer[PACKET_MAX_SIZE];
+	uint8_t _size;
+};
+
+class PacketReader
+{
+public:
+	PacketReader();
+
+	bool push(uint8_t byte);
+	void reset();
+
+	uint8_t type() const;
+	const uint8_t *payload() const;
+	uint8_t payloadSize() const;
+	uint32_t readUint32(uint8_t offset) const;
+
+	uint16_t errors() const;
+
+private:
+	uint8_t _buffer[PACKET_HEADER_SIZE + PACKET_RX_MAX_PAYLOAD + PACKET_TRAILER_SIZE];
+	uint8_t _size;
+	uint8_t _expected;
+	uint16_t _errors;
+};
+
+#endif
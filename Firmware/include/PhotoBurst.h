@@ -0,0 +1,66 @@
+/**
+ * @file PhotoBurst.h
+ * @brief Timer triggered high rate capture of one analog input into SRAM.
+ *
+ * Timer1 (CTC, compare match B) auto-triggers the ADC at the requested rate, the ADC interrupt stores
+ * the upper 8 bits of every conversion until the buffer is full. Afterwards the buffer is streamed to
+ * the host in PACKET_BURST_DATA chunks and Timer1 and the ADC are handed back to the Arduino core.
+ *
+ * The capture hardware (Timer1, the ADC and its interrupt) lives in PhotoBurstAvr.cpp, the native environment
+ * replaces only that part (lib/ArduinoMock/src/PhotoBurstMock.cpp). Everything else is in PhotoBurst.cpp.
+ *
+ * @note analogRead() must not be called while a capture is running.
+ */
+
+#ifndef PhotoBurst_h
+#define PhotoBurst_h
+
+#include <Arduino.h>
+#include "Packet.h"
+
+#ifndef BURST_SAMPLES
+#define BURST_SAMPLES 512 // [bytes] One 8 bit sample each
+#endif
+#define BURST_MIN_RATE 100	  // [Hz]
+#define BURST_MAX_RATE 10000  // [Hz] A conversion takes 52 us at ADC clock / 64
+#define BURST_CHUNK_SAMPLES 40 // Samples per PACKET_BURST_DATA
+#define BURST_CHUNK_HEADER 7   // id, rate, total, offset
+#define BURST_TIMER_CLOCK (F_CPU / 8) // [Hz] Timer1 with prescaler 8
+
+class PhotoBurst
+{
+public:
+	PhotoBurst();
+
+	bool start(uint8_t pin, uint16_t rate);
+	bool isCapturing() const;
+	bool hasPending() const;
+
+	uint8_t fill(PacketWriter *packet) const;
+	void advance(uint8_t count);
+
+	uint16_t rate() const;
+
+	// Called from the ADC interrupt vector
+	void adcInterrupt();
+
+private:
+	void store(uint8_t sample);
+
+	// Capture hardware
+	void beginCapture(uint8_t pin, uint16_t top);
+	void endCapture();
+
+	uint8_t _samples[BURST_SAMPLES];
+	volatile uint16_t _captured;
+	volatile bool _capturing;
+	uint16_t _sent;
+	uint16_t _rate;
+	uint8_t _id;
+	uint8_t _savedTCCR1A;
+	uint8_t _savedTCCR1B;
+};
+
+extern PhotoBurst photoBurst;
+
+#endif
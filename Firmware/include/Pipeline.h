@@ -0,0 +1,202 @@
+/**
+ * @file Pipeline.h
+ * @brief Compile-time sensor pipeline.
+ *
+ * A pipeline is a type list of channels, a channel is a sensor type plus a filter type:
+ *
+ *   typedef Pipeline<
+ *       Channel<PhotoCellSensor<A0>>,
+ *       Channel<SonicSensor<sonicSensor>, DistanceFilter<5, 50, 20>>
+ *   > SensorPipeline;
+ *
+ * begin() and sample() expand into straight-line calls of every channel, and value<I>() resolves to the
+ * member of the I-th channel at compile time. There are no virtual functions and no runtime tables, a
+ * channel costs its raw and filtered value (and the state of its filter) and nothing else. A channel
+ * without a filter keeps only one value, raw() and value() both return it.
+ *
+ * Sensor concept:
+ *   typedef ... value_type;
+ *   static void begin();
+ *   static value_type read();
+ *
+ * Filter concept (stateless filters take no SRAM, Channel derives from its filter):
+ *   value_type operator()(value_type raw);
+ */
+
+#ifndef Pipeline_h
+#define Pipeline_h
+
+#include <Arduino.h>
+
+// Pass-through filter
+struct NoFilter
+{
+	template <class T>
+	T operator()(T value)
+	{
+		return value;
+	}
+};
+
+template <class Sensor, class Filter = NoFilter>
+class Channel : private Filter
+{
+public:
+	typedef typename Sensor::value_type value_type;
+
+	Channel() : _raw(), _value() {}
+
+	void begin()
+	{
+		Sensor::begin();
+	}
+
+	void sample()
+	{
+		_raw = Sensor::read();
+		_value = Filter::operator()(_raw);
+	}
+
+	// Last reading before the filter
+	value_type raw() const
+	{
+		return _raw;
+	}
+
+	value_type value() const
+	{
+		return _value;
+	}
+
+	Filter &filter()
+	{
+		return *this;
+	}
+
+private:
+	value_type _raw;
+	value_type _value;
+};
+
+// Without a filter the raw value is the value, no second copy in SRAM
+template <class Sensor>
+class Channel<Sensor, NoFilter> : private NoFilter
+{
+public:
+	typedef typename Sensor::value_type value_type;
+
+	Channel() : _value() {}
+
+	void begin()
+	{
+		Sensor::begin();
+	}
+
+	void sample()
+	{
+		_value = Sensor::read();
+	}
+
+	value_type raw() const
+	{
+		return _value;
+	}
+
+	value_type value() const
+	{
+		return _value;
+	}
+
+	NoFilter &filter()
+	{
+		return *this;
+	}
+
+private:
+	value_type _value;
+};
+
+template <class... Channels>
+class Pipeline;
+
+template <uint8_t Index, class P>
+struct PipelineAt;
+
+// End of the type list
+template <>
+class Pipeline<>
+{
+public:
+	static const uint8_t size = 0;
+
+	void begin() {}
+	void sample() {}
+
+	template <class Visitor>
+	void forEach(Visitor &, uint8_t = 0) {}
+};
+
+template <class Head, class... Tail>
+class Pipeline<Head, Tail...> : public Pipeline<Tail...>
+{
+public:
+	static const uint8_t size = 1 + sizeof...(Tail);
+
+	void begin()
+	{
+		head.begin();
+		Pipeline<Tail...>::begin();
+	}
+
+	void sample()
+	{
+		head.sample();
+		Pipeline<Tail...>::sample();
+	}
+
+	// Calls visitor(index, value) for every channel in order
+	template <class Visitor>
+	void forEach(Visitor &visitor, uint8_t index = 0)
+	{
+		visitor(index, head.value());
+		Pipeline<Tail...>::forEach(visitor, index + 1);
+	}
+
+	template <uint8_t Index>
+	typename PipelineAt<Index, Pipeline>::channel_type &channel()
+	{
+		return PipelineAt<Index, Pipeline>::get(*this);
+	}
+
+	template <uint8_t Index>
+	typename PipelineAt<Index, Pipeline>::channel_type::value_type value()
+	{
+		return channel<Index>().value();
+	}
+
+	Head head;
+};
+
+template <class Head, class... Tail>
+struct PipelineAt<0, Pipeline<Head, Tail...>>
+{
+	typedef Head channel_type;
+
+	static channel_type &get(Pipeline<Head, Tail...> &pipeline)
+	{
+		return pipeline.head;
+	}
+};
+
+template <uint8_t Index, class Head, class... Tail>
+struct PipelineAt<Index, Pipeline<Head, Tail...>>
+{
+	typedef typename PipelineAt<Index - 1, Pipeline<Tail...>>::channel_type channel_type;
+
+	static channel_type &get(Pipeline<Head, Tail...> &pipeline)
+	{
+		return PipelineAt<Index - 1, Pipeline<Tail...>>::get(pipeline);
+	}
+};
+
+#endif
@@ -0,0 +1,66 @@
+/**
+ * @file SonicArray.h
+ * @brief Non-blocking ranging with several SRF-04 sensors.
+ *
+ * The sensors are triggered round-robin, one every guardTime microseconds, so the burst of one sensor
+ * has died down before the next one fires. Echo pulses are timed in the pin change interrupts, which
+ * lets several echoes be in flight at once and keeps loop() free of pulseIn.
+ *
+ * @note The driver owns the PCINT0..2 interrupt vectors, only one SonicArray can be active.
+ */
+
+#ifndef SonicArray_h
+#define SonicArray_h
+
+#include <Arduino.h>
+
+#define SONIC_ARRAY_MAX 8
+#define SONIC_ECHO_TIMEOUT 40000UL // [us] SRF-04 holds the echo ~36 ms when nothing is in range
+
+class SonicArray
+{
+public:
+	SonicArray(const uint8_t *trigPins, const uint8_t *echoPins, uint8_t count, uint32_t guardTime);
+
+	void begin();
+	void update();
+
+	float getDistance(uint8_t index) const;
+	uint8_t count() const;
+
+	// Called from the pin change interrupt vectors
+	void echoInterrupt();
+	static SonicArray *active;
+
+private:
+	enum State : uint8_t
+	{
+		SONIC_IDLE,
+		SONIC_WAIT_RISE,
+		SONIC_WAIT_FALL,
+		SONIC_DONE
+	};
+
+	typedef struct
+	{
+		uint8_t trigPin;
+		uint8_t echoPin;
+		volatile uint8_t *echoPort;
+		uint8_t echoMask;
+		volatile uint8_t state;
+		volatile uint32_t start;
+		volatile uint32_t duration;
+		uint32_t triggerTime;
+	} Channel;
+
+	void trigger(uint8_t index);
+
+	Channel _channels[SONIC_ARRAY_MAX];
+	float _distance[SONIC_ARRAY_MAX];
+	uint8_t _count;
+	uint8_t _next;
+	uint32_t _guardTime;
+	uint32_t _lastTrigger;
+};
+
+#endif
@@ -0,0 +1,51 @@
+/**
+ * @file StreamEncoder.h
+ * @brief Delta + zigzag varint compression of the sensor sample stream.
+ *
+ * Samples are collected into blocks and sent as one Packet per block. The first payload byte is a
+ * wrapping block counter so the receiver can tell when a block was lost, followed by the uint16 sequence
+ * number and the uint32 micros() of the first sample. Samples of a block have consecutive sequence numbers,
+ * every sample after the first starts with the time since the sample before it [us] as a varint. A PACKET_STREAM_KEY block
+ * starts with the absolute values of its first sample, every other sample (and every sample of a
+ * PACKET_STREAM_DELTA block) is the difference to the sample before it. Slowly changing readings
+ * therefore take 1 byte per channel instead of 4.
+ *
+ * Channel encoding:
+ * - distance: hundredths of a centimeter (the SRF-04 resolution is ~0.034 cm, so nothing is lost)
+ * - photo: raw ADC value
+ */
+
+#ifndef StreamEncoder_h
+#define StreamEncoder_h
+
+#include <Arduino.h>
+#include "Packet.h"
+
+#define STREAM_SAMPLE_MAX_SIZE 15 // Time and 2 channels, 5 bytes worst case varint each
+
+class StreamEncoder
+{
+public:
+	StreamEncoder(uint8_t batchSize, uint8_t keyframeInterval);
+
+	bool add(uint16_t sequence, uint32_t time, float distance, int photo);
+	bool flush();
+	void reset();
+
+	const PacketWriter &packet() const;
+
+private:
+	bool finishBlock();
+
+	PacketWriter _packet;
+	uint8_t _batchSize;
+	uint8_t _keyframeInterval;
+	uint8_t _count;
+	uint8_t _blocksSinceKey;
+	uint8_t _blockCounter;
+	int32_t _lastDistance;
+	int32_t _lastPhoto;
+	uint32_t _lastTime;
+};
+
+#endif
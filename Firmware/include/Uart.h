@@ -0,0 +1,69 @@
+/**
+ * @file Uart.h
+ * @brief Interrupt driven USART0 driver with a large TX ring and block enqueue.
+ *
+ * Replaces HardwareSerial. A frame is copied into the TX ring with one enqueue() call, which either takes
+ * the whole frame or rejects it ("would block") without waiting, so sensor acquisition never stalls on
+ * UART backpressure. The UDRE interrupt drains the ring, the RX interrupt fills a small RX ring and counts
+ * line errors.
+ *
+ * @note HardwareSerial defines the same interrupt vectors, so Serial must not be used next to this driver.
+ */
+
+#ifndef Uart_h
+#define Uart_h
+
+#include <Arduino.h>
+
+#ifndef UART_TX_BUFFER_SIZE
+#define UART_TX_BUFFER_SIZE 128 // Power of two, at most 256
+#endif
+#ifndef UART_RX_BUFFER_SIZE
+#define UART_RX_BUFFER_SIZE 16 // Power of two, at most 256
+#endif
+
+typedef struct
+{
+	uint16_t txDropped;		// Frames rejected because the TX ring was full
+	uint16_t rxOverruns;	// Bytes lost in the UART (DOR0) or because the RX ring was full
+	uint16_t rxFrameErrors; // Bytes received with a framing error (FE0), usually a baud rate mismatch
+} UartStats;
+
+class Uart : public Print
+{
+public:
+	Uart();
+
+	void begin(uint32_t baud);
+	void end();
+	void flush();
+
+	bool enqueue(const uint8_t *data, uint8_t size);
+	size_t write(uint8_t value) override;
+	using Print::write;
+	uint8_t txFree() const;
+
+	int available() const;
+	int read();
+
+	uint32_t effectiveBaudRate() const;
+	UartStats stats() const;
+
+	// Called from the interrupt vectors
+	void txInterrupt();
+	void rxInterrupt();
+
+private:
+	uint8_t _txBuffer[UART_TX_BUFFER_SIZE];
+	volatile uint8_t _txHead;
+	volatile uint8_t _txTail;
+	uint8_t _rxBuffer[UART_RX_BUFFER_SIZE];
+	volatile uint8_t _rxHead;
+	volatile uint8_t _rxTail;
+	bool _written;
+	volatile UartStats _stats;
+};
+
+extern Uart uart;
+
+#endif
@@ -0,0 +1,102 @@
+/**
+ * @file Arduino.h
+ * @brief Host replacement of the Arduino core for the native environment.
+ *
+ * Only the part of the API the firmware uses is provided. Time is virtual: millis() and micros() read a
+ * clock that only moves when the firmware waits (delay, delayMicroseconds, pulseIn, analogRead) or when
+ * the driver advances it (see ArduinoMock.h), so every run is deterministic.
+ */
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+#define A0 14
+#define A1 15
+#define A2 16
+#define A3 17
+#define A4 18
+#define A5 19
+#define A6 20
+#define A7 21
+
+#define NUM_DIGITAL_PINS 22
+
+#ifndef F_CPU
+#define F_CPU 16000000UL
+#endif
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+unsigned long pulseIn(uint8_t pin, uint8_t state, unsigned long timeout = 1000000L);
+
+void interrupts();
+void noInterrupts();
+
+void setup();
+void loop();
+
+class Print
+{
+public:
+	virtual ~Print() {}
+
+	virtual size_t write(uint8_t value) = 0;
+	size_t write(const uint8_t *buffer, size_t size);
+	size_t write(const char *str);
+
+	size_t print(const char *str);
+	size_t print(char value);
+	size_t print(unsigned char value, int base = DEC);
+	size_t print(int value, int base = DEC);
+	size_t print(unsigned int value, int base = DEC);
+	size_t print(long value, int base = DEC);
+	size_t print(unsigned long value, int base = DEC);
+	size_t print(double value, int digits = 2);
+
+	size_t println();
+	template <class T>
+	size_t println(T value)
+	{
+		size_t n = print(value);
+		return n + println();
+	}
+	template <class T>
+	size_t println(T value, int format)
+	{
+		size_t n = print(value, format);
+		return n + println();
+	}
+
+private:
+	size_t printNumber(unsigned long value, uint8_t base);
+	size_t printFloat(double value, uint8_t digits);
+};
+
+#endif
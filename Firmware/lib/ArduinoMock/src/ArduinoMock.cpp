@@ -0,0 +1,334 @@
+/**
+ * @file ArduinoMock.cpp
+ * @brief Virtual clock, pins, Print and LiquidCrystal_I2C for the native environment.
+ */
+
+#include "ArduinoMock.h"
+#include "LiquidCrystal_I2C.h"
+
+static uint64_t clockMicros = 0;
+static uint8_t pinModes[NUM_DIGITAL_PINS];
+static uint8_t pinValues[NUM_DIGITAL_PINS];
+static int analogValues[NUM_DIGITAL_PINS];
+static unsigned long pulseDurations[NUM_DIGITAL_PINS];
+
+//==================================================================================================
+// Virtual clock
+
+/**
+ * @brief Moves the virtual clock forward, stands in for the time the firmware spends executing.
+ *
+ * @param us
+ */
+void mockAdvanceMicros(uint32_t us)
+{
+	clockMicros += us;
+}
+
+/**
+ * @brief Full width virtual clock [us], does not wrap like micros()
+ */
+uint64_t mockMicros()
+{
+	return clockMicros;
+}
+
+unsigned long millis()
+{
+	return (uint32_t)(clockMicros / 1000); // Wraps at 32 bits like on the AVR
+}
+
+unsigned long micros()
+{
+	return (uint32_t)clockMicros;
+}
+
+void delay(unsigned long ms)
+{
+	clockMicros += (uint64_t)ms * 1000;
+}
+
+void delayMicroseconds(unsigned int us)
+{
+	clockMicros += us;
+}
+
+void interrupts() {}
+void noInterrupts() {}
+
+//==================================================================================================
+// Pins
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+	if (pin < NUM_DIGITAL_PINS)
+		pinModes[pin] = mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+	if (pin < NUM_DIGITAL_PINS)
+		pinValues[pin] = value ? HIGH : LOW;
+}
+
+int digitalRead(uint8_t pin)
+{
+	return pin < NUM_DIGITAL_PINS ? pinValues[pin] : LOW;
+}
+
+int analogRead(uint8_t pin)
+{
+	clockMicros += MOCK_ANALOG_READ_TIME;
+	return pin < NUM_DIGITAL_PINS ? analogValues[pin] : 0;
+}
+
+/**
+ * @brief Returns the scripted pulse length and lets the virtual clock run for as long as the real
+ * pulseIn() would block.
+ */
+unsigned long pulseIn(uint8_t pin, uint8_t state, unsigned long timeout)
+{
+	(void)state;
+	unsigned long duration = pin < NUM_DIGITAL_PINS ? pulseDurations[pin] : 0;
+	if (duration == 0 || duration > timeout)
+	{
+		clockMicros += timeout;
+		return 0;
+	}
+	clockMicros += duration;
+	return duration;
+}
+
+void mockSetAnalog(uint8_t pin, int value)
+{
+	if (pin < NUM_DIGITAL_PINS)
+		analogValues[pin] = value;
+}
+
+int mockAnalogValue(uint8_t pin)
+{
+	return pin < NUM_DIGITAL_PINS ? analogValues[pin] : 0;
+}
+
+void mockSetDigital(uint8_t pin, uint8_t value)
+{
+	if (pin < NUM_DIGITAL_PINS)
+		pinValues[pin] = value ? HIGH : LOW;
+}
+
+void mockSetPulse(uint8_t pin, unsigned long duration)
+{
+	if (pin < NUM_DIGITAL_PINS)
+		pulseDurations[pin] = duration;
+}
+
+uint8_t mockPinMode(uint8_t pin)
+{
+	return pin < NUM_DIGITAL_PINS ? pinModes[pin] : INPUT;
+}
+
+uint8_t mockPinOutput(uint8_t pin)
+{
+	return pin < NUM_DIGITAL_PINS ? pinValues[pin] : LOW;
+}
+
+//==================================================================================================
+// Print, same formatting as the Arduino core
+
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+	size_t n = 0;
+	while (size--)
+	{
+		if (!write(*buffer++))
+			break;
+		n++;
+	}
+	return n;
+}
+
+size_t Print::write(const char *str)
+{
+	return str ? write((const uint8_t *)str, strlen(str)) : 0;
+}
+
+size_t Print::print(const char *str)
+{
+	return write(str);
+}
+
+size_t Print::print(char value)
+{
+	return write((uint8_t)value);
+}
+
+size_t Print::print(unsigned char value, int base)
+{
+	return print((unsigned long)value, base);
+}
+
+size_t Print::print(int value, int base)
+{
+	return print((long)value, base);
+}
+
+size_t Print::print(unsigned int value, int base)
+{
+	return print((unsigned long)value, base);
+}
+
+size_t Print::print(long value, int base)
+{
+	if (base == DEC && value < 0)
+	{
+		size_t n = print('-');
+		return n + printNumber(-(unsigned long)value, DEC);
+	}
+	return printNumber((unsigned long)value, base);
+}
+
+size_t Print::print(unsigned long value, int base)
+{
+	return printNumber(value, base);
+}
+
+size_t Print::print(double value, int digits)
+{
+	return printFloat(value, digits);
+}
+
+size_t Print::println()
+{
+	return write((const uint8_t *)"\r\n", 2);
+}
+
+size_t Print::printNumber(unsigned long value, uint8_t base)
+{
+	char buffer[8 * sizeof(long) + 1];
+	char *str = &buffer[sizeof(buffer) - 1];
+	*str = '\0';
+
+	if (base < 2)
+		base = 10;
+
+	do
+	{
+		char digit = value % base;
+		value /= base;
+		*--str = digit < 10 ? digit + '0' : digit + 'A' - 10;
+	} while (value);
+
+	return write(str);
+}
+
+size_t Print::printFloat(double value, uint8_t digits)
+{
+	if (isnan(value))
+		return print("nan");
+	if (isinf(value))
+		return print("inf");
+	if (value > 4294967040.0 || value < -4294967040.0)
+		return print("ovf");
+
+	size_t n = 0;
+	if (value < 0.0)
+	{
+		n += print('-');
+		value = -value;
+	}
+
+	double rounding = 0.5;
+	for (uint8_t i = 0; i < digits; i++)
+		rounding /= 10.0;
+	value += rounding;
+
+	unsigned long integer = (unsigned long)value;
+	double remainder = value - (double)integer;
+	n += print(integer);
+
+	if (digits > 0)
+		n += print('.');
+
+	while (digits-- > 0)
+	{
+		remainder *= 10.0;
+		unsigned int digit = (unsigned int)remainder;
+		n += print(digit);
+		remainder -= digit;
+	}
+	return n;
+}
+
+//==================================================================================================
+// LiquidCrystal_I2C
+
+LiquidCrystal_I2C::LiquidCrystal_I2C(uint8_t addr, uint8_t cols, uint8_t rows)
+	: _addr(addr),
+	  _cols(cols > LCD_MOCK_MAX_COLS ? LCD_MOCK_MAX_COLS : cols),
+	  _rows(rows > LCD_MOCK_MAX_ROWS ? LCD_MOCK_MAX_ROWS : rows),
+	  _col(0),
+	  _row(0),
+	  _backlight(false)
+{
+	clear();
+}
+
+void LiquidCrystal_I2C::init()
+{
+	clear();
+}
+
+void LiquidCrystal_I2C::begin(uint8_t cols, uint8_t rows)
+{
+	_cols = cols > LCD_MOCK_MAX_COLS ? LCD_MOCK_MAX_COLS : cols;
+	_rows = rows > LCD_MOCK_MAX_ROWS ? LCD_MOCK_MAX_ROWS : rows;
+	clear();
+}
+
+void LiquidCrystal_I2C::clear()
+{
+	for (uint8_t row = 0; row < LCD_MOCK_MAX_ROWS; row++)
+	{
+		memset(_text[row], ' ', _cols);
+		_text[row][_cols] = '\0';
+	}
+	home();
+}
+
+void LiquidCrystal_I2C::home()
+{
+	_col = 0;
+	_row = 0;
+}
+
+void LiquidCrystal_I2C::backlight()
+{
+	_backlight = true;
+}
+
+void LiquidCrystal_I2C::noBacklight()
+{
+	_backlight = false;
+}
+
+void LiquidCrystal_I2C::setCursor(uint8_t col, uint8_t row)
+{
+	_col = col;
+	_row = row < _rows ? row : _rows - 1;
+}
+
+size_t LiquidCrystal_I2C::write(uint8_t value)
+{
+	if (_col < _cols)
+		_text[_row][_col] = (char)value;
+	_col++;
+	return 1;
+}
+
+/**
+ * @brief Current text of one display row
+ */
+const char *LiquidCrystal_I2C::line(uint8_t row) const
+{
+	return row < LCD_MOCK_MAX_ROWS ? _text[row] : "";
+}
@@ -0,0 +1,31 @@
+/**
+ * @file ArduinoMock.h
+ * @brief Control side of the native environment mocks: virtual clock, scripted inputs and the UART link.
+ */
+
+#ifndef ArduinoMock_h
+#define ArduinoMock_h
+
+#include <Arduino.h>
+
+#define MOCK_ANALOG_READ_TIME 112 // [us] One ADC conversion (13 cycles at 16 MHz / 128) plus call overhead
+
+// Virtual clock
+void mockAdvanceMicros(uint32_t us);
+uint64_t mockMicros();
+
+// Scripted inputs
+void mockSetAnalog(uint8_t pin, int value);
+int mockAnalogValue(uint8_t pin); // Scripted value without the analogRead() conversion time
+void mockSetDigital(uint8_t pin, uint8_t value);
+void mockSetPulse(uint8_t pin, unsigned long duration); // pulseIn() result, 0 - no echo (timeout)
+uint8_t mockPinMode(uint8_t pin);
+uint8_t mockPinOutput(uint8_t pin);
+
+// UART link, TX drains at the configured baud rate as the virtual clock moves
+typedef void (*MockUartSink)(uint8_t value);
+void mockUartSetSink(MockUartSink sink);
+bool mockUartReceive(const uint8_t *data, uint8_t size);
+uint32_t mockUartTransmitted();
+
+#endif
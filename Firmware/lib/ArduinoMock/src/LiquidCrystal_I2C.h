@@ -0,0 +1,43 @@
+/**
+ * @file LiquidCrystal_I2C.h
+ * @brief Host replacement of the LiquidCrystal_I2C library, keeps the text of the display in memory.
+ */
+
+#ifndef LiquidCrystal_I2C_h
+#define LiquidCrystal_I2C_h
+
+#include <Arduino.h>
+
+#define LCD_MOCK_MAX_COLS 20
+#define LCD_MOCK_MAX_ROWS 4
+
+class LiquidCrystal_I2C : public Print
+{
+public:
+	LiquidCrystal_I2C(uint8_t addr, uint8_t cols, uint8_t rows);
+
+	void init();
+	void begin(uint8_t cols, uint8_t rows);
+	void clear();
+	void home();
+	void backlight();
+	void noBacklight();
+	void setCursor(uint8_t col, uint8_t row);
+
+	size_t write(uint8_t value) override;
+	using Print::write;
+
+	// Mock access
+	const char *line(uint8_t row) const;
+
+private:
+	uint8_t _addr;
+	uint8_t _cols;
+	uint8_t _rows;
+	uint8_t _col;
+	uint8_t _row;
+	bool _backlight;
+	char _text[LCD_MOCK_MAX_ROWS][LCD_MOCK_MAX_COLS + 1];
+};
+
+#endif
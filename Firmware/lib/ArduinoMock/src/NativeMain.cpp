@@ -0,0 +1,165 @@
+/**
+ * @file NativeMain.cpp
+ * @brief Entry point of the native environment: runs setup() once and loop() many times on the virtual
+ * clock with scripted sensor inputs, then prints what the firmware sent and how fast it ran.
+ *
+ * Usage: program [loops] [sweep|static|noise]
+ */
+
+#ifndef PIO_UNIT_TESTING // The unit tests bring their own main()
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include "ArduinoMock.h"
+#include "Scenario.h"
+#include "Uart.h"
+#include "Packet.h"
+
+#ifndef NATIVE_DEFAULT_LOOPS
+#define NATIVE_DEFAULT_LOOPS 1000000UL
+#endif
+#ifndef NATIVE_LOOP_TIME
+#define NATIVE_LOOP_TIME 20 // [us] Virtual time one loop() pass costs besides the mocked waits
+#endif
+#define SONIC_US_PER_CM 58.31f // Echo time for 1 cm of distance (there and back at 0.0343 cm/us)
+#define MESSAGE_SIZE 11
+
+// Firmware counters (main.cpp)
+extern uint32_t samplesTaken;
+extern uint32_t samplesReported;
+
+static uint32_t framesValid = 0;
+static uint32_t framesBroken = 0;
+static uint32_t txHash = 2166136261u; // FNV-1a of every transmitted byte
+static uint8_t frame[MESSAGE_SIZE];
+static uint8_t frameSize = 0;
+static uint8_t packet[PACKET_MAX_SIZE];
+static uint8_t packetSize = 0;
+static uint32_t packetsValid = 0;
+static uint32_t packetsBroken = 0;
+static uint32_t samplesReceived = 0; // PACKET_SAMPLE
+static uint32_t sequenceGaps = 0;
+static uint16_t nextSequence = 0;
+
+/**
+ * @brief Checks a complete packet and the sequence numbers of PACKET_SAMPLE.
+ */
+static void checkPacket()
+{
+	uint8_t checkSum = 0;
+	for (uint8_t i = 0; i < packetSize - PACKET_TRAILER_SIZE; i++)
+		checkSum ^= packet[i];
+	if (checkSum != packet[packetSize - 2] || packet[packetSize - 1] != PACKET_END)
+	{
+		packetsBroken++;
+		return;
+	}
+	packetsValid++;
+
+	if (packet[1] == PACKET_SAMPLE && packet[2] >= 2)
+	{
+		uint16_t sequence = packet[3] | (packet[4] << 8);
+		if (samplesReceived > 0 && sequence != nextSequence)
+			sequenceGaps++;
+		nextSequence = sequence + 1;
+		samplesReceived++;
+	}
+}
+
+/**
+ * @brief Checks the Message frames and packets the firmware sends, every byte goes into the hash.
+ */
+static void onTransmit(uint8_t value)
+{
+	txHash = (txHash ^ value) * 16777619u;
+
+	if (packetSize > 0)
+	{
+		packet[packetSize++] = value;
+		if (packetSize == PACKET_HEADER_SIZE && packet[2] > PACKET_MAX_PAYLOAD)
+		{
+			packetsBroken++;
+			packetSize = 0;
+		}
+		else if (packetSize >= PACKET_HEADER_SIZE && packetSize == PACKET_HEADER_SIZE + packet[2] + PACKET_TRAILER_SIZE)
+		{
+			checkPacket();
+			packetSize = 0;
+		}
+		return;
+	}
+	if (frameSize == 0)
+	{
+		if (value == PACKET_START)
+			packet[packetSize++] = value;
+		if (value != 0x55)
+			return;
+	}
+	frame[frameSize++] = value;
+	if (frameSize < MESSAGE_SIZE)
+		return;
+
+	uint8_t checkSum = 0;
+	for (uint8_t i = 0; i < MESSAGE_SIZE - 2; i++)
+		checkSum ^= frame[i];
+	if (checkSum == frame[MESSAGE_SIZE - 2] && frame[MESSAGE_SIZE - 1] == 0xAA)
+		framesValid++;
+	else
+		framesBroken++;
+	frameSize = 0;
+}
+
+/**
+ * @brief Sets every analog input and echo pulse from the scenario at the current virtual time.
+ */
+static void applyScenario(Scenario scenario)
+{
+	ScenarioInputs inputs = scenarioInputs(scenario, mockMicros() / 1e6);
+
+	for (uint8_t pin = A0; pin <= A7; pin++)
+		mockSetAnalog(pin, inputs.photo);
+	for (uint8_t pin = 0; pin < A0; pin++)
+		mockSetPulse(pin, (unsigned long)(inputs.distance * SONIC_US_PER_CM));
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long loops = argc > 1 ? strtoul(argv[1], nullptr, 10) : NATIVE_DEFAULT_LOOPS;
+	Scenario scenario = SCENARIO_SWEEP;
+	if (argc > 2 && !scenarioParse(argv[2], &scenario))
+	{
+		fprintf(stderr, "Unknown scenario: %s (sweep, static, noise)\n", argv[2]);
+		return 2;
+	}
+
+	mockUartSetSink(onTransmit);
+	applyScenario(scenario);
+	setup();
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (unsigned long i = 0; i < loops; i++)
+	{
+		applyScenario(scenario);
+		loop();
+		mockAdvanceMicros(NATIVE_LOOP_TIME);
+	}
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+	double wall = std::chrono::duration<double>(end - start).count();
+	UartStats stats = uart.stats();
+
+	printf("loops:            %lu\n", loops);
+	printf("virtual time:     %.3f s\n", mockMicros() / 1e6);
+	printf("wall time:        %.3f s (%.1f ns / loop)\n", wall, loops ? wall * 1e9 / loops : 0.0);
+	printf("samples taken:    %lu\n", (unsigned long)samplesTaken);
+	printf("samples reported: %lu\n", (unsigned long)samplesReported);
+	printf("tx bytes:         %lu (hash %08lx)\n", (unsigned long)mockUartTransmitted(), (unsigned long)txHash);
+	printf("message frames:   %lu valid, %lu broken\n", (unsigned long)framesValid, (unsigned long)framesBroken);
+	printf("packets:          %lu valid, %lu broken\n", (unsigned long)packetsValid, (unsigned long)packetsBroken);
+	printf("sample packets:   %lu, %lu sequence gaps\n", (unsigned long)samplesReceived, (unsigned long)sequenceGaps);
+	printf("tx dropped:       %u\n", stats.txDropped);
+	return framesBroken == 0 && packetsBroken == 0 ? 0 : 1;
+}
+
+#endif
@@ -0,0 +1,56 @@
+/**
+ * @file PhotoBurstMock.cpp
+ * @brief Capture hardware of PhotoBurst (PhotoBurst.h) for the native environment, the rest of the class is the
+ * firmware's PhotoBurst.cpp.
+ *
+ * Samples the scripted analog value at the burst rate of the virtual clock instead of the Timer1
+ * triggered ADC.
+ */
+
+#include "PhotoBurst.h"
+#include "ArduinoMock.h"
+
+static bool capturing = false;
+static uint8_t burstPin = A0;
+static uint64_t burstStart = 0;
+static uint32_t burstDone = 0;
+
+/**
+ * @brief Runs the "ADC interrupts" that are due at the current virtual time.
+ */
+static void runCapture()
+{
+	if (!capturing)
+		return;
+	uint64_t due = (mockMicros() - burstStart) * photoBurst.rate() / 1000000;
+	while (capturing && burstDone < due)
+	{
+		photoBurst.adcInterrupt();
+		burstDone++;
+	}
+}
+
+void PhotoBurst::beginCapture(uint8_t pin, uint16_t top)
+{
+	(void)top;
+	capturing = true;
+	burstPin = pin;
+	burstStart = mockMicros();
+	burstDone = 0;
+}
+
+void PhotoBurst::endCapture()
+{
+	capturing = false;
+}
+
+bool PhotoBurst::isCapturing() const
+{
+	runCapture();
+	return _capturing;
+}
+
+void PhotoBurst::adcInterrupt()
+{
+	store(mockAnalogValue(burstPin) >> 2);
+}
@@ -0,0 +1,60 @@
+/**
+ * @file Scenario.c
+ * @brief Scripted sensor inputs of the native environment and the simavr harness.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "Scenario.h"
+
+#define SCENARIO_DISTANCE 20.0 // [cm] Resting distance of the static and noise scenarios
+#define SCENARIO_PHOTO 512	   // [ADC] Resting photo cell value
+
+static uint32_t noiseState = 1;
+
+/**
+ * @brief +-2 LSB from a linear congruential generator
+ */
+static int noise(void)
+{
+	noiseState = noiseState * 1103515245u + 12345u;
+	return (int)((noiseState >> 16) % 5) - 2;
+}
+
+int scenarioParse(const char *name, Scenario *scenario)
+{
+	if (strcmp(name, "sweep") == 0)
+		*scenario = SCENARIO_SWEEP;
+	else if (strcmp(name, "static") == 0)
+		*scenario = SCENARIO_STATIC;
+	else if (strcmp(name, "noise") == 0)
+		*scenario = SCENARIO_NOISE;
+	else
+		return 0;
+	return 1;
+}
+
+ScenarioInputs scenarioInputs(Scenario scenario, double t)
+{
+	ScenarioInputs inputs;
+	inputs.distance = SCENARIO_DISTANCE;
+	inputs.photo = SCENARIO_PHOTO;
+
+	switch (scenario)
+	{
+	case SCENARIO_SWEEP:
+		inputs.distance = 17.5 + 12.5 * sin(t * 0.5);
+		inputs.photo = (int)fmod(t * 100.0, 2046.0);
+		if (inputs.photo > 1023)
+			inputs.photo = 2046 - inputs.photo;
+		break;
+	case SCENARIO_STATIC:
+		break;
+	case SCENARIO_NOISE:
+		inputs.distance += noise() * 0.02;
+		inputs.photo += noise();
+		break;
+	}
+	return inputs;
+}
@@ -0,0 +1,49 @@
+/**
+ * @file Scenario.h
+ * @brief Scripted sensor inputs shared by the native environment (NativeMain.cpp) and the simavr harness
+ * (sim/SimHarness.c), so both run the firmware against the same distance and photo cell waveforms.
+ *
+ * Plain C, the harness is built with cc.
+ */
+
+#ifndef Scenario_h
+#define Scenario_h
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	typedef enum
+	{
+		SCENARIO_SWEEP,	 // Distance 5 - 30 cm sine, photo cell triangle
+		SCENARIO_STATIC, // Nothing moves
+		SCENARIO_NOISE	 // Constant values with +-2 LSB noise
+	} Scenario;
+
+	typedef struct
+	{
+		double distance; // [cm]
+		int photo;		 // [ADC] 0 - 1023
+	} ScenarioInputs;
+
+	/**
+	 * @brief Parses a scenario name (sweep, static, noise).
+	 *
+	 * @return 1 if the name is known, 0 otherwise (scenario is left untouched)
+	 */
+	int scenarioParse(const char *name, Scenario *scenario);
+
+	/**
+	 * @brief Sensor inputs of the scenario at the given time. The noise comes from one LCG with a fixed
+	 * seed, every call moves it forward, so the same call sequence gives the same inputs on every run.
+	 *
+	 * @param t [s] Time since the start of the run
+	 */
+	ScenarioInputs scenarioInputs(Scenario scenario, double t);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
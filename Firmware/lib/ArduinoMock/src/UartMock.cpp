@@ -0,0 +1,219 @@
+/**
+ * @file UartMock.cpp
+ * @brief Host implementation of the Uart driver (Uart.h) for the native environment.
+ *
+ * Uses the same TX ring as the AVR driver, but instead of the UDRE interrupt the ring drains at the
+ * configured baud rate as the virtual clock moves, so backpressure and txDropped behave like on the board.
+ */
+
+#include "Uart.h"
+#include "ArduinoMock.h"
+
+#define TX_MASK (UART_TX_BUFFER_SIZE - 1)
+#define RX_MASK (UART_RX_BUFFER_SIZE - 1)
+#define UART_BITS_PER_BYTE 10 // 8N1
+
+static_assert((UART_TX_BUFFER_SIZE & TX_MASK) == 0 && UART_TX_BUFFER_SIZE <= 256, "UART_TX_BUFFER_SIZE must be a power of two <= 256");
+static_assert((UART_RX_BUFFER_SIZE & RX_MASK) == 0 && UART_RX_BUFFER_SIZE <= 256, "UART_RX_BUFFER_SIZE must be a power of two <= 256");
+
+Uart uart;
+
+static uint32_t lineBaud = 0;
+static uint64_t lineTime = 0;	  // [us] Virtual time the TX ring was last drained
+static uint64_t lineCredit = 0;	  // [bit * 1e6] Line time not yet used by a whole byte
+static uint32_t transmitted = 0;
+static uint8_t rxValue = 0;
+static MockUartSink sink = nullptr;
+
+/**
+ * @brief Moves as many bytes out of the TX ring as the line could send since the last call.
+ */
+static void drainTx()
+{
+	uint64_t now = mockMicros();
+	uint64_t elapsed = now - lineTime;
+	lineTime = now;
+
+	if (lineBaud == 0 || uart.txFree() == UART_TX_BUFFER_SIZE - 1)
+	{
+		lineCredit = 0; // An idle line does not bank bytes
+		return;
+	}
+
+	lineCredit += elapsed * lineBaud;
+	const uint64_t byteCost = (uint64_t)UART_BITS_PER_BYTE * 1000000;
+	while (lineCredit >= byteCost && uart.txFree() < UART_TX_BUFFER_SIZE - 1)
+	{
+		uart.txInterrupt();
+		lineCredit -= byteCost;
+	}
+	if (uart.txFree() == UART_TX_BUFFER_SIZE - 1)
+		lineCredit = 0;
+}
+
+void mockUartSetSink(MockUartSink newSink)
+{
+	sink = newSink;
+}
+
+/**
+ * @brief Delivers host -> device bytes into the RX ring, as the RX interrupt would.
+ *
+ * @return false if some bytes were lost (counted in rxOverruns)
+ */
+bool mockUartReceive(const uint8_t *data, uint8_t size)
+{
+	uint16_t overruns = uart.stats().rxOverruns;
+	for (uint8_t i = 0; i < size; i++)
+	{
+		rxValue = data[i];
+		uart.rxInterrupt();
+	}
+	return uart.stats().rxOverruns == overruns;
+}
+
+/**
+ * @brief Number of bytes that left the TX ring so far
+ */
+uint32_t mockUartTransmitted()
+{
+	drainTx();
+	return transmitted;
+}
+
+//==================================================================================================
+Uart::Uart() : _txHead(0), _txTail(0), _rxHead(0), _rxTail(0), _written(false), _stats() {}
+
+/**
+ * @brief Same divider selection as the AVR driver, so effectiveBaudRate() reports the real rate.
+ */
+void Uart::begin(uint32_t baud)
+{
+	uint16_t ubrr = (F_CPU / 4 / baud - 1) / 2;
+	uint8_t divider = 8;
+	if (ubrr > 4095)
+	{
+		ubrr = (F_CPU / 8 / baud - 1) / 2;
+		divider = 16;
+	}
+
+	lineBaud = F_CPU / ((uint32_t)divider * (ubrr + 1));
+	lineTime = mockMicros();
+	lineCredit = 0;
+	_txHead = _txTail = 0;
+	_rxHead = _rxTail = 0;
+	_written = false;
+}
+
+void Uart::end()
+{
+	flush();
+	lineBaud = 0;
+}
+
+/**
+ * @brief Lets the virtual clock run until the TX ring is empty, like the blocking AVR flush().
+ */
+void Uart::flush()
+{
+	drainTx();
+	if (lineBaud == 0)
+		return;
+	uint8_t pending = (UART_TX_BUFFER_SIZE - 1) - txFree();
+	if (pending == 0)
+		return;
+	uint64_t bits = (uint64_t)pending * UART_BITS_PER_BYTE * 1000000;
+	mockAdvanceMicros((uint32_t)((bits - lineCredit + lineBaud - 1) / lineBaud));
+	drainTx();
+}
+
+bool Uart::enqueue(const uint8_t *data, uint8_t size)
+{
+	drainTx();
+	if (size > txFree())
+	{
+		_stats.txDropped++;
+		return false;
+	}
+
+	uint8_t head = _txHead;
+	uint16_t first = UART_TX_BUFFER_SIZE - head;
+	if (first > size)
+		first = size;
+	memcpy(_txBuffer + head, data, first);
+	memcpy(_txBuffer, data + first, size - first);
+	_txHead = (head + size) & TX_MASK;
+
+	_written = true;
+	return true;
+}
+
+size_t Uart::write(uint8_t value)
+{
+	return enqueue(&value, 1) ? 1 : 0;
+}
+
+uint8_t Uart::txFree() const
+{
+	return (uint8_t)((_txTail - _txHead - 1) & TX_MASK);
+}
+
+int Uart::available() const
+{
+	return (uint8_t)((_rxHead - _rxTail) & RX_MASK);
+}
+
+int Uart::read()
+{
+	uint8_t tail = _rxTail;
+	if (tail == _rxHead)
+		return -1;
+	uint8_t value = _rxBuffer[tail];
+	_rxTail = (tail + 1) & RX_MASK;
+	return value;
+}
+
+uint32_t Uart::effectiveBaudRate() const
+{
+	return lineBaud;
+}
+
+UartStats Uart::stats() const
+{
+	UartStats copy;
+	copy.txDropped = _stats.txDropped;
+	copy.rxOverruns = _stats.rxOverruns;
+	copy.rxFrameErrors = _stats.rxFrameErrors;
+	return copy;
+}
+
+/**
+ * @brief Sends the next byte of the TX ring to the sink.
+ */
+void Uart::txInterrupt()
+{
+	uint8_t tail = _txTail;
+	if (tail == _txHead)
+		return;
+
+	uint8_t value = _txBuffer[tail];
+	_txTail = (tail + 1) & TX_MASK;
+	transmitted++;
+	if (sink)
+		sink(value);
+}
+
+/**
+ * @brief Stores the byte handed over by mockUartReceive().
+ */
+void Uart::rxInterrupt()
+{
+	uint8_t next = (_rxHead + 1) & RX_MASK;
+	if (next == _rxTail)
+	{
+		_stats.rxOverruns++;
+		return;
+	}
+	_rxBuffer[_rxHead] = rxValue;
+	_rxHead = next;
+}
@@ -0,0 +1,519 @@
+/**
+ * @file SimHarness.c
+ * @brief Cycle accurate on-target timing harness, runs the firmware ELF in simavr.
+ *
+ * The firmware has to be built with SIM_MARKERS=1 (pio run -e simavr): D9 toggles at the start of every
+ * loop() and D10 is high while a sample is processed. The harness
+ *   - answers every trigger pulse on D5 with an echo pulse on D4 and feeds A0 from the same scripted scenario
+ *     the native environment uses (lib/ArduinoMock/src/Scenario.c),
+ *   - captures the UART output and checks every Message frame, packet and PACKET_SAMPLE sequence number,
+ *   - measures the loop period, the cycles per sample (frame) and the latency of every interrupt vector
+ *     (pending -> running),
+ *   - compares the results with a baseline file and fails if a metric got worse than the tolerance.
+ *
+ * Usage: SimHarness firmware.elf [-s seconds] [-w sweep|static|noise] [-b baseline] [-t tolerance %] [-o out]
+ *
+ * Exit code: 0 - ok, 1 - timing regression or broken frames, 2 - usage or simulator error
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <getopt.h>
+
+#include "Scenario.h"
+#include "sim_avr.h"
+#include "sim_elf.h"
+#include "sim_irq.h"
+#include "sim_interrupts.h"
+#include "sim_cycle_timers.h"
+#include "sim_time.h"
+#include "avr_ioport.h"
+#include "avr_uart.h"
+#include "avr_adc.h"
+
+#define SIM_MCU "atmega328p"
+#define SIM_FREQUENCY 16000000UL
+#define SIM_VCC 5000 // [mV]
+
+#define SIM_TRIGGER_PORT 'D'
+#define SIM_TRIGGER_BIT 5 // D5
+#define SIM_ECHO_PORT 'D'
+#define SIM_ECHO_BIT 4 // D4
+#define SIM_LOOP_PORT 'B'
+#define SIM_LOOP_BIT 1 // D9
+#define SIM_FRAME_PORT 'B'
+#define SIM_FRAME_BIT 2 // D10
+
+#define SIM_ECHO_DELAY 450		 // [us] Trigger -> echo start of an SRF-04
+#define SIM_US_PER_CM 58.31		 // Echo time for 1 cm of distance
+#define SIM_SCRIPT_PERIOD 1000	 // [us] Scenario update period
+#define SIM_MAX_VECTORS 32
+#define SIM_MESSAGE_SIZE 11
+#define SIM_PACKET_START 0x56
+#define SIM_PACKET_MAX_SIZE (3 + 48 + 2) // start, type, len | payload | cs, end (Packet.h)
+#define SIM_PACKET_SAMPLE 0x07
+#define SIM_DEFAULT_SECONDS 5.0
+#define SIM_DEFAULT_TOLERANCE 5.0 // [%]
+
+typedef struct
+{
+	uint64_t count;
+	uint64_t sum;
+	uint64_t min;
+	uint64_t max;
+} Metric;
+
+typedef struct
+{
+	avr_cycle_count_t pendingSince;
+	Metric latency;
+} VectorTiming;
+
+static avr_t *avr = NULL;
+static Scenario scenario = SCENARIO_SWEEP;
+static double distance = 20.0; // [cm]
+
+static avr_irq_t *echoIrq = NULL;
+static avr_irq_t *adcIrq = NULL;
+
+static avr_cycle_count_t lastLoop = 0;
+static int frameSeen = 0;
+static avr_cycle_count_t frameStart = 0;
+static Metric loopIdle;	 // Loop passes without a sample
+static Metric loopFrame; // Loop passes with a sample
+static Metric frameCycles;
+static VectorTiming vectors[SIM_MAX_VECTORS];
+
+static uint8_t message[SIM_MESSAGE_SIZE];
+static uint8_t messageSize = 0;
+static uint8_t packet[SIM_PACKET_MAX_SIZE];
+static uint8_t packetSize = 0;
+static uint64_t uartBytes = 0;
+static uint64_t framesValid = 0;
+static uint64_t framesBroken = 0;
+static uint64_t packetsValid = 0;
+static uint64_t packetsBroken = 0;
+static uint64_t samplesReceived = 0;
+static uint64_t sequenceGaps = 0;
+static uint16_t nextSequence = 0;
+
+static const char *vectorNames[] = {
+	"RESET", "INT0", "INT1", "PCINT0", "PCINT1", "PCINT2", "WDT", "TIMER2_COMPA", "TIMER2_COMPB",
+	"TIMER2_OVF", "TIMER1_CAPT", "TIMER1_COMPA", "TIMER1_COMPB", "TIMER1_OVF", "TIMER0_COMPA",
+	"TIMER0_COMPB", "TIMER0_OVF", "SPI_STC", "USART_RX", "USART_UDRE", "USART_TX", "ADC", "EE_READY",
+	"ANALOG_COMP", "TWI", "SPM_READY"};
+
+//==================================================================================================
+// Metrics
+
+static void metricAdd(Metric *metric, uint64_t value)
+{
+	if (metric->count == 0 || value < metric->min)
+		metric->min = value;
+	if (value > metric->max)
+		metric->max = value;
+	metric->sum += value;
+	metric->count++;
+}
+
+static uint64_t metricAvg(const Metric *metric)
+{
+	return metric->count ? metric->sum / metric->count : 0;
+}
+
+//==================================================================================================
+// Scripted inputs
+
+/**
+ * @brief Moves the scenario forward and puts the new photo cell voltage on ADC0.
+ */
+static avr_cycle_count_t scriptTimer(avr_t *avr, avr_cycle_count_t when, void *param)
+{
+	(void)param;
+	ScenarioInputs inputs = scenarioInputs(scenario, (double)when / SIM_FREQUENCY);
+	distance = inputs.distance;
+
+	avr_raise_irq(adcIrq, (uint32_t)inputs.photo * SIM_VCC / 1024);
+	return when + avr_usec_to_cycles(avr, SIM_SCRIPT_PERIOD);
+}
+
+static avr_cycle_count_t echoEnd(avr_t *avr, avr_cycle_count_t when, void *param)
+{
+	(void)avr;
+	(void)param;
+	avr_raise_irq(echoIrq, 0);
+	return 0;
+}
+
+static avr_cycle_count_t echoStart(avr_t *avr, avr_cycle_count_t when, void *param)
+{
+	(void)param;
+	avr_raise_irq(echoIrq, 1);
+	avr_cycle_timer_register_usec(avr, (uint32_t)(distance * SIM_US_PER_CM), echoEnd, NULL);
+	return 0;
+}
+
+/**
+ * @brief The sensor fires on the falling edge of the trigger pulse.
+ */
+static void onTrigger(avr_irq_t *irq, uint32_t value, void *param)
+{
+	(void)param;
+	if (irq->value && !value)
+		avr_cycle_timer_register_usec(avr, SIM_ECHO_DELAY, echoStart, NULL);
+}
+
+//==================================================================================================
+// Measurements
+
+static void onLoopMarker(avr_irq_t *irq, uint32_t value, void *param)
+{
+	(void)param;
+	if (irq->value == value)
+		return;
+
+	if (lastLoop)
+		metricAdd(frameSeen ? &loopFrame : &loopIdle, avr->cycle - lastLoop);
+	lastLoop = avr->cycle;
+	frameSeen = 0;
+}
+
+static void onFrameMarker(avr_irq_t *irq, uint32_t value, void *param)
+{
+	(void)param;
+	if (irq->value == value)
+		return;
+
+	if (value)
+	{
+		frameStart = avr->cycle;
+		frameSeen = 1;
+	}
+	else if (frameStart)
+	{
+		metricAdd(&frameCycles, avr->cycle - frameStart);
+	}
+}
+
+static void onInterruptPending(avr_irq_t *irq, uint32_t value, void *param)
+{
+	(void)irq;
+	VectorTiming *timing = (VectorTiming *)param;
+	if (value && !timing->pendingSince)
+		timing->pendingSince = avr->cycle;
+}
+
+static void onInterruptRunning(avr_irq_t *irq, uint32_t value, void *param)
+{
+	(void)irq;
+	VectorTiming *timing = (VectorTiming *)param;
+	if (value && timing->pendingSince)
+	{
+		metricAdd(&timing->latency, avr->cycle - timing->pendingSince);
+		timing->pendingSince = 0;
+	}
+}
+
+/**
+ * @brief Checks a complete packet and the sequence numbers of PACKET_SAMPLE.
+ */
+static void checkPacket(void)
+{
+	uint8_t checkSum = 0;
+	for (uint8_t i = 0; i < packetSize - 2; i++)
+		checkSum ^= packet[i];
+	if (checkSum != packet[packetSize - 2] || packet[packetSize - 1] != 0xAA)
+	{
+		packetsBroken++;
+		return;
+	}
+	packetsValid++;
+
+	if (packet[1] == SIM_PACKET_SAMPLE && packet[2] >= 2)
+	{
+		uint16_t sequence = packet[3] | (packet[4] << 8);
+		if (samplesReceived > 0 && sequence != nextSequence)
+			sequenceGaps++;
+		nextSequence = sequence + 1;
+		samplesReceived++;
+	}
+}
+
+/**
+ * @brief Checks the Message frames and packets in the UART output.
+ */
+static void onUartOutput(avr_irq_t *irq, uint32_t value, void *param)
+{
+	(void)irq;
+	(void)param;
+	uartBytes++;
+
+	if (packetSize > 0)
+	{
+		packet[packetSize++] = (uint8_t)value;
+		if (packetSize == 3 && packet[2] > SIM_PACKET_MAX_SIZE - 5)
+		{
+			packetsBroken++;
+			packetSize = 0;
+		}
+		else if (packetSize >= 3 && packetSize == 3 + packet[2] + 2)
+		{
+			checkPacket();
+			packetSize = 0;
+		}
+		return;
+	}
+	if (messageSize == 0)
+	{
+		if (value == SIM_PACKET_START)
+			packet[packetSize++] = (uint8_t)value;
+		if (value != 0x55)
+			return;
+	}
+	message[messageSize++] = (uint8_t)value;
+	if (messageSize < SIM_MESSAGE_SIZE)
+		return;
+
+	uint8_t checkSum = 0;
+	for (uint8_t i = 0; i < SIM_MESSAGE_SIZE - 2; i++)
+		checkSum ^= message[i];
+	if (checkSum == message[SIM_MESSAGE_SIZE - 2] && message[SIM_MESSAGE_SIZE - 1] == 0xAA)
+		framesValid++;
+	else
+		framesBroken++;
+	messageSize = 0;
+}
+
+//==================================================================================================
+// Results
+
+typedef struct
+{
+	const char *name;
+	uint64_t value;
+	int gated; // Compared against the baseline
+} Result;
+
+#define SIM_MAX_RESULTS (16 + SIM_MAX_VECTORS * 2)
+
+static Result results[SIM_MAX_RESULTS];
+static int resultCount = 0;
+static char vectorKeys[SIM_MAX_VECTORS * 2][48];
+
+static void addResult(const char *name, uint64_t value, int gated)
+{
+	if (resultCount < SIM_MAX_RESULTS)
+	{
+		results[resultCount].name = name;
+		results[resultCount].value = value;
+		results[resultCount].gated = gated;
+		resultCount++;
+	}
+}
+
+static void collectResults(void)
+{
+	addResult("loop_idle_avg", metricAvg(&loopIdle), 1);
+	addResult("loop_idle_max", loopIdle.max, 1);
+	addResult("loop_frame_max", loopFrame.max, 1);
+	addResult("frame_cycles_avg", metricAvg(&frameCycles), 1);
+	addResult("frame_cycles_max", frameCycles.max, 1);
+	addResult("frames", frameCycles.count, 0);
+
+	int key = 0;
+	for (int v = 0; v < SIM_MAX_VECTORS; v++)
+	{
+		if (vectors[v].latency.count == 0)
+			continue;
+		const char *name = v < (int)(sizeof(vectorNames) / sizeof(vectorNames[0])) ? vectorNames[v] : "VECTOR";
+		snprintf(vectorKeys[key], sizeof(vectorKeys[key]), "isr_%s_%d_latency_max", name, v);
+		addResult(vectorKeys[key++], vectors[v].latency.max, 1);
+		snprintf(vectorKeys[key], sizeof(vectorKeys[key]), "isr_%s_%d_count", name, v);
+		addResult(vectorKeys[key++], vectors[v].latency.count, 0);
+	}
+
+	addResult("uart_bytes", uartBytes, 0);
+	addResult("message_frames", framesValid, 0);
+	addResult("message_broken", framesBroken, 0);
+	addResult("packets", packetsValid, 0);
+	addResult("packets_broken", packetsBroken, 0);
+	addResult("sequence_gaps", sequenceGaps, 0);
+}
+
+static void writeResults(FILE *file)
+{
+	for (int i = 0; i < resultCount; i++)
+		fprintf(file, "%s %llu\n", results[i].name, (unsigned long long)results[i].value);
+}
+
+/**
+ * @brief Compares every gated result with the baseline file ("name value" per line, # starts a comment).
+ *
+ * @return Number of regressions, -1 if the baseline can not be read
+ */
+static int compareBaseline(const char *path, double tolerance)
+{
+	FILE *file = fopen(path, "r");
+	if (!file)
+	{
+		fprintf(stderr, "[ SIM ERR ]: No baseline at %s, record one with sim/run.sh -o sim/baseline.txt\n", path);
+		return -1;
+	}
+
+	int regressions = 0;
+	char line[128];
+	char name[64];
+	unsigned long long baseline;
+	while (fgets(line, sizeof(line), file))
+	{
+		if (line[0] == '#' || sscanf(line, "%63s %llu", name, &baseline) != 2)
+			continue;
+		for (int i = 0; i < resultCount; i++)
+		{
+			if (!results[i].gated || strcmp(results[i].name, name) != 0)
+				continue;
+			double limit = baseline * (1.0 + tolerance / 100.0);
+			if (results[i].value > limit)
+			{
+				fprintf(stderr, "[ SIM ERR ]: %s regressed: %llu cycles, baseline %llu (+%.1f%% allowed)\n",
+						name, (unsigned long long)results[i].value, baseline, tolerance);
+				regressions++;
+			}
+		}
+	}
+	fclose(file);
+	return regressions;
+}
+
+//==================================================================================================
+static void usage(const char *program)
+{
+	fprintf(stderr, "Usage: %s firmware.elf [-s seconds] [-w sweep|static|noise] [-b baseline] [-t tolerance %%] [-o out]\n", program);
+}
+
+int main(int argc, char **argv)
+{
+	double seconds = SIM_DEFAULT_SECONDS;
+	double tolerance = SIM_DEFAULT_TOLERANCE;
+	const char *baselinePath = NULL;
+	const char *outPath = NULL;
+
+	int option;
+	while ((option = getopt(argc, argv, "s:w:b:t:o:")) != -1)
+	{
+		switch (option)
+		{
+		case 's':
+			seconds = atof(optarg);
+			break;
+		case 'w':
+			if (!scenarioParse(optarg, &scenario))
+			{
+				usage(argv[0]);
+				return 2;
+			}
+			break;
+		case 'b':
+			baselinePath = optarg;
+			break;
+		case 't':
+			tolerance = atof(optarg);
+			break;
+		case 'o':
+			outPath = optarg;
+			break;
+		default:
+			usage(argv[0]);
+			return 2;
+		}
+	}
+	if (optind >= argc)
+	{
+		usage(argv[0]);
+		return 2;
+	}
+
+	elf_firmware_t firmware;
+	memset(&firmware, 0, sizeof(firmware));
+	if (elf_read_firmware(argv[optind], &firmware) != 0)
+	{
+		fprintf(stderr, "[ SIM ERR ]: Can not read %s\n", argv[optind]);
+		return 2;
+	}
+	strcpy(firmware.mmcu, SIM_MCU);
+	firmware.frequency = SIM_FREQUENCY;
+
+	avr = avr_make_mcu_by_name(firmware.mmcu);
+	if (!avr)
+	{
+		fprintf(stderr, "[ SIM ERR ]: Unknown MCU %s\n", firmware.mmcu);
+		return 2;
+	}
+	avr_init(avr);
+	avr_load_firmware(avr, &firmware);
+	avr->frequency = SIM_FREQUENCY;
+	avr->vcc = avr->avcc = avr->aref = SIM_VCC;
+
+	// UART output goes to the frame checker instead of stdout
+	uint32_t uartFlags = 0;
+	avr_ioctl(avr, AVR_IOCTL_UART_GET_FLAGS('0'), &uartFlags);
+	uartFlags &= ~AVR_UART_FLAG_STDIO;
+	avr_ioctl(avr, AVR_IOCTL_UART_SET_FLAGS('0'), &uartFlags);
+	avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_OUTPUT), onUartOutput, NULL);
+
+	echoIrq = avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ(SIM_ECHO_PORT), SIM_ECHO_BIT);
+	adcIrq = avr_io_getirq(avr, AVR_IOCTL_ADC_GETIRQ, ADC_IRQ_ADC0);
+	avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ(SIM_TRIGGER_PORT), SIM_TRIGGER_BIT), onTrigger, NULL);
+	avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ(SIM_LOOP_PORT), SIM_LOOP_BIT), onLoopMarker, NULL);
+	avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ(SIM_FRAME_PORT), SIM_FRAME_BIT), onFrameMarker, NULL);
+
+	for (int v = 1; v < SIM_MAX_VECTORS; v++)
+	{
+		avr_irq_t *irq = avr_get_interrupt_irq(avr, v);
+		if (!irq)
+			continue;
+		avr_irq_register_notify(irq + AVR_INT_IRQ_PENDING, onInterruptPending, &vectors[v]);
+		avr_irq_register_notify(irq + AVR_INT_IRQ_RUNNING, onInterruptRunning, &vectors[v]);
+	}
+
+	avr_cycle_timer_register(avr, 1, scriptTimer, NULL);
+
+	avr_cycle_count_t end = (avr_cycle_count_t)(seconds * SIM_FREQUENCY);
+	int state = cpu_Running;
+	while (avr->cycle < end && state != cpu_Done && state != cpu_Crashed)
+		state = avr_run(avr);
+
+	if (state == cpu_Crashed)
+	{
+		fprintf(stderr, "[ SIM ERR ]: Firmware crashed at cycle %llu\n", (unsigned long long)avr->cycle);
+		return 2;
+	}
+	if (loopIdle.count == 0)
+	{
+		fprintf(stderr, "[ SIM ERR ]: No loop markers, build the firmware with SIM_MARKERS=1 (pio run -e simavr)\n");
+		return 2;
+	}
+
+	collectResults();
+	writeResults(stdout);
+	if (outPath)
+	{
+		FILE *out = fopen(outPath, "w");
+		if (out)
+		{
+			writeResults(out);
+			fclose(out);
+		}
+	}
+
+	int failed = framesBroken > 0 || packetsBroken > 0;
+	if (framesBroken)
+		fprintf(stderr, "[ SIM ERR ]: %llu broken Message frames\n", (unsigned long long)framesBroken);
+	if (packetsBroken)
+		fprintf(stderr, "[ SIM ERR ]: %llu broken packets\n", (unsigned long long)packetsBroken);
+	if (baselinePath && compareBaseline(baselinePath, tolerance) != 0)
+		failed = 1;
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,26 @@
+#!/bin/sh
+# Builds the firmware with SIM_MARKERS=1 and the simavr harness, then runs the timing check.
+#   sim/run.sh [harness options]        compare against sim/baseline.txt
+#   sim/run.sh -o sim/baseline.txt      record a new baseline
+# Needs PlatformIO, simavr (libsimavr + headers) and libelf.
+set -e
+cd "$(dirname "$0")/.."
+
+pio run -e simavr
+
+mkdir -p .pio/sim
+if pkg-config --exists simavr 2>/dev/null; then
+	SIMAVR_FLAGS="$(pkg-config --cflags --libs simavr)"
+else
+	SIMAVR_FLAGS="-I/usr/include/simavr -I/usr/local/include/simavr -lsimavr"
+fi
+# The scenario is shared with the native environment
+cc -O2 -o .pio/sim/SimHarness -Ilib/ArduinoMock/src sim/SimHarness.c lib/ArduinoMock/src/Scenario.c $SIMAVR_FLAGS -lelf -lm
+
+# Recording a baseline does not compare against the old one, a missing baseline fails the check
+for argument in "$@"; do
+	if [ "$argument" = "-o" ]; then
+		exec .pio/sim/SimHarness .pio/build/simavr/firmware.elf "$@"
+	fi
+done
+exec .pio/sim/SimHarness .pio/build/simavr/firmware.elf -b sim/baseline.txt "$@"
@@ -0,0 +1,131 @@
+/**
+ * @file Backlog.cpp
+ * @brief Store-and-forward ring of the last reported samples, replayed when the host asks for them.
+ */
+
+#include "Backlog.h"
+
+/**
+ * @brief Constructs an empty backlog.
+ */
+Backlog::Backlog() : _head(0), _count(0), _sequence(0), _replayNext(0), _replayEnd(0) {}
+
+/**
+ * @brief Stores a reported sample, overwrites the oldest one if the ring is full.
+ *
+ * @param time [us] micros() when the sample was taken
+ * @param distance [cm]
+ * @param photo ADC value
+ */
+void Backlog::add(uint32_t time, float distance, int photo)
+{
+	uint8_t index = (_head + _count) % BACKLOG_SAMPLES;
+	if (_count < BACKLOG_SAMPLES)
+		_count++;
+	else
+		_head = (_head + 1) % BACKLOG_SAMPLES;
+
+	_records[index].time = time;
+	_records[index].distance = distance >= 655.35f ? 0xFFFF : (uint16_t)(distance * 100.0f + 0.5f);
+	_records[index].photo = (uint16_t)photo;
+	_sequence++;
+}
+
+/**
+ * @brief Starts sending every stored sample.
+ *
+ * @note Samples reported after this call are not part of the replay (they go out live). A new call restarts
+ * the replay.
+ */
+void Backlog::replay()
+{
+	_replayNext = oldest();
+	_replayEnd = _sequence;
+}
+
+/**
+ * @brief Starts sending the stored samples from a sequence number on.
+ *
+ * @note The host only sees the low 16 bits, they are resolved to the newest sequence number that ends in them.
+ * Samples that were already overwritten are skipped. If no sequence number that ends in them was reported yet
+ * (a host asking for more than there is shortly after a reset), every stored sample is sent.
+ *
+ * @param from Low 16 bits of the first sequence number the host is missing
+ */
+void Backlog::replay(uint16_t from)
+{
+	uint16_t back = (uint16_t)_sequence - from;
+	_replayNext = back > _sequence ? oldest() : _sequence - back;
+	_replayEnd = _sequence;
+}
+
+/**
+ * @brief true if a replay is not completely sent yet
+ */
+bool Backlog::hasPending() const
+{
+	return cursor() < _replayEnd;
+}
+
+/**
+ * @brief Builds the next PACKET_BACKLOG chunk without marking it as sent.
+ *
+ * Payload: uint32 device time [us], uint32 first sequence, records (uint32 time [us], uint16 distance [0.01 cm],
+ * uint16 photo)
+ *
+ * @param packet
+ * @return uint8_t - Number of records in the chunk, pass it to advance() once the packet is queued
+ */
+uint8_t Backlog::fill(PacketWriter *packet) const
+{
+	uint32_t first = cursor();
+	uint32_t left = _replayEnd - first;
+	uint8_t count = left > BACKLOG_CHUNK_SAMPLES ? BACKLOG_CHUNK_SAMPLES : left;
+
+	packet->begin(PACKET_BACKLOG);
+	packet->putUint32(micros());
+	packet->putUint32(first);
+	for (uint8_t i = 0; i < count; i++)
+	{
+		const Record &record = _records[(_head + (first - oldest()) + i) % BACKLOG_SAMPLES];
+		packet->putUint32(record.time);
+		packet->putUint16(record.distance);
+		packet->putUint16(record.photo);
+	}
+	packet->finish();
+	return count;
+}
+
+/**
+ * @brief Marks records as sent
+ *
+ * @param count
+ */
+void Backlog::advance(uint8_t count)
+{
+	_replayNext = cursor() + count;
+}
+
+/**
+ * @brief Sequence number the next reported sample gets
+ */
+uint32_t Backlog::sequence() const
+{
+	return _sequence;
+}
+
+/**
+ * @brief Sequence number of the oldest stored sample
+ */
+uint32_t Backlog::oldest() const
+{
+	return _sequence - _count;
+}
+
+/**
+ * @brief Next sequence to replay, moved past the samples that were overwritten meanwhile
+ */
+uint32_t Backlog::cursor() const
+{
+	return _replayNext < oldest() ? oldest() : _replayNext;
+}
@@ -0,0 +1,120 @@
+/**
+ * @file Filter.cpp
+ * @brief Integer distance filters for the sensor pipeline.
+ */
+
+#include "Filter.h"
+
+/**
+ * @brief Kalman gain num / den in Q15.
+ *
+ * Both values are scaled down until they fit 16 bits, so the division stays 32 bit.
+ */
+static int32_t gain(int32_t num, int32_t den)
+{
+	bool negative = num < 0;
+	uint32_t n = negative ? -(uint32_t)num : (uint32_t)num;
+	uint32_t d = (uint32_t)den;
+
+	while (n > 0xFFFF || d > 0xFFFF)
+	{
+		n >>= 1;
+		d >>= 1;
+	}
+	if (d == 0)
+		return 0;
+
+	int32_t k = (int32_t)((n << KALMAN_GAIN_BITS) / d);
+	return negative ? -k : k;
+}
+
+static int32_t mulGain(int32_t value, int32_t k)
+{
+	return (int32_t)(((int64_t)value * k) >> KALMAN_GAIN_BITS);
+}
+
+/**
+ * @brief Constructs the filter, the first update() initializes the state.
+ *
+ * @param measurementNoise Standard deviation of one measurement [0.01 cm]
+ * @param processNoise Standard deviation of the acceleration between two samples [0.01 cm / sample^2]
+ */
+KalmanFilter::KalmanFilter(uint16_t measurementNoise, uint16_t processNoise)
+	: _position(0),
+	  _velocity(0),
+	  _p00(0),
+	  _p01(0),
+	  _p11(0),
+	  _r((int32_t)measurementNoise * measurementNoise),
+	  _q((int32_t)processNoise * processNoise),
+	  _initialized(false)
+{
+	if (_r == 0)
+		_r = 1;
+}
+
+/**
+ * @brief Predicts one sample ahead and corrects with the measurement.
+ *
+ * State x = [position, velocity], dt = 1 sample, white acceleration noise:
+ *   P = F P F' + q [1/4 1/2; 1/2 1],  K = P H' / (P00 + r)
+ *
+ * @param measurement [0.01 cm]
+ * @return uint16_t - Filtered position [0.01 cm]
+ */
+uint16_t KalmanFilter::update(uint16_t measurement)
+{
+	int32_t z = (int32_t)measurement << KALMAN_FRAC_BITS;
+
+	if (!_initialized)
+	{
+		_position = z;
+		_velocity = 0;
+		_p00 = _r;
+		_p01 = 0;
+		_p11 = _r;
+		_initialized = true;
+		return measurement;
+	}
+
+	// Predict
+	_position += _velocity;
+	_p00 += 2 * _p01 + _p11 + _q / 4;
+	_p01 += _p11 + _q / 2;
+	_p11 += _q;
+
+	// Correct
+	int32_t k0 = gain(_p00, _p00 + _r);
+	int32_t k1 = gain(_p01, _p00 + _r);
+	int32_t innovation = z - _position;
+	_position += mulGain(innovation, k0);
+	_velocity += mulGain(innovation, k1);
+
+	int32_t p01 = _p01;
+	_p00 -= mulGain(_p00, k0);
+	_p01 -= mulGain(_p01, k0);
+	_p11 -= mulGain(p01, k1);
+
+	int32_t position = (_position + (1L << (KALMAN_FRAC_BITS - 1))) >> KALMAN_FRAC_BITS;
+	if (position < 0)
+		return 0;
+	if (position > 0xFFFF)
+		return 0xFFFF;
+	return (uint16_t)position;
+}
+
+/**
+ * @brief Forgets the state, the next update() starts over from its measurement
+ */
+void KalmanFilter::reset()
+{
+	_initialized = false;
+}
+
+/**
+ * @brief Estimated velocity [0.01 cm / sample]
+ */
+int16_t KalmanFilter::velocity() const
+{
+	return (int16_t)(_velocity >> KALMAN_FRAC_BITS);
+}
@@ -0,0 +1,262 @@
+/**
+ * @file Packet.cpp
+ * @brief Variable length, typed packet framing used next to the fixed 11 byte Message.
+ */
+
+#include "Packet.h"
+
+/**
+ * @brief Constructs an empty packet writer.
+ */
+PacketWriter::PacketWriter() : _size(0) {}
+
+/**
+ * @brief Starts a new packet of the given type, dropping any previous content.
+ *
+ * @param type Packet type (PACKET_*)
+ */
+void PacketWriter::begin(uint8_t type)
+{
+	_buffer[0] = PACKET_START;
+	_buffer[1] = type;
+	_buffer[2] = 0;
+	_size = PACKET_HEADER_SIZE;
+}
+
+/**
+ * @brief Appends one payload byte.
+ *
+ * @param value
+ * @return false if the payload is full
+ */
+bool PacketWriter::put(uint8_t value)
+{
+	if (payloadSize() >= PACKET_MAX_PAYLOAD)
+		return false;
+	_buffer[_size++] = value;
+	return true;
+}
+
+/**
+ * @brief Appends an unsigned LEB128 varint (7 bits per byte, MSB set on every byte but the last).
+ *
+ * @note The value is either written completely or not at all.
+ *
+ * @param value
+ * @return false if the value does not fit into the payload
+ */
+bool PacketWriter::putVarint(uint32_t value)
+{
+	uint8_t bytes[5];
+	uint8_t count = 0;
+
+	while (value >= 0x80)
+	{
+		bytes[count++] = (uint8_t)value | 0x80;
+		value >>= 7;
+	}
+	bytes[count++] = (uint8_t)value;
+
+	if (payloadSize() + count > PACKET_MAX_PAYLOAD)
+		return false;
+
+	for (uint8_t i = 0; i < count; i++)
+	{
+		_buffer[_size++] = bytes[i];
+	}
+	return true;
+}
+
+/**
+ * @brief Appends a signed value as a zigzag encoded varint, so small negative numbers stay short.
+ *
+ * @param value
+ * @return false if the value does not fit into the payload
+ */
+bool PacketWriter::putZigzag(int32_t value)
+{
+	return putVarint(((uint32_t)value << 1) ^ (uint32_t)(value >> 31));
+}
+
+/**
+ * @brief Appends a little endian uint16.
+ *
+ * @param value
+ * @return false if the value does not fit into the payload
+ */
+bool PacketWriter::putUint16(uint16_t value)
+{
+	if (payloadSize() + 2 > PACKET_MAX_PAYLOAD)
+		return false;
+	_buffer[_size++] = (uint8_t)value;
+	_buffer[_size++] = (uint8_t)(value >> 8);
+	return true;
+}
+
+/**
+ * @brief Appends a little endian uint32.
+ *
+ * @param value
+ * @return false if the value does not fit into the payload
+ */
+bool PacketWriter::putUint32(uint32_t value)
+{
+	if (payloadSize() + 4 > PACKET_MAX_PAYLOAD)
+		return false;
+	for (uint8_t i = 0; i < 4; i++)
+	{
+		_buffer[_size++] = (uint8_t)value;
+		value >>= 8;
+	}
+	return true;
+}
+
+/**
+ * @brief Fills in the length, check sum and end byte.
+ *
+ * @return uint8_t - Total packet size in bytes
+ */
+uint8_t PacketWriter::finish()
+{
+	_buffer[2] = payloadSize();
+
+	uint8_t checkSum = 0;
+	for (uint8_t i = 0; i < _size; i++)
+	{
+		checkSum ^= _buffer[i];
+	}
+	_buffer[_size++] = checkSum;
+	_buffer[_size++] = PACKET_END;
+	return _size;
+}
+
+/**
+ * @brief Raw packet bytes, valid after finish()
+ */
+const uint8_t *PacketWriter::data() const
+{
+	return _buffer;
+}
+
+/**
+ * @brief Number of bytes written so far
+ */
+uint8_t PacketWriter::size() const
+{
+	return _size;
+}
+
+/**
+ * @brief Number of payload bytes written so far
+ */
+uint8_t PacketWriter::payloadSize() const
+{
+	return _size - PACKET_HEADER_SIZE;
+}
+
+//==================================================================================================
+/**
+ * @brief Constructs an empty packet reader.
+ */
+PacketReader::PacketReader() : _size(0), _expected(0), _errors(0) {}
+
+/**
+ * @brief Feeds one received byte into the reader.
+ *
+ * Bytes in front of a start byte are skipped. A packet that is too long for the receive buffer,
+ * has a bad check sum or a bad end byte is dropped and counted in errors().
+ *
+ * @param byte
+ * @return true if a complete, valid packet is available
+ */
+bool PacketReader::push(uint8_t byte)
+{
+	if (_size == 0 && byte != PACKET_START)
+		return false;
+
+	_buffer[_size++] = byte;
+
+	if (_size == PACKET_HEADER_SIZE)
+	{
+		if (byte > PACKET_RX_MAX_PAYLOAD)
+		{
+			_errors++;
+			reset();
+			return false;
+		}
+		_expected = PACKET_HEADER_SIZE + byte + PACKET_TRAILER_SIZE;
+	}
+
+	if (_size < PACKET_HEADER_SIZE || _size < _expected)
+		return false;
+
+	uint8_t checkSum = 0;
+	for (uint8_t i = 0; i < _size - PACKET_TRAILER_SIZE; i++)
+	{
+		checkSum ^= _buffer[i];
+	}
+
+	bool valid = (checkSum == _buffer[_size - 2]) && (_buffer[_size - 1] == PACKET_END);
+	if (!valid)
+		_errors++;
+
+	_size = 0;
+	_expected = 0;
+	return valid;
+}
+
+/**
+ * @brief Drops any partially received packet
+ */
+void PacketReader::reset()
+{
+	_size = 0;
+	_expected = 0;
+}
+
+/**
+ * @brief Type of the last complete packet
+ */
+uint8_t PacketReader::type() const
+{
+	return _buffer[1];
+}
+
+/**
+ * @brief Payload of the last complete packet
+ */
+const uint8_t *PacketReader::payload() const
+{
+	return _buffer + PACKET_HEADER_SIZE;
+}
+
+/**
+ * @brief Payload size of the last complete packet
+ */
+uint8_t PacketReader::payloadSize() const
+{
+	return _buffer[2];
+}
+
+/**
+ * @brief Reads a little endian uint32 from the payload of the last complete packet.
+ *
+ * @param offset Payload offset
+ * @return 0 if the payload is too short
+ */
+uint32_t PacketReader::readUint32(uint8_t offset) const
+{
+	if (offset + 4 > payloadSize())
+		return 0;
+
+	const uint8_t *ptr = payload() + offset;
+	return (uint32_t)ptr[0] | ((uint32_t)ptr[1] << 8) | ((uint32_t)ptr[2] << 16) | ((uint32_t)ptr[3] << 24);
+}
+
+/**
+ * @brief Number of dropped (too long or corrupted) packets
+ */
+uint16_t PacketReader::errors() const
+{
+	return _errors;
+}
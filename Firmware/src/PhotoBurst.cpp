@@ -0,0 +1,104 @@
+/**
+ * @file PhotoBurst.cpp
+ * @brief Timer triggered high rate capture of one analog input into SRAM: rate, buffer and chunking.
+ */
+
+#include "PhotoBurst.h"
+
+PhotoBurst photoBurst;
+
+/**
+ * @brief Constructs an idle burst, nothing is captured until start().
+ */
+PhotoBurst::PhotoBurst() : _captured(0), _capturing(false), _sent(0), _rate(0), _id(0), _savedTCCR1A(0), _savedTCCR1B(0) {}
+
+/**
+ * @brief Starts capturing BURST_SAMPLES samples of an analog pin.
+ *
+ * @param pin Analog pin (A0 - A7)
+ * @param rate [Hz] BURST_MIN_RATE - BURST_MAX_RATE, rounded to what Timer1 can divide
+ * @return false if the rate is out of range or a burst is still being captured or sent
+ */
+bool PhotoBurst::start(uint8_t pin, uint16_t rate)
+{
+	if (rate < BURST_MIN_RATE || rate > BURST_MAX_RATE || isCapturing() || hasPending())
+		return false;
+
+	uint16_t top = BURST_TIMER_CLOCK / rate - 1;
+	_rate = BURST_TIMER_CLOCK / ((uint32_t)top + 1);
+	_captured = 0;
+	_sent = 0;
+	_id++;
+	_capturing = true;
+
+	beginCapture(pin, top);
+	return true;
+}
+
+/**
+ * @brief true if a captured burst is not completely sent yet
+ */
+bool PhotoBurst::hasPending() const
+{
+	return !isCapturing() && _sent < _captured;
+}
+
+/**
+ * @brief Builds the next PACKET_BURST_DATA chunk without marking it as sent.
+ *
+ * Payload: uint8 id, uint16 rate [Hz], uint16 total samples, uint16 offset, samples (ADC >> 2)
+ *
+ * @param packet
+ * @return uint8_t - Number of samples in the chunk, pass it to advance() once the packet is queued
+ */
+uint8_t PhotoBurst::fill(PacketWriter *packet) const
+{
+	uint16_t left = _captured - _sent;
+	uint8_t count = left > BURST_CHUNK_SAMPLES ? BURST_CHUNK_SAMPLES : left;
+
+	packet->begin(PACKET_BURST_DATA);
+	packet->put(_id);
+	packet->putUint16(_rate);
+	packet->putUint16(_captured);
+	packet->putUint16(_sent);
+	for (uint8_t i = 0; i < count; i++)
+	{
+		packet->put(_samples[_sent + i]);
+	}
+	packet->finish();
+	return count;
+}
+
+/**
+ * @brief Marks samples as sent
+ *
+ * @param count
+ */
+void PhotoBurst::advance(uint8_t count)
+{
+	_sent += count;
+}
+
+/**
+ * @brief Effective sample rate of the last burst [Hz]
+ */
+uint16_t PhotoBurst::rate() const
+{
+	return _rate;
+}
+
+/**
+ * @brief Stores one conversion, stops the capture after the last one. Called from adcInterrupt().
+ */
+void PhotoBurst::store(uint8_t sample)
+{
+	if (!_capturing)
+		return;
+
+	_samples[_captured] = sample;
+	if (++_captured >= BURST_SAMPLES)
+	{
+		endCapture();
+		_capturing = false;
+	}
+}
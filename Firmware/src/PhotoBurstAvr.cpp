@@ -0,0 +1,64 @@
+/**
+ * @file PhotoBurstAvr.cpp
+ * @brief Capture hardware of PhotoBurst: Timer1 compare match B auto-triggers the ADC.
+ */
+
+#include "PhotoBurst.h"
+
+ISR(ADC_vect)
+{
+	photoBurst.adcInterrupt();
+}
+
+/**
+ * @brief Takes Timer1 and the ADC over and starts the conversions
+ *
+ * @param pin Analog pin (A0 - A7)
+ * @param top Timer1 TOP, one conversion every top + 1 timer clocks
+ */
+void PhotoBurst::beginCapture(uint8_t pin, uint16_t top)
+{
+	_savedTCCR1A = TCCR1A;
+	_savedTCCR1B = TCCR1B;
+	TCCR1B = 0;
+	TCCR1A = 0;
+	TCNT1 = 0;
+	OCR1A = top;
+	OCR1B = top;
+	TIFR1 = _BV(OCF1B);
+
+	ADMUX = _BV(REFS0) | _BV(ADLAR) | ((pin - A0) & 0x07); // AVcc reference, 8 bit result in ADCH
+	ADCSRB = _BV(ADTS2) | _BV(ADTS0);					   // Trigger on Timer1 compare match B
+	ADCSRA = _BV(ADEN) | _BV(ADATE) | _BV(ADIE) | _BV(ADIF) | _BV(ADPS2) | _BV(ADPS1);
+
+	TCCR1B = _BV(WGM12) | _BV(CS11); // CTC on OCR1A, prescaler 8
+}
+
+/**
+ * @brief Gives Timer1 and the ADC back in the state the Arduino core set them up
+ */
+void PhotoBurst::endCapture()
+{
+	TCCR1B = 0;
+	ADCSRA = _BV(ADEN) | _BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0);
+	ADCSRB = 0;
+	TCCR1A = _savedTCCR1A;
+	TCCR1B = _savedTCCR1B;
+}
+
+/**
+ * @brief true while the ADC is filling the buffer
+ */
+bool PhotoBurst::isCapturing() const
+{
+	return _capturing;
+}
+
+/**
+ * @brief ADC conversion complete: stores the sample, stops after the last one.
+ */
+void PhotoBurst::adcInterrupt()
+{
+	TIFR1 = _BV(OCF1B); // The next compare match has to raise the flag again to trigger
+	store(ADCH);
+}
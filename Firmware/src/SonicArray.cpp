@@ -0,0 +1,166 @@
+/**
+ * @file SonicArray.cpp
+ * @brief Non-blocking ranging with several SRF-04 sensors.
+ */
+
+#include "SonicArray.h"
+
+SonicArray *SonicArray::active = nullptr;
+
+ISR(PCINT0_vect)
+{
+	if (SonicArray::active)
+		SonicArray::active->echoInterrupt();
+}
+
+ISR(PCINT1_vect)
+{
+	if (SonicArray::active)
+		SonicArray::active->echoInterrupt();
+}
+
+ISR(PCINT2_vect)
+{
+	if (SonicArray::active)
+		SonicArray::active->echoInterrupt();
+}
+
+/**
+ * @brief Constructs a sensor array, the pins are set up in begin().
+ *
+ * @param trigPins Trigger pin of every sensor
+ * @param echoPins Echo pin of every sensor
+ * @param count Number of sensors (at most SONIC_ARRAY_MAX, 0 leaves the array idle)
+ * @param guardTime [us] Time between two triggers, against crosstalk
+ */
+SonicArray::SonicArray(const uint8_t *trigPins, const uint8_t *echoPins, uint8_t count, uint32_t guardTime)
+	: _count(count > SONIC_ARRAY_MAX ? SONIC_ARRAY_MAX : count), _next(0), _guardTime(guardTime), _lastTrigger(0)
+{
+	for (uint8_t i = 0; i < _count; i++)
+	{
+		_channels[i].trigPin = trigPins[i];
+		_channels[i].echoPin = echoPins[i];
+		_channels[i].state = SONIC_IDLE;
+		_distance[i] = 0;
+	}
+}
+
+/**
+ * @brief Sets the pin modes and enables the pin change interrupt of every echo pin.
+ */
+void SonicArray::begin()
+{
+	active = this;
+	for (uint8_t i = 0; i < _count; i++)
+	{
+		Channel &channel = _channels[i];
+		pinMode(channel.trigPin, OUTPUT);
+		digitalWrite(channel.trigPin, LOW);
+		pinMode(channel.echoPin, INPUT);
+
+		channel.echoPort = portInputRegister(digitalPinToPort(channel.echoPin));
+		channel.echoMask = digitalPinToBitMask(channel.echoPin);
+		*digitalPinToPCMSK(channel.echoPin) |= _BV(digitalPinToPCMSKbit(channel.echoPin));
+		PCICR |= _BV(digitalPinToPCICRbit(channel.echoPin));
+	}
+}
+
+/**
+ * @brief Collects finished echoes and triggers the next sensor. Call it every loop().
+ */
+void SonicArray::update()
+{
+	if (_count == 0)
+		return;
+
+	uint32_t now = micros();
+
+	for (uint8_t i = 0; i < _count; i++)
+	{
+		Channel &channel = _channels[i];
+		uint8_t state = channel.state;
+
+		if (state == SONIC_DONE)
+		{
+			// The interrupt does not touch a finished channel, no need to lock
+			_distance[i] = (channel.duration / 2) * 0.0343f; // [cm] || 0.0343f [cm / microsecond]
+		}
+		else if ((state == SONIC_WAIT_RISE || state == SONIC_WAIT_FALL) && now - channel.triggerTime > SONIC_ECHO_TIMEOUT)
+		{
+			_distance[i] = 0; // Same as a pulseIn timeout
+		}
+		else
+		{
+			continue;
+		}
+
+		channel.state = SONIC_IDLE;
+	}
+
+	if (now - _lastTrigger >= _guardTime && _channels[_next].state == SONIC_IDLE)
+	{
+		trigger(_next);
+		_lastTrigger = now;
+		_next = (_next + 1) % _count;
+	}
+}
+
+/**
+ * @brief Last measured distance of a sensor
+ *
+ * @param index
+ * @return float [cm], 0 if the echo timed out
+ */
+float SonicArray::getDistance(uint8_t index) const
+{
+	return index < _count ? _distance[index] : 0;
+}
+
+/**
+ * @brief Number of sensors
+ */
+uint8_t SonicArray::count() const
+{
+	return _count;
+}
+
+/**
+ * @brief Timestamps the echo edges of every waiting sensor.
+ */
+void SonicArray::echoInterrupt()
+{
+	uint32_t now = micros();
+
+	for (uint8_t i = 0; i < _count; i++)
+	{
+		Channel &channel = _channels[i];
+		bool level = (*channel.echoPort & channel.echoMask) != 0;
+
+		if (channel.state == SONIC_WAIT_RISE && level)
+		{
+			channel.start = now;
+			channel.state = SONIC_WAIT_FALL;
+		}
+		else if (channel.state == SONIC_WAIT_FALL && !level)
+		{
+			channel.duration = now - channel.start;
+			channel.state = SONIC_DONE;
+		}
+	}
+}
+
+/**
+ * @brief Sends the 10 us trigger pulse to one sensor.
+ *
+ * @param index
+ */
+void SonicArray::trigger(uint8_t index)
+{
+	Channel &channel = _channels[index];
+
+	channel.state = SONIC_WAIT_RISE;
+	channel.triggerTime = micros();
+	digitalWrite(channel.trigPin, HIGH);
+	delayMicroseconds(10);
+	digitalWrite(channel.trigPin, LOW);
+}
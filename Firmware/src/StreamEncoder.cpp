@@ -0,0 +1,109 @@
+/**
+ * @file StreamEncoder.cpp
+ * @brief Delta + zigzag varint compression of the sensor sample stream.
+ */
+
+#include "StreamEncoder.h"
+
+/**
+ * @brief Constructs a stream encoder.
+ *
+ * @param batchSize Samples per block (more samples = less framing overhead, more latency)
+ * @param keyframeInterval Every n-th block is a keyframe, so a receiver can join or recover after n blocks
+ */
+StreamEncoder::StreamEncoder(uint8_t batchSize, uint8_t keyframeInterval)
+	: _batchSize(batchSize ? batchSize : 1), _keyframeInterval(keyframeInterval ? keyframeInterval : 1), _count(0),
+	  _blocksSinceKey(0), _blockCounter(0), _lastDistance(0), _lastPhoto(0), _lastTime(0) {}
+
+/**
+ * @brief Adds one sample to the current block.
+ *
+ * @param sequence Sequence number of the sample, one more than the sample before it
+ * @param time [us] micros() when the sample was taken
+ * @param distance Sonic distance [cm]
+ * @param photo Photo cell ADC value
+ * @return true if a block was completed and packet() is ready to be sent
+ */
+bool StreamEncoder::add(uint16_t sequence, uint32_t time, float distance, int photo)
+{
+	int32_t iDistance = (int32_t)(distance * 100.0f + 0.5f);
+	int32_t iPhoto = photo;
+
+	if (_count == 0)
+	{
+		if (_blocksSinceKey == 0)
+		{
+			// Keyframe: first sample is encoded against zero, which makes it absolute
+			_lastDistance = 0;
+			_lastPhoto = 0;
+			_packet.begin(PACKET_STREAM_KEY);
+		}
+		else
+		{
+			_packet.begin(PACKET_STREAM_DELTA);
+		}
+		_packet.put(_blockCounter++);
+		_packet.putUint16(sequence);
+		_packet.putUint32(time);
+	}
+	else
+	{
+		_packet.putVarint(time - _lastTime);
+	}
+
+	_packet.putZigzag(iDistance - _lastDistance);
+	_packet.putZigzag(iPhoto - _lastPhoto);
+	_lastDistance = iDistance;
+	_lastPhoto = iPhoto;
+	_lastTime = time;
+	_count++;
+
+	// Close the block early if the next sample might not fit
+	if (_count >= _batchSize || _packet.payloadSize() + STREAM_SAMPLE_MAX_SIZE > PACKET_MAX_PAYLOAD)
+		return finishBlock();
+	return false;
+}
+
+/**
+ * @brief Closes a partially filled block.
+ *
+ * @return true if there was anything to close and packet() is ready to be sent
+ */
+bool StreamEncoder::flush()
+{
+	if (_count == 0)
+		return false;
+	return finishBlock();
+}
+
+/**
+ * @brief Drops the current block and makes the next one a keyframe.
+ */
+void StreamEncoder::reset()
+{
+	_count = 0;
+	_blocksSinceKey = 0;
+}
+
+/**
+ * @brief The last completed block
+ */
+const PacketWriter &StreamEncoder::packet() const
+{
+	return _packet;
+}
+
+/**
+ * @brief Finishes the packet of the current block and advances the keyframe counter.
+ *
+ * @return true
+ */
+bool StreamEncoder::finishBlock()
+{
+	_packet.finish();
+	_count = 0;
+	_blocksSinceKey++;
+	if (_blocksSinceKey >= _keyframeInterval)
+		_blocksSinceKey = 0;
+	return true;
+}
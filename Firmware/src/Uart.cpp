@@ -0,0 +1,227 @@
+/**
+ * @file Uart.cpp
+ * @brief Interrupt driven USART0 driver with a large TX ring and block enqueue.
+ */
+
+#include "Uart.h"
+#include <util/atomic.h>
+
+#define TX_MASK (UART_TX_BUFFER_SIZE - 1)
+#define RX_MASK (UART_RX_BUFFER_SIZE - 1)
+
+static_assert((UART_TX_BUFFER_SIZE & TX_MASK) == 0 && UART_TX_BUFFER_SIZE <= 256, "UART_TX_BUFFER_SIZE must be a power of two <= 256");
+static_assert((UART_RX_BUFFER_SIZE & RX_MASK) == 0 && UART_RX_BUFFER_SIZE <= 256, "UART_RX_BUFFER_SIZE must be a power of two <= 256");
+
+Uart uart;
+
+ISR(USART_UDRE_vect)
+{
+	uart.txInterrupt();
+}
+
+ISR(USART_RX_vect)
+{
+	uart.rxInterrupt();
+}
+
+/**
+ * @brief Constructs the driver, the UART stays off until begin().
+ */
+Uart::Uart() : _txHead(0), _txTail(0), _rxHead(0), _rxTail(0), _written(false), _stats() {}
+
+/**
+ * @brief Starts the UART in 8N1 mode.
+ *
+ * Uses double speed (U2X0) whenever the divider allows it, that is what makes 250000, 500000 and
+ * 1000000 baud exact on a 16 MHz board.
+ *
+ * @param baud
+ */
+void Uart::begin(uint32_t baud)
+{
+	uint16_t ubrr = (F_CPU / 4 / baud - 1) / 2;
+	bool doubleSpeed = true;
+	if (ubrr > 4095)
+	{
+		ubrr = (F_CPU / 8 / baud - 1) / 2;
+		doubleSpeed = false;
+	}
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		UCSR0B = 0;
+		UCSR0A = doubleSpeed ? _BV(U2X0) : 0;
+		UBRR0H = ubrr >> 8;
+		UBRR0L = ubrr;
+		UCSR0C = _BV(UCSZ01) | _BV(UCSZ00); // 8 data bits, no parity, 1 stop bit
+		_txHead = _txTail = 0;
+		_rxHead = _rxTail = 0;
+		_written = false;
+		UCSR0B = _BV(RXEN0) | _BV(TXEN0) | _BV(RXCIE0);
+	}
+}
+
+/**
+ * @brief Waits for pending data, then turns the UART off.
+ */
+void Uart::end()
+{
+	flush();
+	UCSR0B = 0;
+}
+
+/**
+ * @brief Blocks until the TX ring is empty and the last byte left the shift register.
+ *
+ * @note Only meant for baud rate changes, the normal send path never waits.
+ */
+void Uart::flush()
+{
+	if (!_written)
+		return;
+	while ((UCSR0B & _BV(UDRIE0)) || !(UCSR0A & _BV(TXC0)))
+	{
+	}
+}
+
+/**
+ * @brief Copies a whole frame into the TX ring without blocking.
+ *
+ * @param data
+ * @param size
+ * @return false if the frame does not fit ("would block"), nothing is queued and txDropped is incremented
+ */
+bool Uart::enqueue(const uint8_t *data, uint8_t size)
+{
+	if (size > txFree())
+	{
+		_stats.txDropped++;
+		return false;
+	}
+
+	// Only the ISR moves the tail, so the head can be advanced without locking
+	uint8_t head = _txHead;
+	uint16_t first = UART_TX_BUFFER_SIZE - head;
+	if (first > size)
+		first = size;
+	memcpy(_txBuffer + head, data, first);
+	memcpy(_txBuffer, data + first, size - first);
+	_txHead = (head + size) & TX_MASK;
+
+	_written = true;
+	UCSR0B |= _BV(UDRIE0);
+	return true;
+}
+
+/**
+ * @brief Queues a single byte, used by the Print helpers (debug output).
+ *
+ * @param value
+ * @return 1 if queued, 0 if the TX ring was full
+ */
+size_t Uart::write(uint8_t value)
+{
+	return enqueue(&value, 1) ? 1 : 0;
+}
+
+/**
+ * @brief Free space in the TX ring [bytes]
+ */
+uint8_t Uart::txFree() const
+{
+	return (uint8_t)((_txTail - _txHead - 1) & TX_MASK);
+}
+
+/**
+ * @brief Number of received bytes waiting in the RX ring
+ */
+int Uart::available() const
+{
+	return (uint8_t)((_rxHead - _rxTail) & RX_MASK);
+}
+
+/**
+ * @brief Takes one byte from the RX ring.
+ *
+ * @return The byte, or -1 if the RX ring is empty
+ */
+int Uart::read()
+{
+	uint8_t tail = _rxTail;
+	if (tail == _rxHead)
+		return -1;
+	uint8_t value = _rxBuffer[tail];
+	_rxTail = (tail + 1) & RX_MASK;
+	return value;
+}
+
+/**
+ * @brief Baud rate the UART really runs at, calculated from the UBRR0 divider and the U2X0 bit
+ *
+ * @return uint32_t
+ */
+uint32_t Uart::effectiveBaudRate() const
+{
+	uint8_t divider = (UCSR0A & _BV(U2X0)) ? 8 : 16;
+	return F_CPU / ((uint32_t)divider * (UBRR0 + 1));
+}
+
+/**
+ * @brief Consistent copy of the drop and error counters
+ */
+UartStats Uart::stats() const
+{
+	UartStats copy;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		copy.txDropped = _stats.txDropped;
+		copy.rxOverruns = _stats.rxOverruns;
+		copy.rxFrameErrors = _stats.rxFrameErrors;
+	}
+	return copy;
+}
+
+/**
+ * @brief Data register empty interrupt: moves the next byte from the TX ring into UDR0.
+ */
+void Uart::txInterrupt()
+{
+	uint8_t tail = _txTail;
+	if (tail == _txHead)
+	{
+		UCSR0B &= ~_BV(UDRIE0);
+		return;
+	}
+
+	UDR0 = _txBuffer[tail];
+	_txTail = (tail + 1) & TX_MASK;
+
+	// Clear TXC0 (by writing 1) so flush() can tell when the last byte is out, keep U2X0
+	UCSR0A = (UCSR0A & (_BV(U2X0) | _BV(MPCM0))) | _BV(TXC0);
+
+	if (_txTail == _txHead)
+		UCSR0B &= ~_BV(UDRIE0);
+}
+
+/**
+ * @brief Receive complete interrupt: stores the byte and counts line errors.
+ */
+void Uart::rxInterrupt()
+{
+	uint8_t status = UCSR0A;
+	uint8_t value = UDR0;
+
+	if (status & _BV(FE0))
+		_stats.rxFrameErrors++;
+	if (status & _BV(DOR0))
+		_stats.rxOverruns++;
+
+	uint8_t next = (_rxHead + 1) & RX_MASK;
+	if (next == _rxTail)
+	{
+		_stats.rxOverruns++;
+		return;
+	}
+	_rxBuffer[_rxHead] = value;
+	_rxHead = next;
+}
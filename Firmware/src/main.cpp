@@ -2,9 +2,29 @@
 #include <stdbool.h>
 #include <LiquidCrystal_I2C.h>
 #include "AntiDelay.h"
+#include "StreamEncoder.h"
+#include "Uart.h"
+#include "SonicArray.h"
+#include "Pipeline.h"
+#include "Filter.h"
+#include "PhotoBurst.h"
+#include "Backlog.h"
 
 #define DEBUG 0
 
+#ifndef SIM_MARKERS
+#define SIM_MARKERS 0 // 1 - marker pins for the simavr harness (sim/): D9 toggles every loop(), D10 is high while a sample is processed
+#endif
+
+#define STREAM_COMPRESSED 0		   // 1 - send delta compressed sample blocks instead of single samples
+#define TIMED_SAMPLES 1			   // 1 - send single samples as PACKET_SAMPLE (sequence, micros) instead of Message frames
+#define STREAM_BATCH_SIZE 8		   // Samples per compressed block
+#define STREAM_KEYFRAME_INTERVAL 8 // Every n-th compressed block is a keyframe
+
+#define LINK_DEFAULT_BAUD 9600
+#define LINK_CONFIRM_TIMEOUT 1000  // [ms] Fall back if the host does not confirm a new baud rate
+#define LINK_WATCHDOG_TIMEOUT 3000 // [ms] Fall back if the host goes silent at a negotiated baud rate
+
 #define TRIGGER_PIN 5
 #define ECHO_PIN 4
 #define LED1 8
@@ -12,11 +32,44 @@
 #define LED3 6
 #define PHOTOCELL A0
 
+#define SONIC_ARRAY 0				 // 1 - range with the non-blocking SonicArray instead of Sonic
+#define SONIC_TRIGGER_PINS {TRIGGER_PIN} // One entry per sensor, sensor 0 drives the LEDs and the Message
+#define SONIC_ECHO_PINS {ECHO_PIN}
+#define SONIC_GUARD_TIME 15000UL // [us] Time between two triggers
+
+#ifndef SONIC_FILTER
+#define SONIC_FILTER 1 // 1 - median + Kalman filter on the distance, the raw value goes out in PACKET_SONIC_RAW
+#endif
+#define SONIC_MEDIAN_WINDOW 5		// [samples] 3, 5 or 7
+#define SONIC_MEASUREMENT_NOISE 50	// [0.01 cm] Standard deviation of one ping
+#define SONIC_PROCESS_NOISE 20		// [0.01 cm / sample^2] Standard deviation of the acceleration between two samples
+
 #define LCD_COLS 16
 #define LCD_ROWS 4
 #define LCD_1_ADDR 0x70
 #define LCD_2_ADDR 0x7E
 
+#define SENSOR_INTERVAL 500			 // [ms] Default sample interval
+#define SENSOR_MIN_INTERVAL 1		 // [ms] Limits for PACKET_CMD_SET_INTERVAL, SAMPLE_*_INTERVAL on the host
+#define SENSOR_MAX_INTERVAL 3600000UL // [ms]
+
+#define REPORT_ON_CHANGE 0		// 1 - only send samples that moved beyond the deadband (or on heartbeat)
+#define DEADBAND_DISTANCE 0.5f	// [cm]
+#define DEADBAND_PHOTO 8		// [ADC]
+#define HEARTBEAT_INTERVAL 5000 // [ms] Longest time without a sample in report on change mode
+
+#define BULK_TX_RESERVE 24 // [bytes] Left free in the TX ring for samples while a burst or the backlog is sent
+
+#if SIM_MARKERS
+#define SIM_LOOP_MARK() (PINB = _BV(PINB1)) // Writing 1 into PINx toggles the pin
+#define SIM_FRAME_BEGIN() (PORTB |= _BV(PORTB2))
+#define SIM_FRAME_END() (PORTB &= ~_BV(PORTB2))
+#else
+#define SIM_LOOP_MARK()
+#define SIM_FRAME_BEGIN()
+#define SIM_FRAME_END()
+#endif
+
 // Message structure
 typedef struct
 {
@@ -71,9 +124,67 @@ public:
 	}
 };
 
+// Pipeline sensors (see Pipeline.h)
+template <uint8_t Pin>
+struct PhotoCellSensor
+{
+	typedef int value_type;
+	static void begin() { pinMode(Pin, INPUT); }
+	static int read() { return analogRead(Pin); }
+};
+
+template <Sonic &Sensor>
+struct SonicSensor
+{
+	typedef float value_type;
+	static void begin() {}
+	static float read() { return Sensor.getDistance(); }
+};
+
+template <SonicArray &Array, uint8_t Index>
+struct SonicArraySensor
+{
+	typedef float value_type;
+	static void begin() {}
+	static float read() { return Array.getDistance(Index); }
+};
+
+#if DEBUG
+// Prints every pipeline channel, used with SensorPipeline::forEach
+struct PrintChannel
+{
+	template <class T>
+	void operator()(uint8_t index, T value)
+	{
+		uart.print("Channel ");
+		uart.print(index);
+		uart.print(": ");
+		uart.println(value);
+	}
+};
+#endif
+
 // Fucntions declarations
 
 bool sendUARTMessage(Message *msg);
+bool sendUARTPacket(const PacketWriter *packet);
+void handleSerialInput();
+void handleCommand();
+void handleLink();
+void setBaudRate(uint32_t baud);
+bool isSupportedBaudRate(uint32_t baud);
+void sendLinkStatus(uint8_t state);
+void sendStats();
+void sendAck(uint8_t command, uint8_t result);
+void sendTime(uint32_t tag, uint32_t time);
+void setCompression(bool enabled);
+bool shouldReport();
+void reportSample();
+void sendSample(uint16_t sequence);
+void sendSonicArray();
+void sendSonicRaw();
+void handleBurst();
+void handleBacklog();
 void convertToMessage(float fSonicData, int iPhotoData, Message *buffer);
 bool decodeMessage(Message *buffer, float *fSonicData, int *iPhotoData);
 uint8_t calculateCheckSum(Message *msg);
@@ -84,13 +195,63 @@ void writeLCD();
 // Class declarations
 LiquidCrystal_I2C lcd1(LCD_1_ADDR, LCD_COLS, LCD_ROWS);
 LiquidCrystal_I2C lcd2(LCD_2_ADDR, LCD_COLS, LCD_ROWS);
+#if SONIC_ARRAY
+const uint8_t sonicTriggerPins[] = SONIC_TRIGGER_PINS;
+const uint8_t sonicEchoPins[] = SONIC_ECHO_PINS;
+SonicArray sonicArray(sonicTriggerPins, sonicEchoPins, sizeof(sonicTriggerPins), SONIC_GUARD_TIME);
+#else
 Sonic sonicSensor(TRIGGER_PIN, ECHO_PIN);
-AntiDelay sensorReadings(500);
+#endif
+
+#if SONIC_FILTER
+typedef DistanceFilter<SONIC_MEDIAN_WINDOW, SONIC_MEASUREMENT_NOISE, SONIC_PROCESS_NOISE> SonicFilter;
+#else
+typedef NoFilter SonicFilter;
+#endif
+
+// Sampled in this order every SENSOR_INTERVAL, add a channel here to add a sensor
+#define CHANNEL_PHOTO 0
+#define CHANNEL_DISTANCE 1
+typedef Pipeline<
+	Channel<PhotoCellSensor<PHOTOCELL>>,
+#if SONIC_ARRAY
+	Channel<SonicArraySensor<sonicArray, 0>, SonicFilter>
+#else
+	Channel<SonicSensor<sonicSensor>, SonicFilter>
+#endif
+	>
+	SensorPipeline;
+SensorPipeline sensors;
+
+AntiDelay sensorReadings(SENSOR_INTERVAL);
+StreamEncoder streamEncoder(STREAM_BATCH_SIZE, STREAM_KEYFRAME_INTERVAL);
+AntiDelay linkWatchdog(LINK_WATCHDOG_TIMEOUT);
+AntiDelay heartbeat(HEARTBEAT_INTERVAL);
+PacketReader commandReader;
+PacketWriter replyPacket;
+Backlog backlog;
 Message buffer;
 
 // Global variable declarations
 int photoCellValue = 0;
 float sonicDistance = 0;
+uint32_t sampleTime = 0; // [us] micros() when the current sample was taken
+bool streamCompressed = STREAM_COMPRESSED;
+uint32_t sensorInterval = SENSOR_INTERVAL;
+bool sensorPaused = false;
+uint32_t samplesTaken = 0;
+uint32_t samplesReported = 0;
+bool reportOnChange = REPORT_ON_CHANGE;
+float deadbandDistance = DEADBAND_DISTANCE;
+int deadbandPhoto = DEADBAND_PHOTO;
+uint32_t heartbeatInterval = HEARTBEAT_INTERVAL;
+float reportedDistance = 0;
+int reportedPhoto = 0;
+const uint32_t supportedBaudRates[] = {9600, 115200, 250000, 500000, 1000000};
+uint32_t linkBaud = LINK_DEFAULT_BAUD;
+uint32_t linkRequestedBaud = LINK_DEFAULT_BAUD;
+uint8_t linkState = LINK_STATE_DEFAULT;
+uint16_t linkFallbacks = 0;
 const float ledUpperLimit = 15.00f;	 // [cm]
 const float ledBottomLimit = 10.00f; // [cm]
 
@@ -101,9 +262,15 @@ void setup()
 	pinMode(LED1, OUTPUT);
 	pinMode(LED2, OUTPUT);
 	pinMode(LED3, OUTPUT);
-	pinMode(PHOTOCELL, INPUT);
+	sensors.begin();
+#if SIM_MARKERS
+	DDRB |= _BV(DDB1) | _BV(DDB2);
+#endif
 
-	Serial.begin(9600);
+	uart.begin(LINK_DEFAULT_BAUD);
+#if SONIC_ARRAY
+	sonicArray.begin();
+#endif
 
 	delay(500);
 }
@@ -123,29 +290,40 @@ void setup()
 */
 void loop()
 {
-	if (sensorReadings)
+#if SONIC_ARRAY
+	sonicArray.update();
+#endif
+	SIM_LOOP_MARK();
+	if (!photoBurst.isCapturing() && sensorReadings) // The ADC belongs to the burst until it is full
 	{
-		photoCellValue = analogRead(PHOTOCELL);
-		sonicDistance = sonicSensor.getDistance();
-		convertToMessage(sonicDistance, photoCellValue, &buffer);
-		sendUARTMessage(&buffer);
+		SIM_FRAME_BEGIN();
+		sampleTime = micros();
+		sensors.sample();
+		photoCellValue = sensors.value<CHANNEL_PHOTO>();
+		sonicDistance = sensors.value<CHANNEL_DISTANCE>();
+		samplesTaken++;
+		if (shouldReport())
+			reportSample();
 		writeLCD();
+		SIM_FRAME_END();
 #if DEBUG
-		Serial.print("Photo cell value: ");
-		Serial.println(photoCellValue);
-		Serial.print("Sonic distance: ");
-		Serial.println(sonicDistance);
-		Serial.print("Sending message: ");
+		PrintChannel printChannel;
+		sensors.forEach(printChannel);
+		uart.print("Sending message: ");
 		for (int i = 0; i < sizeof(Message); i++)
 		{
 			uint8_t *ptr = (uint8_t *)&buffer;
-			Serial.print(ptr[i], HEX);
-			Serial.print(" ");
+			uart.print(ptr[i], HEX);
+			uart.print(" ");
 			ptr++;
 		}
-		Serial.println();
+		uart.println();
 #endif
 	}
+	handleSerialInput();
+	handleBurst();
+	handleBacklog();
+	handleLink();
 	handleLEDs();
 }
 
@@ -160,22 +338,458 @@ void loop()
 |__/      \______/ |__/  |__/ \_______/   \___/  |__/ \______/ |__/  |__/|_______/
 */
 /**
- * @brief Send message over UART
+ * @brief Queue message for sending over UART, never blocks
  *
  * @param Message*
- * @return true
+ * @return false if the TX ring is full and the message was dropped
  */
 bool sendUARTMessage(Message *msg)
 {
-	uint8_t *msgPtr = (uint8_t *)msg;
-	uint8_t msgSize = sizeof(Message);
+	return uart.enqueue((uint8_t *)msg, sizeof(Message));
+}
+
+//==================================================================================================
+/**
+ * @brief Queue a finished packet for sending over UART, never blocks
+ *
+ * @param PacketWriter*
+ * @return false if the TX ring is full and the packet was dropped
+ */
+bool sendUARTPacket(const PacketWriter *packet)
+{
+	return uart.enqueue(packet->data(), packet->size());
+}
+
+//==================================================================================================
+/**
+ * @brief Decide if the current sample has to be sent
+ *
+ * @note In report on change mode a sample is sent if any channel moved beyond its deadband since the
+ * last sent sample, or if nothing was sent for heartbeatInterval. Otherwise every sample is sent.
+ *
+ * @return bool
+ */
+bool shouldReport()
+{
+	if (!reportOnChange)
+		return true;
+
+	bool expired = heartbeat;
+	bool changed = (fabs(sonicDistance - reportedDistance) > deadbandDistance) ||
+				   (abs(photoCellValue - reportedPhoto) > deadbandPhoto);
+	return expired || changed;
+}
+
+//==================================================================================================
+/**
+ * @brief Send the current sample as a PACKET_SAMPLE (or Message) or into the compressed stream
+ *
+ * @note The sequence number counts reported samples, a gap on the host means a lost frame, not a quiet sensor.
+ */
+void reportSample()
+{
+	uint16_t sequence = (uint16_t)backlog.sequence();
+	if (streamCompressed)
+	{
+		if (streamEncoder.add(sequence, sampleTime, sonicDistance, photoCellValue))
+			sendUARTPacket(&streamEncoder.packet());
+	}
+	else
+	{
+#if TIMED_SAMPLES
+		sendSample(sequence);
+#else
+		convertToMessage(sonicDistance, photoCellValue, &buffer);
+		sendUARTMessage(&buffer);
+#endif
+	}
+#if SONIC_ARRAY
+	sendSonicArray();
+#endif
+#if SONIC_FILTER
+	sendSonicRaw();
+#endif
+	backlog.add(sampleTime, sonicDistance, photoCellValue);
+
+	reportedDistance = sonicDistance;
+	reportedPhoto = photoCellValue;
+	samplesReported++;
+	heartbeat.reset();
+}
+
+#if TIMED_SAMPLES
+//==================================================================================================
+/**
+ * @brief Send the current sample with its sequence number and acquisition time
+ *
+ * @param uint16_t sequence
+ */
+void sendSample(uint16_t sequence)
+{
+	replyPacket.begin(PACKET_SAMPLE);
+	replyPacket.putUint16(sequence);
+	replyPacket.putUint32(sampleTime);
+	replyPacket.putUint16(sonicDistance >= 655.35f ? 0xFFFF : (uint16_t)(sonicDistance * 100.0f + 0.5f));
+	replyPacket.putUint16((uint16_t)photoCellValue);
+	replyPacket.finish();
+	sendUARTPacket(&replyPacket);
+}
+#endif
+
+#if SONIC_ARRAY
+//==================================================================================================
+/**
+ * @brief Send the last distance of every sensor in one packet
+ *
+ */
+void sendSonicArray()
+{
+	replyPacket.begin(PACKET_SONIC_ARRAY);
+	replyPacket.put(sonicArray.count());
+	for (uint8_t i = 0; i < sonicArray.count(); i++)
+	{
+		replyPacket.putUint16((uint16_t)(sonicArray.getDistance(i) * 100.0f + 0.5f));
+	}
+	replyPacket.finish();
+	sendUARTPacket(&replyPacket);
+}
+#endif
+
+#if SONIC_FILTER
+//==================================================================================================
+/**
+ * @brief Send the unfiltered and the filtered distance of the reported sample
+ *
+ */
+void sendSonicRaw()
+{
+	float raw = sensors.channel<CHANNEL_DISTANCE>().raw();
+	replyPacket.begin(PACKET_SONIC_RAW);
+	replyPacket.putUint16(raw >= 655.35f ? 0xFFFF : (uint16_t)(raw * 100.0f + 0.5f));
+	replyPacket.putUint16((uint16_t)(sonicDistance * 100.0f + 0.5f));
+	replyPacket.finish();
+	sendUARTPacket(&replyPacket);
+}
+#endif
+
+//==================================================================================================
+/**
+ * @brief Send a captured burst in PACKET_BURST_DATA chunks, only while the TX ring has room to spare
+ *
+ */
+void handleBurst()
+{
+	while (photoBurst.hasPending())
+	{
+		uint8_t count = photoBurst.fill(&replyPacket);
+		if (uart.txFree() < replyPacket.size() + BULK_TX_RESERVE)
+			return;
+		sendUARTPacket(&replyPacket);
+		photoBurst.advance(count);
+	}
+}
+
+//==================================================================================================
+/**
+ * @brief Replay the requested part of the backlog in PACKET_BACKLOG chunks, only while the TX ring has room
+ * to spare
+ *
+ */
+void handleBacklog()
+{
+	while (backlog.hasPending())
+	{
+		uint8_t count = backlog.fill(&replyPacket);
+		if (uart.txFree() < replyPacket.size() + BULK_TX_RESERVE)
+			return;
+		sendUARTPacket(&replyPacket);
+		backlog.advance(count);
+	}
+}
+
+//==================================================================================================
+/**
+ * @brief Feed every received byte into the command reader, without blocking
+ *
+ */
+void handleSerialInput()
+{
+	while (uart.available() > 0)
+	{
+		if (commandReader.push((uint8_t)uart.read()))
+			handleCommand();
+	}
+}
+
+//==================================================================================================
+/**
+ * @brief Execute the command held by the command reader
+ *
+ */
+void handleCommand()
+{
+	// Any valid packet proves the link works at the current baud rate
+	linkWatchdog.reset();
+
+	switch (commandReader.type())
+	{
+	case PACKET_CMD_BAUD:
+	{
+		uint32_t baud = commandReader.readUint32(0);
+		linkRequestedBaud = baud;
+		if (!isSupportedBaudRate(baud))
+		{
+			sendLinkStatus(LINK_STATE_REJECTED);
+			break;
+		}
+		// Reply at the old rate, then switch and wait for the host to confirm at the new one
+		linkState = LINK_STATE_ACCEPTED;
+		sendLinkStatus(linkState);
+		setBaudRate(baud);
+		linkWatchdog.setInterval(LINK_CONFIRM_TIMEOUT);
+		linkWatchdog.reset();
+		break;
+	}
+	case PACKET_CMD_BAUD_CONFIRM:
+		if (linkState == LINK_STATE_ACCEPTED)
+		{
+			linkState = (linkBaud == LINK_DEFAULT_BAUD) ? LINK_STATE_DEFAULT : LINK_STATE_CONFIRMED;
+			linkWatchdog.setInterval(LINK_WATCHDOG_TIMEOUT);
+		}
+		sendLinkStatus(linkState);
+		break;
+	case PACKET_CMD_PING:
+		sendLinkStatus(linkState);
+		break;
+	case PACKET_CMD_SET_INTERVAL:
+	{
+		uint32_t interval = commandReader.readUint32(0);
+		if (interval < SENSOR_MIN_INTERVAL || interval > SENSOR_MAX_INTERVAL)
+		{
+			sendAck(PACKET_CMD_SET_INTERVAL, ACK_BAD_ARGUMENT);
+			break;
+		}
+		sensorInterval = interval;
+		sensorReadings.setInterval(interval);
+		sendAck(PACKET_CMD_SET_INTERVAL, ACK_OK);
+		break;
+	}
+	case PACKET_CMD_PAUSE:
+		sensorReadings.pause();
+		sensorPaused = true;
+		sendAck(PACKET_CMD_PAUSE, ACK_OK);
+		break;
+	case PACKET_CMD_RESUME:
+		sensorReadings.resume();
+		sensorPaused = false;
+		sendAck(PACKET_CMD_RESUME, ACK_OK);
+		break;
+	case PACKET_CMD_GET_STATS:
+		sendStats();
+		break;
+	case PACKET_CMD_SET_COMPRESSION:
+		if (commandReader.payloadSize() < 1)
+		{
+			sendAck(PACKET_CMD_SET_COMPRESSION, ACK_BAD_ARGUMENT);
+			break;
+		}
+		setCompression(commandReader.payload()[0] != 0);
+		sendAck(PACKET_CMD_SET_COMPRESSION, ACK_OK);
+		break;
+	case PACKET_CMD_SET_DEADBAND:
+	{
+		if (commandReader.payloadSize() < 8)
+		{
+			sendAck(PACKET_CMD_SET_DEADBAND, ACK_BAD_ARGUMENT);
+			break;
+		}
+		const uint8_t *payload = commandReader.payload();
+		deadbandDistance = (payload[0] | (payload[1] << 8)) * 0.01f;
+		deadbandPhoto = payload[2] | (payload[3] << 8);
+		heartbeatInterval = commandReader.readUint32(4);
+		reportOnChange = heartbeatInterval > 0;
+		if (reportOnChange)
+			heartbeat.setInterval(heartbeatInterval);
+		sendAck(PACKET_CMD_SET_DEADBAND, ACK_OK);
+		break;
+	}
+	case PACKET_CMD_BURST:
+	{
+		if (commandReader.payloadSize() < 2)
+		{
+			sendAck(PACKET_CMD_BURST, ACK_BAD_ARGUMENT);
+			break;
+		}
+		const uint8_t *payload = commandReader.payload();
+		uint16_t rate = payload[0] | (payload[1] << 8);
+		sendAck(PACKET_CMD_BURST, photoBurst.start(PHOTOCELL, rate) ? ACK_OK : ACK_BAD_ARGUMENT);
+		break;
+	}
+	case PACKET_CMD_REPLAY:
+		if (commandReader.payloadSize() >= 2)
+			backlog.replay((uint16_t)(commandReader.payload()[0] | (commandReader.payload()[1] << 8)));
+		else
+			backlog.replay();
+		sendAck(PACKET_CMD_REPLAY, ACK_OK);
+		break;
+	case PACKET_CMD_TIME:
+		if (commandReader.payloadSize() < 4)
+		{
+			sendAck(PACKET_CMD_TIME, ACK_BAD_ARGUMENT);
+			break;
+		}
+		sendTime(commandReader.readUint32(0), micros());
+		break;
+	default:
+		sendAck(commandReader.type(), ACK_UNKNOWN_COMMAND);
+		break;
+	}
+}
+
+//==================================================================================================
+/**
+ * @brief Switch between Message frames and the compressed stream
+ *
+ * @param bool enabled
+ */
+void setCompression(bool enabled)
+{
+	if (enabled == streamCompressed)
+		return;
+
+	// Send what is already collected, the next block after switching back on starts with a keyframe
+	if (streamCompressed && streamEncoder.flush())
+		sendUARTPacket(&streamEncoder.packet());
+	streamEncoder.reset();
+	streamCompressed = enabled;
+}
+
+//==================================================================================================
+/**
+ * @brief Fall back to the default baud rate if the host did not confirm a new rate or went silent
+ *
+ */
+void handleLink()
+{
+	if (linkBaud == LINK_DEFAULT_BAUD || !linkWatchdog)
+		return;
 
-	for (uint8_t i = 0; i < msgSize; i++)
+	linkFallbacks++;
+	linkState = LINK_STATE_DEFAULT;
+	setBaudRate(LINK_DEFAULT_BAUD);
+	linkWatchdog.setInterval(LINK_WATCHDOG_TIMEOUT);
+	sendLinkStatus(linkState);
+}
+
+//==================================================================================================
+/**
+ * @brief Restart the UART at the given baud rate once every pending byte is sent
+ *
+ * @param uint32_t baud
+ */
+void setBaudRate(uint32_t baud)
+{
+	uart.flush();
+	uart.begin(baud);
+	linkBaud = baud;
+	commandReader.reset();
+}
+
+//==================================================================================================
+/**
+ * @brief Check if the baud rate is in the supported list
+ *
+ * @param uint32_t baud
+ * @return bool
+ */
+bool isSupportedBaudRate(uint32_t baud)
+{
+	for (uint8_t i = 0; i < sizeof(supportedBaudRates) / sizeof(supportedBaudRates[0]); i++)
 	{
-		Serial.write(msgPtr[i]);
+		if (supportedBaudRates[i] == baud)
+			return true;
 	}
+	return false;
+}
+
+//==================================================================================================
+/**
+ * @brief Send the link state, baud rates, error and UART drop counters to the host
+ *
+ * @param uint8_t state - LINK_STATE_*
+ */
+void sendLinkStatus(uint8_t state)
+{
+	replyPacket.begin(PACKET_LINK_STATUS);
+	replyPacket.put(state);
+	replyPacket.putUint32(linkRequestedBaud);
+	replyPacket.putUint32(uart.effectiveBaudRate());
+	replyPacket.putUint16(commandReader.errors());
+	replyPacket.putUint16(linkFallbacks);
+
+	UartStats stats = uart.stats();
+	replyPacket.putUint16(stats.txDropped);
+	replyPacket.putUint16(stats.rxOverruns);
+	replyPacket.putUint16(stats.rxFrameErrors);
+	replyPacket.finish();
+	sendUARTPacket(&replyPacket);
+}
 
-	return true;
+//==================================================================================================
+/**
+ * @brief Send sampling state and counters to the host
+ *
+ */
+void sendStats()
+{
+	UartStats stats = uart.stats();
+	uint8_t flags = (sensorPaused ? STATS_FLAG_PAUSED : 0) | (streamCompressed ? STATS_FLAG_COMPRESSED : 0) |
+					(reportOnChange ? STATS_FLAG_REPORT_ON_CHANGE : 0);
+
+	replyPacket.begin(PACKET_STATS);
+	replyPacket.putUint32(sensorInterval);
+	replyPacket.put(flags);
+	replyPacket.putUint32(samplesTaken);
+	replyPacket.putUint32(millis());
+	replyPacket.putUint16(commandReader.errors());
+	replyPacket.putUint16(stats.txDropped);
+	replyPacket.putUint16(stats.rxOverruns);
+	replyPacket.putUint16(stats.rxFrameErrors);
+	replyPacket.putUint32(samplesReported);
+	replyPacket.finish();
+	sendUARTPacket(&replyPacket);
+}
+
+//==================================================================================================
+/**
+ * @brief Acknowledge a command
+ *
+ * @param uint8_t command - PACKET_CMD_*
+ * @param uint8_t result - ACK_*
+ */
+void sendAck(uint8_t command, uint8_t result)
+{
+	replyPacket.begin(PACKET_ACK);
+	replyPacket.put(command);
+	replyPacket.put(result);
+	replyPacket.finish();
+	sendUARTPacket(&replyPacket);
+}
+
+//==================================================================================================
+/**
+ * @brief Answer a time exchange, the host brackets the device time between its send and receive time
+ *
+ * @param uint32_t tag - Echoed so the host can match the reply to its request
+ * @param uint32_t time - [us] micros() when the command was handled
+ */
+void sendTime(uint32_t tag, uint32_t time)
+{
+	replyPacket.begin(PACKET_TIME);
+	replyPacket.putUint32(tag);
+	replyPacket.putUint32(time);
+	replyPacket.finish();
+	sendUARTPacket(&replyPacket);
 }
 
 //==================================================================================================
@@ -214,7 +828,7 @@ bool decodeMessage(Message *buffer, float *fSonicData, int *iPhotoData)
 	if (checkSum != buffer->cs)
 	{
 #if DEBUG
-		Serial.println("Check sum error on buffer!");
+		uart.println("Check sum error on buffer!");
 #endif
 		return 1;
 	}
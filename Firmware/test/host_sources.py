@@ -0,0 +1,10 @@
+# Adds the sources of the PC program the native unit tests run against (extra_scripts of env:native)
+
+Import("env")
+
+HOST_DIR = "$PROJECT_DIR/../Program cpp v2"
+HOST_SOURCES = ["+<SequenceTracker.cpp>"]
+
+if "test" in env.GetBuildType():
+    env.Append(CPPPATH=[HOST_DIR])
+    env.BuildSources("$BUILD_DIR/host", HOST_DIR, HOST_SOURCES)
@@ -0,0 +1,138 @@
+/**
+ * @file test_main.cpp
+ * @brief Backlog replay against the host side loss accounting: pio test -e native
+ *
+ * SequenceTracker.cpp of the PC program is added to the test build by host_sources.py.
+ */
+
+#include <unity.h>
+#include "Backlog.h"
+#include "SequenceTracker.h"
+
+/**
+ * @brief Sends the pending replay, checks the chunks are in order and counts the records
+ */
+static uint32_t drain(Backlog &backlog, uint32_t first)
+{
+	PacketWriter packet;
+	uint32_t sent = 0;
+	while (backlog.hasPending())
+	{
+		uint8_t count = backlog.fill(&packet);
+		uint32_t sequence;
+		memcpy(&sequence, packet.data() + PACKET_HEADER_SIZE + 4, 4);
+		TEST_ASSERT_EQUAL_UINT32(first + sent, sequence);
+		backlog.advance(count);
+		sent += count;
+	}
+	return sent;
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+/**
+ * @brief A host connecting right after a reset asks for the samples before the first one it saw
+ */
+void test_reconnect_below_depth()
+{
+	for (uint16_t seen = 1; seen < BACKLOG_SAMPLES; seen++)
+	{
+		Backlog backlog;
+		for (uint16_t i = 0; i <= seen; i++)
+			backlog.add(i * 1000UL, 10.0f, i);
+
+		SequenceTracker tracker(BACKLOG_SAMPLES);
+		tracker.push(seen, seen * 1000UL);
+		TEST_ASSERT_TRUE(tracker.hasMissing());
+		TEST_ASSERT_EQUAL_UINT16(0, tracker.firstMissing());
+
+		backlog.replay(tracker.firstMissing());
+		TEST_ASSERT_EQUAL_UINT32(seen + 1, drain(backlog, 0));
+	}
+}
+
+/**
+ * @brief A sequence number the device has not reached yet replays everything stored
+ */
+void test_replay_ahead_of_device()
+{
+	Backlog backlog;
+	for (uint16_t i = 0; i < 5; i++)
+		backlog.add(i * 1000UL, 10.0f, i);
+
+	backlog.replay((uint16_t)0xFFE5);
+	TEST_ASSERT_EQUAL_UINT32(5, drain(backlog, 0));
+}
+
+/**
+ * @brief Past the 16 bit wrap the low bits still resolve to the stored samples
+ */
+void test_replay_after_wrap()
+{
+	Backlog backlog;
+	for (uint32_t i = 0; i < 70000UL; i++)
+		backlog.add(i, 10.0f, 0);
+
+	backlog.replay((uint16_t)(70000UL - 10));
+	TEST_ASSERT_EQUAL_UINT32(10, drain(backlog, 70000UL - 10));
+}
+
+/**
+ * @brief Feeds the tracker samples 0 .. count - 1 taken every interval microseconds
+ */
+static void feed(SequenceTracker &tracker, uint32_t count, uint32_t interval)
+{
+	for (uint32_t i = 0; i < count; i++)
+		tracker.push((uint16_t)i, i * interval);
+}
+
+/**
+ * @brief The sequence number and micros() wrapping in a running device is no restart
+ */
+void test_wrap_is_not_restart()
+{
+	SequenceTracker tracker(BACKLOG_SAMPLES);
+	feed(tracker, 70000UL, 500000UL);
+
+	TEST_ASSERT_EQUAL_UINT32(0, tracker.restarts());
+	TEST_ASSERT_EQUAL_UINT32(0, tracker.lost());
+	TEST_ASSERT_FALSE(tracker.hasMissing());
+}
+
+/**
+ * @brief A reset at sequence 40000 unwraps as a jump forward, the device time gives it away. At 500 ms micros()
+ * is in its upper half (both counters went back), at 30 ms in its lower half (micros() stepped back).
+ */
+void test_reset_above_half()
+{
+	const uint32_t intervals[] = {500000UL, 30000UL};
+	for (uint32_t interval : intervals)
+	{
+		SequenceTracker tracker(BACKLOG_SAMPLES);
+		feed(tracker, 40001UL, interval);
+		TEST_ASSERT_EQUAL_UINT32(0, tracker.restarts());
+
+		// The first samples after the reset were lost while the link fell back to 9600 baud
+		tracker.push(6, 3500000UL);
+		TEST_ASSERT_EQUAL_UINT32(1, tracker.restarts());
+		TEST_ASSERT_EQUAL_UINT32(0, tracker.lost());
+		TEST_ASSERT_TRUE(tracker.hasMissing());
+		TEST_ASSERT_EQUAL_UINT16(0, tracker.firstMissing());
+
+		tracker.push(7, 3500000UL + interval);
+		TEST_ASSERT_EQUAL_UINT32(1, tracker.restarts());
+	}
+}
+
+int main()
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_reconnect_below_depth);
+	RUN_TEST(test_replay_ahead_of_device);
+	RUN_TEST(test_replay_after_wrap);
+	RUN_TEST(test_wrap_is_not_restart);
+	RUN_TEST(test_reset_above_half);
+	return UNITY_END();
+}
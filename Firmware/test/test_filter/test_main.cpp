@@ -0,0 +1,109 @@
+/**
+ * @file test_main.cpp
+ * @brief The default firmware (SONIC_FILTER 1) on the mocks: every sample comes with its raw distance and the
+ * filter keeps a lost echo out of the reported value: pio test -e native
+ */
+
+#include <unity.h>
+#include "ArduinoMock.h"
+#include "Packet.h"
+#include "Uart.h"
+
+#define TEST_LOOP_TIME 20		// [us] Virtual time of one loop() pass
+#define TEST_ECHO_PIN 4			// ECHO_PIN of main.cpp
+#define TEST_US_PER_CM 58.31f	// Echo time for 1 cm of distance
+#define TEST_DISTANCE 20.0f		// [cm]
+#define TEST_MAX_LOOPS 1000000UL // Gives up on a sample after this many passes (20 s virtual time)
+
+// Firmware counters (main.cpp)
+extern uint32_t samplesReported;
+
+static uint8_t packet[PACKET_MAX_SIZE];
+static uint8_t packetSize = 0;
+static uint32_t samples = 0;
+static uint32_t raws = 0;
+static uint16_t raw = 0;	  // [0.01 cm] Last PACKET_SONIC_RAW
+static uint16_t filtered = 0; // [0.01 cm]
+
+/**
+ * @brief Collects the PACKET_SAMPLE and PACKET_SONIC_RAW packets the firmware sends
+ */
+static void onTransmit(uint8_t value)
+{
+	if (packetSize == 0 && value != PACKET_START)
+		return;
+	packet[packetSize++] = value;
+	if (packetSize < PACKET_HEADER_SIZE || packetSize < PACKET_HEADER_SIZE + packet[2] + PACKET_TRAILER_SIZE)
+		return;
+
+	packetSize = 0;
+	if (packet[1] == PACKET_SAMPLE)
+		samples++;
+	else if (packet[1] == PACKET_SONIC_RAW && packet[2] == 4)
+	{
+		raw = packet[3] | (packet[4] << 8);
+		filtered = packet[5] | (packet[6] << 8);
+		raws++;
+	}
+}
+
+/**
+ * @brief Runs loop() until the firmware reported the given number of further samples and sent them
+ */
+static void runSamples(uint32_t count, float distance)
+{
+	mockSetPulse(TEST_ECHO_PIN, (unsigned long)(distance * TEST_US_PER_CM));
+	uint32_t target = samplesReported + count;
+	for (unsigned long i = 0; i < TEST_MAX_LOOPS && samplesReported < target; i++)
+	{
+		loop();
+		mockAdvanceMicros(TEST_LOOP_TIME);
+	}
+	uart.flush();
+	TEST_ASSERT_EQUAL_UINT32(target, samplesReported);
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+/**
+ * @brief Every reported sample is followed by its raw distance
+ */
+void test_raw_with_every_sample()
+{
+	uint32_t first = samples;
+	runSamples(10, TEST_DISTANCE);
+
+	TEST_ASSERT_EQUAL_UINT32(10, samples - first);
+	TEST_ASSERT_EQUAL_UINT32(samples, raws);
+	TEST_ASSERT_UINT16_WITHIN(5, (uint16_t)(TEST_DISTANCE * 100), raw);
+	TEST_ASSERT_UINT16_WITHIN(5, (uint16_t)(TEST_DISTANCE * 100), filtered);
+}
+
+/**
+ * @brief A ping without echo (0 cm) shows in the raw value only
+ */
+void test_lost_echo_filtered()
+{
+	runSamples(10, TEST_DISTANCE);
+	runSamples(1, 0.0f);
+
+	TEST_ASSERT_EQUAL_UINT16(0, raw);
+	TEST_ASSERT_UINT16_WITHIN(20, (uint16_t)(TEST_DISTANCE * 100), filtered);
+
+	runSamples(1, TEST_DISTANCE);
+	TEST_ASSERT_UINT16_WITHIN(20, (uint16_t)(TEST_DISTANCE * 100), filtered);
+}
+
+int main()
+{
+	mockUartSetSink(onTransmit);
+	mockSetPulse(TEST_ECHO_PIN, (unsigned long)(TEST_DISTANCE * TEST_US_PER_CM));
+	setup();
+
+	UNITY_BEGIN();
+	RUN_TEST(test_raw_with_every_sample);
+	RUN_TEST(test_lost_echo_filtered);
+	return UNITY_END();
+}
@@ -0,0 +1,244 @@
+#include "ChunkFile.h"
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+/**
+ * @brief Construct a new chunk builder object with an empty chunk
+ */
+ChunkBuilder::ChunkBuilder()
+{
+	this->reset();
+}
+
+/**
+ * @brief Appends a sample to the open chunk
+ *
+ * @param time [us] Unix time
+ * @param sonic [cm]
+ * @param photo [ADC]
+ */
+void ChunkBuilder::add(int64_t time, float sonic, float photo)
+{
+	ChunkHeader& header = this->m_header;
+	if (header.count == 0)
+	{
+		header.timeMin = header.timeMax = time;
+		header.sonicMin = header.sonicMax = sonic;
+		header.photoMin = header.photoMax = photo;
+	}
+	header.count++;
+	header.timeMin = time < header.timeMin ? time : header.timeMin;
+	header.timeMax = time > header.timeMax ? time : header.timeMax;
+	header.sonicMin = sonic < header.sonicMin ? sonic : header.sonicMin;
+	header.sonicMax = sonic > header.sonicMax ? sonic : header.sonicMax;
+	header.photoMin = photo < header.photoMin ? photo : header.photoMin;
+	header.photoMax = photo > header.photoMax ? photo : header.photoMax;
+	header.sonicSum += sonic;
+	header.photoSum += photo;
+
+	this->m_timeEncoder.add(time, &this->m_time);
+	this->m_sonicEncoder.add(sonic, &this->m_sonic);
+	this->m_photoEncoder.add(photo, &this->m_photo);
+}
+
+/**
+ * @brief Appends the chunk to a store file in one write and starts a new one
+ *
+ * @param fd Store file opened with O_APPEND
+ *
+ * @return false if the write failed, the chunk is lost
+ */
+bool ChunkBuilder::write(int fd)
+{
+	if (this->m_header.count == 0)
+		return true;
+
+	this->m_time.finish();
+	this->m_sonic.finish();
+	this->m_photo.finish();
+	this->m_header.timeBytes = static_cast<uint32_t>(this->m_time.bytes().size());
+	this->m_header.sonicBytes = static_cast<uint32_t>(this->m_sonic.bytes().size());
+	this->m_header.photoBytes = static_cast<uint32_t>(this->m_photo.bytes().size());
+
+	iovec parts[4] = {
+		{&this->m_header, sizeof(ChunkHeader)},
+		{const_cast<uint8_t*>(this->m_time.bytes().data()), this->m_time.bytes().size()},
+		{const_cast<uint8_t*>(this->m_sonic.bytes().data()), this->m_sonic.bytes().size()},
+		{const_cast<uint8_t*>(this->m_photo.bytes().data()), this->m_photo.bytes().size()},
+	};
+	size_t size = sizeof(ChunkHeader) + this->m_header.timeBytes + this->m_header.sonicBytes + this->m_header.photoBytes;
+	bool written = writev(fd, parts, 4) == static_cast<ssize_t>(size);
+
+	this->reset();
+	return written;
+}
+
+/**
+ * @brief Samples in the open chunk
+ */
+uint32_t ChunkBuilder::count() const
+{
+	return this->m_header.count;
+}
+
+/**
+ * @brief Empties the open chunk, the column memory is kept
+ */
+void ChunkBuilder::reset()
+{
+	memset(&this->m_header, 0, sizeof(ChunkHeader));
+	this->m_header.magic = STORE_MAGIC;
+	this->m_header.version = STORE_VERSION;
+	this->m_header.headerSize = sizeof(ChunkHeader);
+	this->m_time.clear();
+	this->m_sonic.clear();
+	this->m_photo.clear();
+	this->m_timeEncoder.reset();
+	this->m_sonicEncoder.reset();
+	this->m_photoEncoder.reset();
+}
+
+//==================================================================================================
+/**
+ * @brief Construct a new chunk file object, nothing is mapped until open()
+ */
+ChunkFile::ChunkFile()
+{
+}
+
+/**
+ * @brief Unmaps the file
+ */
+ChunkFile::~ChunkFile()
+{
+	this->close();
+}
+
+/**
+ * @brief Maps a store file and indexes its chunks.
+ *
+ * @details Only the headers are touched. A chunk cut short at the end (the daemon died while writing it) and
+ * anything after a damaged header is left out.
+ *
+ * @return false if the file can not be mapped
+ */
+bool ChunkFile::open(const std::string& path)
+{
+	this->close();
+	int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return false;
+
+	struct stat status;
+	if (fstat(fd, &status) != 0)
+	{
+		::close(fd);
+		return false;
+	}
+	if (status.st_size == 0)
+	{
+		::close(fd);
+		return true;
+	}
+
+	void* memory = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (memory == MAP_FAILED)
+		return false;
+	this->m_data = static_cast<const uint8_t*>(memory);
+	this->m_size = static_cast<size_t>(status.st_size);
+
+	size_t offset = 0;
+	while (offset + sizeof(ChunkHeader) <= this->m_size)
+	{
+		// Chunks have any length, so a header in the mapping is usually not aligned
+		Chunk chunk;
+		memcpy(&chunk.header, this->m_data + offset, sizeof(ChunkHeader));
+		const ChunkHeader& header = chunk.header;
+		if (header.magic != STORE_MAGIC || header.version != STORE_VERSION || header.headerSize < sizeof(ChunkHeader))
+			break;
+
+		size_t size = header.headerSize + static_cast<size_t>(header.timeBytes) + header.sonicBytes + header.photoBytes;
+		if (offset + size > this->m_size)
+			break;
+		chunk.columns = this->m_data + offset + header.headerSize;
+		this->m_chunks.push_back(chunk);
+		offset += size;
+	}
+	return true;
+}
+
+/**
+ * @brief Unmaps the file
+ */
+void ChunkFile::close()
+{
+	if (this->m_data != nullptr)
+		munmap(const_cast<uint8_t*>(this->m_data), this->m_size);
+	this->m_data = nullptr;
+	this->m_size = 0;
+	this->m_chunks.clear();
+}
+
+/**
+ * @brief Number of complete chunks
+ */
+size_t ChunkFile::size() const
+{
+	return this->m_chunks.size();
+}
+
+/**
+ * @brief Summary of a chunk
+ */
+const ChunkHeader& ChunkFile::header(size_t index) const
+{
+	return this->m_chunks[index].header;
+}
+
+/**
+ * @brief Decodes the columns of a chunk
+ *
+ * @param index
+ * @param times Out [us], header(index).count values, nullptr to skip the column
+ * @param sonic Out [cm], nullptr to skip the column
+ * @param photo Out [ADC], nullptr to skip the column
+ *
+ * @return Number of samples
+ */
+size_t ChunkFile::decode(size_t index, int64_t* times, float* sonic, float* photo) const
+{
+	const ChunkHeader& header = this->m_chunks[index].header;
+	const uint8_t* column = this->m_chunks[index].columns;
+
+	if (times != nullptr)
+	{
+		BitReader reader(column, header.timeBytes);
+		TimestampDecoder decoder;
+		for (uint32_t i = 0; i < header.count; i++)
+			times[i] = decoder.next(&reader);
+	}
+	column += header.timeBytes;
+
+	if (sonic != nullptr)
+	{
+		BitReader reader(column, header.sonicBytes);
+		FloatDecoder decoder;
+		for (uint32_t i = 0; i < header.count; i++)
+			sonic[i] = decoder.next(&reader);
+	}
+	column += header.sonicBytes;
+
+	if (photo != nullptr)
+	{
+		BitReader reader(column, header.photoBytes);
+		FloatDecoder decoder;
+		for (uint32_t i = 0; i < header.count; i++)
+			photo[i] = decoder.next(&reader);
+	}
+	return header.count;
+}
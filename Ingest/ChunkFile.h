@@ -0,0 +1,89 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include "Gorilla.h"
+
+// Append-only columnar file of one device: a sequence of chunks, each a ChunkHeader followed by its time,
+// distance and light columns (Gorilla.h). A chunk covers at most STORE_CHUNK_DURATION seconds, aligned to
+// multiples of it in Unix time, and its header carries the summary a range scan needs to skip or answer it
+// without decoding the columns.
+
+#define STORE_MAGIC 0x4B4E4843 // "CHNK"
+#define STORE_VERSION 1
+#define STORE_CHUNK_DURATION 600	 // [s] Time span of a chunk
+#define STORE_CHUNK_SAMPLES 1048576 // A chunk is sealed early with this many samples
+#define STORE_FILE_EXTENSION ".tsc"
+
+typedef struct
+{
+	uint32_t magic;
+	uint16_t version;
+	uint16_t headerSize; // sizeof(ChunkHeader), the columns start after it
+	uint32_t count;		 // Samples
+	uint32_t timeBytes;	 // Column sizes
+	uint32_t sonicBytes;
+	uint32_t photoBytes;
+	int64_t timeMin; // [us] Unix time of the oldest and the newest sample
+	int64_t timeMax;
+	float sonicMin; // [cm]
+	float sonicMax;
+	float photoMin; // [ADC]
+	float photoMax;
+	double sonicSum;
+	double photoSum;
+} ChunkHeader;
+
+static_assert(sizeof(ChunkHeader) == 72, "ChunkHeader is written as is");
+
+// Encodes the samples of the open chunk as they arrive, write() seals it
+class ChunkBuilder
+{
+public:
+	ChunkBuilder();
+
+	void add(int64_t time, float sonic, float photo);
+	bool write(int fd);
+
+	uint32_t count() const;
+
+private:
+	void reset();
+
+	ChunkHeader m_header;
+	BitWriter m_time;
+	BitWriter m_sonic;
+	BitWriter m_photo;
+	TimestampEncoder m_timeEncoder;
+	FloatEncoder m_sonicEncoder;
+	FloatEncoder m_photoEncoder;
+};
+
+// Read side: maps a store file and lists its chunks, a chunk is only decoded when asked for
+class ChunkFile
+{
+public:
+	ChunkFile();
+	~ChunkFile();
+	ChunkFile(const ChunkFile&) = delete;
+	ChunkFile& operator=(const ChunkFile&) = delete;
+
+	bool open(const std::string& path);
+	void close();
+
+	size_t size() const;
+	const ChunkHeader& header(size_t index) const;
+	size_t decode(size_t index, int64_t* times, float* sonic, float* photo) const;
+
+private:
+	struct Chunk
+	{
+		ChunkHeader header;		// Copy, the header in the mapping may be misaligned
+		const uint8_t* columns; // Time, distance and light column in the mapping
+	};
+
+	const uint8_t* m_data = nullptr;
+	size_t m_size = 0;
+	std::vector<Chunk> m_chunks;
+};
@@ -0,0 +1,297 @@
+#include "Device.h"
+#include <iostream>
+#include <string.h>
+
+/**
+ * @brief Construct a new device object, the port is opened by open()
+ *
+ * @param portName Device path, e.g. /dev/ttyUSB0
+ * @param baudRate
+ */
+Device::Device(const std::string& portName, unsigned long baudRate) : m_portName(portName), m_baudRate(baudRate)
+{
+}
+
+/**
+ * @brief Opens the port and starts decoding from scratch
+ *
+ * @return true if the port is open
+ */
+bool Device::open()
+{
+	if (this->m_port.begin(this->m_portName, this->m_baudRate) != 1)
+		return false;
+
+	this->m_parser.reset();
+	this->m_streamDecoder.reset();
+	std::cout << "[ Ingest OK ]: " << this->m_portName << " open at " << this->m_baudRate << " baud" << std::endl;
+	return true;
+}
+
+/**
+ * @brief Closes the port, the decoder state is rebuilt when it opens again and the line error counts carry on
+ */
+void Device::close()
+{
+	this->m_lineErrorBase = this->lineErrors();
+	this->m_port.close();
+}
+
+/**
+ * @brief Reads and decodes everything the driver has received.
+ *
+ * @param now [s] Host time
+ *
+ * @return false if the port went away, close() it and try to open() it later
+ */
+bool Device::onReadable(double now)
+{
+	uint8_t readBuffer[DEVICE_READ_CHUNK];
+	while (true)
+	{
+		int readResult = this->m_port.read(readBuffer, sizeof(readBuffer));
+		if (readResult < 0)
+		{
+			this->m_counters.readErrors++;
+			std::cerr << "[ Ingest ERR ]: " << this->m_portName << " lost" << std::endl;
+			return false;
+		}
+		if (readResult == 0)
+			return true;
+
+		this->m_counters.bytes += readResult;
+		for (int i = 0; i < readResult; i++)
+		{
+			FrameType frameType = this->m_parser.push(readBuffer[i]);
+			if (frameType != FrameType::Pending)
+				this->handleFrame(frameType, now);
+		}
+
+		// A short read means the driver buffer is empty, save the extra system call
+		if (readResult < static_cast<int>(sizeof(readBuffer)))
+			return true;
+	}
+}
+
+/**
+ * @brief Periodic work: the byte rate and the time exchange for the clock mapping. Call it from the event loop.
+ *
+ * @param now [s] Host time
+ */
+void Device::service(double now)
+{
+	if (now - this->m_rateTime >= DEVICE_RATE_INTERVAL)
+	{
+		this->m_byteRate = (this->m_counters.bytes - this->m_rateBytes) / (now - this->m_rateTime);
+		this->m_rateTime = now;
+		this->m_rateBytes = this->m_counters.bytes;
+	}
+
+	if (this->m_port.isConnected() && this->m_session.clock().isSynced() && now - this->m_session.timeRequested() >= DEVICE_CLOCK_SYNC_INTERVAL)
+		this->m_session.requestTime(now);
+}
+
+/**
+ * @brief Sets the receiver of every new value, e.g. the publisher
+ */
+void Device::setSampleSink(SampleSink sink)
+{
+	this->m_session.setSampleSink(sink);
+}
+
+/**
+ * @brief Port path, used as the device name
+ */
+const std::string& Device::name() const
+{
+	return this->m_portName;
+}
+
+/**
+ * @brief Descriptor of the port, -1 while it is closed
+ */
+int Device::fd() const
+{
+	return this->m_port.fd();
+}
+
+/**
+ * @brief true while the port is open
+ */
+bool Device::isOpen() const
+{
+	return this->m_port.isConnected();
+}
+
+/**
+ * @brief Recent values of the device on the host time base
+ */
+const History& Device::history() const
+{
+	return this->m_history;
+}
+
+/**
+ * @brief Host side counters of the device
+ */
+const DeviceCounters& Device::counters() const
+{
+	return this->m_counters;
+}
+
+/**
+ * @brief Frame, check sum and resync counters of the parser
+ */
+const ParserStats& Device::parserStats() const
+{
+	return this->m_parser.stats();
+}
+
+/**
+ * @brief Loss accounting of the sample sequence numbers
+ */
+const SequenceTracker& Device::sequence() const
+{
+	return this->m_session.sequence();
+}
+
+/**
+ * @brief Device to host clock mapping
+ */
+const DeviceClock& Device::clock() const
+{
+	return this->m_session.clock();
+}
+
+/**
+ * @brief Compressed stream blocks dropped because of a gap
+ */
+uint64_t Device::droppedBlocks() const
+{
+	return this->m_streamDecoder.droppedBlocks();
+}
+
+/**
+ * @brief Bytes per second read from the port, averaged over DEVICE_RATE_INTERVAL
+ */
+double Device::byteRate() const
+{
+	return this->m_byteRate;
+}
+
+/**
+ * @brief Bytes waiting in the driver, the input queue of the device
+ */
+size_t Device::inputQueue() const
+{
+	return this->m_port.available();
+}
+
+/**
+ * @brief Line errors reported by the driver since the daemon started, they never go backward across reopens
+ */
+const SerialErrors& Device::lineErrors()
+{
+	this->m_lineErrors = this->m_lineErrorBase;
+	if (this->m_port.isConnected())
+	{
+		const SerialErrors& errors = this->m_port.getErrors();
+		this->m_lineErrors.frame += errors.frame;
+		this->m_lineErrors.overrun += errors.overrun;
+		this->m_lineErrors.parity += errors.parity;
+		this->m_lineErrors.rxOverflow += errors.rxOverflow;
+	}
+	return this->m_lineErrors;
+}
+
+//==================================================================================================
+/**
+ * @brief Dispatches a complete frame held by the parser
+ */
+void Device::handleFrame(FrameType frameType, double now)
+{
+	if (frameType == FrameType::Message)
+	{
+		this->m_counters.messages++;
+		this->handleMessage(now);
+		return;
+	}
+
+	this->m_counters.packets++;
+	switch (this->m_parser.packetType())
+	{
+	case PACKET_SAMPLE:
+	{
+		Sample sample;
+		if (DeviceSession::parseSample(this->m_parser.payload(), this->m_parser.payloadSize(), &sample))
+			this->addSample(sample, now);
+		break;
+	}
+	case PACKET_STREAM_KEY:
+	case PACKET_STREAM_DELTA:
+		this->handleStream(now);
+		break;
+	case PACKET_BACKLOG:
+		this->m_counters.recovered += this->m_session.handleBacklog(this->m_parser.payload(), this->m_parser.payloadSize(), now);
+		break;
+	case PACKET_TIME:
+		this->m_session.handleTime(this->m_parser.payload(), this->m_parser.payloadSize(), now);
+		break;
+	default:
+		break;
+	}
+}
+
+/**
+ * @brief Appends the value of a Message frame at its arrival time, it has no sequence number or timestamp.
+ */
+void Device::handleMessage(double now)
+{
+	Message message;
+	memcpy(&message, this->m_parser.frame(), sizeof(Message));
+
+	float sonic;
+	int32_t photo;
+	memcpy(&sonic, message.sonicData, 4);
+	memcpy(&photo, message.photoData, 4);
+	this->m_session.addMessage(now, sonic, static_cast<float>(photo));
+	this->m_counters.samples++;
+	this->m_counters.lastSample = now;
+}
+
+/**
+ * @brief Decompresses a stream block and appends its samples.
+ */
+void Device::handleStream(double now)
+{
+	Sample samples[DEVICE_MAX_BLOCK_SAMPLES];
+	int count = this->m_streamDecoder.decode(this->m_parser.packetType(), this->m_parser.payload(),
+											 this->m_parser.payloadSize(), samples, DEVICE_MAX_BLOCK_SAMPLES);
+	for (int i = 0; i < count; i++)
+		this->addSample(samples[i], now);
+}
+
+/**
+ * @brief Puts a live sample into the session (history, loss accounting, backlog requests), the same rules as
+ * the viewer.
+ */
+void Device::addSample(const Sample& sample, double arrival)
+{
+	if (this->m_session.addSample(sample, arrival))
+		std::cout << "[ Ingest INFO ]: " << this->m_portName << " sequence restarted, device reset" << std::endl;
+	this->m_counters.samples++;
+	this->m_counters.lastSample = arrival;
+}
+
+/**
+ * @brief Frames and sends one command packet to the device
+ */
+bool Device::sendPacket(uint8_t type, const uint8_t* payload, uint8_t payloadSize)
+{
+	if (payloadSize > PACKET_RX_MAX_PAYLOAD)
+		return false;
+
+	uint8_t packet[PACKET_MAX_SIZE];
+	size_t size = FrameParser::encode(type, payload, payloadSize, packet);
+	return this->m_port.write(packet, size);
+}
\ No newline at end of file
@@ -0,0 +1,78 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <functional>
+#include <string>
+#include "PosixSerial.h"
+#include "FrameParser.h"
+#include "StreamDecoder.h"
+#include "History.h"
+#include "DeviceSession.h"
+
+#define DEVICE_READ_CHUNK 256		 // Bytes read from the port at once
+#define DEVICE_HISTORY_CAPACITY 256	 // Points kept per device, the daemon only needs the recent values
+#define DEVICE_MAX_BLOCK_SAMPLES 64
+#define DEVICE_CLOCK_SYNC_INTERVAL 5.0 // [s] Time exchange period
+#define DEVICE_RATE_INTERVAL 1.0	   // [s] Averaging period of the byte rate
+
+typedef struct
+{
+	uint64_t bytes;		   // Bytes read from the port
+	uint64_t messages;	   // Message frames
+	uint64_t packets;	   // Packets
+	uint64_t samples;	   // Live samples added to the history
+	uint64_t recovered;	   // Samples recovered from the device backlog
+	uint64_t readErrors;   // Times the port went away
+	double lastSample;	   // [s] Host time of the newest sample, 0 if none yet
+} DeviceCounters;
+
+// One serial device of the ingest daemon: its port, decoder state, history and counters.
+// Everything runs on the thread of the event loop, a device costs one descriptor and a few KB.
+class Device
+{
+public:
+	Device(const std::string& portName, unsigned long baudRate);
+
+	bool open();
+	void close();
+	bool onReadable(double now);
+	void service(double now);
+	void setSampleSink(SampleSink sink);
+
+	const std::string& name() const;
+	int fd() const;
+	bool isOpen() const;
+
+	const History& history() const;
+	const DeviceCounters& counters() const;
+	const ParserStats& parserStats() const;
+	const SequenceTracker& sequence() const;
+	const DeviceClock& clock() const;
+	uint64_t droppedBlocks() const;
+	double byteRate() const;
+	size_t inputQueue() const;
+	const SerialErrors& lineErrors();
+
+private:
+	void handleFrame(FrameType frameType, double now);
+	void handleMessage(double now);
+	void handleStream(double now);
+	void addSample(const Sample& sample, double arrival);
+	bool sendPacket(uint8_t type, const uint8_t* payload = nullptr, uint8_t payloadSize = 0);
+
+	std::string m_portName;
+	unsigned long m_baudRate;
+	PosixSerial m_port;
+	FrameParser m_parser;
+	StreamDecoder m_streamDecoder;
+	History m_history{DEVICE_HISTORY_CAPACITY};
+	DeviceSession m_session{this->m_history, [this](uint8_t type, const uint8_t* payload, uint8_t payloadSize)
+							{ return this->sendPacket(type, payload, payloadSize); }};
+	DeviceCounters m_counters = {};
+	SerialErrors m_lineErrorBase = {}; // Line errors of the earlier port sessions, the driver starts over on open
+	SerialErrors m_lineErrors = {};
+
+	double m_rateTime = 0.0; // [s] Start of the current rate period
+	uint64_t m_rateBytes = 0; // Bytes at the start of the period
+	double m_byteRate = 0.0; // [1/s] Over the last whole period
+};
@@ -0,0 +1,301 @@
+#include "Gorilla.h"
+#include <string.h>
+
+/**
+ * @brief Appends the low bits of a value
+ *
+ * @param value
+ * @param bits 1 - 64
+ */
+void BitWriter::write(uint64_t value, int bits)
+{
+	if (bits > 32)
+	{
+		this->write(value >> 32, bits - 32);
+		bits = 32;
+	}
+
+	this->m_buffer = (this->m_buffer << bits) | (value & ((uint64_t(1) << bits) - 1));
+	this->m_bits += bits;
+	while (this->m_bits >= 8)
+	{
+		this->m_bits -= 8;
+		this->m_bytes.push_back(static_cast<uint8_t>(this->m_buffer >> this->m_bits));
+	}
+}
+
+/**
+ * @brief Pads the last byte with zeros
+ */
+void BitWriter::finish()
+{
+	if (this->m_bits > 0)
+		this->write(0, 8 - this->m_bits);
+}
+
+/**
+ * @brief The finished bytes
+ */
+const std::vector<uint8_t>& BitWriter::bytes() const
+{
+	return this->m_bytes;
+}
+
+/**
+ * @brief Starts over, the memory is kept
+ */
+void BitWriter::clear()
+{
+	this->m_bytes.clear();
+	this->m_buffer = 0;
+	this->m_bits = 0;
+}
+
+//==================================================================================================
+/**
+ * @brief Construct a new bit reader object
+ */
+BitReader::BitReader(const uint8_t* data, size_t size) : m_data(data), m_end(data + size)
+{
+	this->fill();
+}
+
+/**
+ * @brief Reads bits as the low bits of the result
+ *
+ * @param bits 1 - 64
+ */
+uint64_t BitReader::read(int bits)
+{
+	if (bits > 32)
+	{
+		uint64_t high = this->read(bits - 32);
+		return (high << 32) | this->read(32);
+	}
+
+	if (this->m_bits < bits)
+		this->fill();
+	uint64_t value = this->m_buffer >> (64 - bits);
+	this->m_buffer <<= bits;
+	this->m_bits -= bits;
+	return value;
+}
+
+/**
+ * @brief Reads one bit
+ */
+bool BitReader::readBit()
+{
+	if (this->m_bits == 0)
+		this->fill();
+	bool bit = (this->m_buffer >> 63) != 0;
+	this->m_buffer <<= 1;
+	this->m_bits--;
+	return bit;
+}
+
+/**
+ * @brief Tops the buffer up to at least 57 bits
+ */
+void BitReader::fill()
+{
+	if (this->m_end - this->m_data >= 8)
+	{
+		// Whole bytes that fit, in one load
+		uint64_t word;
+		memcpy(&word, this->m_data, 8);
+		word = __builtin_bswap64(word);
+		int bytes = (64 - this->m_bits) / 8;
+		this->m_buffer |= (word >> this->m_bits) & ~(bytes == 8 ? 0 : (~uint64_t(0) >> (bytes * 8)) >> this->m_bits);
+		this->m_data += bytes;
+		this->m_bits += bytes * 8;
+		return;
+	}
+
+	while (this->m_bits <= 56)
+	{
+		uint64_t byte = this->m_data < this->m_end ? *this->m_data++ : 0;
+		this->m_buffer |= byte << (56 - this->m_bits);
+		this->m_bits += 8;
+	}
+}
+
+//==================================================================================================
+/**
+ * @brief Encodes the next timestamp
+ *
+ * @details The first one is written whole, the rest as the change of the delta:
+ *  0 - same delta, 10 + 7 bits, 110 + 9 bits, 1110 + 12 bits, 11110 + 32 bits, 11111 + 64 bits
+ *
+ * @param time [us]
+ * @param writer Column
+ */
+void TimestampEncoder::add(int64_t time, BitWriter* writer)
+{
+	if (this->m_count++ == 0)
+	{
+		writer->write(static_cast<uint64_t>(time), 64);
+		this->m_time = time;
+		return;
+	}
+
+	// Wraps instead of overflowing on extreme jumps, the decoder wraps back the same way
+	int64_t delta = static_cast<int64_t>(static_cast<uint64_t>(time) - static_cast<uint64_t>(this->m_time));
+	int64_t deltaOfDelta = static_cast<int64_t>(static_cast<uint64_t>(delta) - static_cast<uint64_t>(this->m_delta));
+	this->m_time = time;
+	this->m_delta = delta;
+
+	if (deltaOfDelta == 0)
+		writer->write(0, 1);
+	else if (deltaOfDelta >= -64 && deltaOfDelta <= 63)
+		writer->write((uint64_t(0x2) << 7) | (static_cast<uint64_t>(deltaOfDelta) & 0x7F), 9);
+	else if (deltaOfDelta >= -256 && deltaOfDelta <= 255)
+		writer->write((uint64_t(0x6) << 9) | (static_cast<uint64_t>(deltaOfDelta) & 0x1FF), 12);
+	else if (deltaOfDelta >= -2048 && deltaOfDelta <= 2047)
+		writer->write((uint64_t(0xE) << 12) | (static_cast<uint64_t>(deltaOfDelta) & 0xFFF), 16);
+	else if (deltaOfDelta >= INT32_MIN && deltaOfDelta <= INT32_MAX)
+	{
+		writer->write(0x1E, 5);
+		writer->write(static_cast<uint64_t>(deltaOfDelta), 32);
+	}
+	else
+	{
+		writer->write(0x1F, 5);
+		writer->write(static_cast<uint64_t>(deltaOfDelta), 64);
+	}
+}
+
+/**
+ * @brief Starts a new column
+ */
+void TimestampEncoder::reset()
+{
+	this->m_count = 0;
+	this->m_time = 0;
+	this->m_delta = 0;
+}
+
+/**
+ * @brief Sign extends the low bits of a value
+ */
+static inline int64_t signExtend(uint64_t value, int bits)
+{
+	return static_cast<int64_t>(value << (64 - bits)) >> (64 - bits);
+}
+
+/**
+ * @brief Decodes the next timestamp [us]
+ */
+int64_t TimestampDecoder::next(BitReader* reader)
+{
+	if (this->m_count++ == 0)
+	{
+		this->m_time = static_cast<int64_t>(reader->read(64));
+		return this->m_time;
+	}
+
+	int64_t deltaOfDelta = 0;
+	if (reader->readBit())
+	{
+		if (!reader->readBit())
+			deltaOfDelta = signExtend(reader->read(7), 7);
+		else if (!reader->readBit())
+			deltaOfDelta = signExtend(reader->read(9), 9);
+		else if (!reader->readBit())
+			deltaOfDelta = signExtend(reader->read(12), 12);
+		else if (!reader->readBit())
+			deltaOfDelta = signExtend(reader->read(32), 32);
+		else
+			deltaOfDelta = static_cast<int64_t>(reader->read(64));
+	}
+
+	this->m_delta = static_cast<int64_t>(static_cast<uint64_t>(this->m_delta) + static_cast<uint64_t>(deltaOfDelta));
+	this->m_time = static_cast<int64_t>(static_cast<uint64_t>(this->m_time) + static_cast<uint64_t>(this->m_delta));
+	return this->m_time;
+}
+
+//==================================================================================================
+/**
+ * @brief Encodes the next value
+ *
+ * @details The first one is written whole, the rest as the XOR with the previous value:
+ *  0 - same value, 10 + meaningful bits in the previous window, 11 + 5 bits leading zeros + 5 bits length - 1
+ *  + meaningful bits
+ *
+ * @param value
+ * @param writer Column
+ */
+void FloatEncoder::add(float value, BitWriter* writer)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, 4);
+	if (this->m_count++ == 0)
+	{
+		writer->write(bits, 32);
+		this->m_value = bits;
+		this->m_leading = 32; // No window yet
+		return;
+	}
+
+	uint32_t difference = bits ^ this->m_value;
+	this->m_value = bits;
+	if (difference == 0)
+	{
+		writer->write(0, 1);
+		return;
+	}
+
+	int leading = __builtin_clz(difference);
+	int trailing = __builtin_ctz(difference);
+	if (this->m_leading <= leading && this->m_trailing <= trailing && this->m_leading < 32)
+	{
+		writer->write(0x2, 2);
+		writer->write(difference >> this->m_trailing, 32 - this->m_leading - this->m_trailing);
+		return;
+	}
+
+	int length = 32 - leading - trailing;
+	writer->write(0x3, 2);
+	writer->write(static_cast<uint64_t>(leading), 5);
+	writer->write(static_cast<uint64_t>(length - 1), 5);
+	writer->write(difference >> trailing, length);
+	this->m_leading = leading;
+	this->m_trailing = trailing;
+}
+
+/**
+ * @brief Starts a new column
+ */
+void FloatEncoder::reset()
+{
+	this->m_count = 0;
+	this->m_value = 0;
+	this->m_leading = 0;
+	this->m_trailing = 0;
+}
+
+/**
+ * @brief Decodes the next value
+ */
+float FloatDecoder::next(BitReader* reader)
+{
+	if (this->m_count++ == 0)
+	{
+		this->m_value = static_cast<uint32_t>(reader->read(32));
+	}
+	else if (reader->readBit())
+	{
+		if (reader->readBit())
+		{
+			this->m_leading = static_cast<int>(reader->read(5));
+			int length = static_cast<int>(reader->read(5)) + 1;
+			this->m_trailing = 32 - this->m_leading - length;
+		}
+		int length = 32 - this->m_leading - this->m_trailing;
+		this->m_value ^= static_cast<uint32_t>(reader->read(length)) << this->m_trailing;
+	}
+
+	float value;
+	memcpy(&value, &this->m_value, 4);
+	return value;
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+// Column codecs of the time series store, after Facebook's Gorilla: timestamps as delta of deltas, floats as
+// the XOR with the previous value. A regular timestamp costs 1 bit, an unchanged value 1 bit, a slowly changing
+// one the few bits that differ.
+
+// Appends bits MSB first
+class BitWriter
+{
+public:
+	void write(uint64_t value, int bits);
+	void finish();
+
+	const std::vector<uint8_t>& bytes() const;
+	void clear();
+
+private:
+	std::vector<uint8_t> m_bytes;
+	uint64_t m_buffer = 0; // Pending bits, right aligned
+	int m_bits = 0;
+};
+
+// Reads the bits of a BitWriter, past the end it reads zeros
+class BitReader
+{
+public:
+	BitReader(const uint8_t* data, size_t size);
+
+	uint64_t read(int bits);
+	bool readBit();
+
+private:
+	void fill();
+
+	const uint8_t* m_data;
+	const uint8_t* m_end;
+	uint64_t m_buffer = 0; // Left aligned
+	int m_bits = 0;
+};
+
+// Timestamps [us], delta of delta with the Gorilla bucket sizes
+class TimestampEncoder
+{
+public:
+	void add(int64_t time, BitWriter* writer);
+	void reset();
+
+private:
+	uint64_t m_count = 0;
+	int64_t m_time = 0;
+	int64_t m_delta = 0;
+};
+
+class TimestampDecoder
+{
+public:
+	int64_t next(BitReader* reader);
+
+private:
+	uint64_t m_count = 0;
+	int64_t m_time = 0;
+	int64_t m_delta = 0;
+};
+
+// 32 bit floats, XOR with the previous value, the meaningful bits window is reused while it fits
+class FloatEncoder
+{
+public:
+	void add(float value, BitWriter* writer);
+	void reset();
+
+private:
+	uint64_t m_count = 0;
+	uint32_t m_value = 0;
+	int m_leading = 0;
+	int m_trailing = 0;
+};
+
+class FloatDecoder
+{
+public:
+	float next(BitReader* reader);
+
+private:
+	uint64_t m_count = 0;
+	uint32_t m_value = 0;
+	int m_leading = 0;
+	int m_trailing = 0;
+};
@@ -0,0 +1,422 @@
+#include "Ingest.h"
+#include <iostream>
+#include <ctype.h>
+#include <cmath>
+#include <functional>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+/**
+ * @brief Name of a port usable in file and shared memory names: the last path element, anything unusual
+ * replaced by '_'
+ */
+static std::string portId(const std::string& portName)
+{
+	std::string name = portName.substr(portName.rfind('/') + 1);
+	for (char& c : name)
+	{
+		if (!isalnum(static_cast<unsigned char>(c)) && c != '-' && c != '_' && c != '.')
+			c = '_';
+	}
+	return name;
+}
+
+/**
+ * @brief Construct a new ingest object
+ *
+ * @param baudRate Every port runs at this rate
+ */
+Ingest::Ingest(unsigned long baudRate) : m_baudRate(baudRate)
+{
+	this->m_epoll = epoll_create1(EPOLL_CLOEXEC);
+	if (this->m_epoll < 0)
+		std::cerr << "[ Ingest ERR ]: epoll_create1: " << strerror(errno) << std::endl;
+}
+
+/**
+ * @brief Closes every port and the epoll instance
+ */
+Ingest::~Ingest()
+{
+	this->m_devices.clear();
+	if (this->m_epoll >= 0)
+		close(this->m_epoll);
+}
+
+/**
+ * @brief Adds a device, its port is opened by run() (and reopened if it goes away)
+ *
+ * @param portName Device path, e.g. /dev/ttyUSB0
+ */
+void Ingest::add(const std::string& portName)
+{
+	size_t index = this->m_devices.size();
+	this->m_devices.emplace_back(new Device(portName, this->m_baudRate));
+	this->m_devices[index]->setSampleSink([this, index](uint16_t sequence, double time, float sonic, float photo)
+										  { this->onSample(index, sequence, time, sonic, photo); });
+	this->m_reportedSamples.push_back(0);
+	this->m_publisher.addDevice(portName);
+}
+
+/**
+ * @brief Runs the event loop until stop() is called.
+ *
+ * @details Each ready port is drained and decoded in place. Once per INGEST_TICK at the latest the devices get
+ * their periodic work, missing ports are retried every INGEST_REOPEN_INTERVAL and the stats are printed.
+ *
+ * @return 0 - Stopped, 1 - epoll is not available
+ */
+int Ingest::run()
+{
+	if (this->m_epoll < 0)
+		return 1;
+
+	this->m_running = true;
+	for (size_t i = 0; i < this->m_devices.size(); i++)
+		this->open(i);
+	this->m_lastReopen = this->now();
+	this->m_lastStats = this->now();
+
+	epoll_event events[INGEST_MAX_EVENTS];
+	while (this->m_running)
+	{
+		int count = epoll_wait(this->m_epoll, events, INGEST_MAX_EVENTS, INGEST_TICK);
+		if (count < 0 && errno != EINTR)
+		{
+			std::cerr << "[ Ingest ERR ]: epoll_wait: " << strerror(errno) << std::endl;
+			return 1;
+		}
+
+		this->m_wakeups++;
+		double now = this->now();
+		for (int i = 0; i < count; i++)
+		{
+			uint32_t source = static_cast<uint32_t>(events[i].data.u64 >> 32);
+			uint32_t index = static_cast<uint32_t>(events[i].data.u64);
+			if (source == SOURCE_METRICS)
+			{
+				this->m_metrics.onEvent(index, events[i].events, now);
+				continue;
+			}
+			if (source == SOURCE_PUBLISHER)
+			{
+				this->m_publisher.onEvent(index, events[i].events);
+				continue;
+			}
+
+			Device& device = *this->m_devices[index];
+			if (!device.isOpen())
+				continue;
+
+			// Read what is left even on a hang up, then let the port go
+			bool alive = device.onReadable(now);
+			if (!alive || (events[i].events & (EPOLLHUP | EPOLLERR)))
+				this->drop(index);
+		}
+
+		// One write per subscriber for everything decoded in this iteration
+		this->m_publisher.flush();
+
+		for (std::unique_ptr<Device>& device : this->m_devices)
+			device->service(now);
+		this->m_metrics.service(now);
+		if (this->m_recording)
+			this->m_recorder.service(this->wallClock(now));
+
+		if (now - this->m_lastReopen >= INGEST_REOPEN_INTERVAL)
+		{
+			this->m_lastReopen = now;
+			for (size_t i = 0; i < this->m_devices.size(); i++)
+			{
+				if (!this->m_devices[i]->isOpen())
+					this->open(i);
+			}
+		}
+
+		if (this->m_statsInterval > 0.0 && now - this->m_lastStats >= this->m_statsInterval)
+			this->printStats(now);
+	}
+	return 0;
+}
+
+/**
+ * @brief Ends run(), safe to call from a signal handler
+ */
+void Ingest::stop()
+{
+	this->m_running = false;
+}
+
+/**
+ * @brief Sets the stats period
+ *
+ * @param interval [s] 0 turns the stats off
+ */
+void Ingest::setStatsInterval(double interval)
+{
+	this->m_statsInterval = interval;
+}
+
+/**
+ * @brief Serves the counters of every device to Prometheus
+ *
+ * @param address "host:port" (TCP, 127.0.0.1 by default) or a Unix socket path
+ *
+ * @return false if the address can not be bound
+ */
+bool Ingest::serveMetrics(const std::string& address)
+{
+	if (!this->m_metrics.begin(address, this->m_epoll, static_cast<uint64_t>(SOURCE_METRICS) << 32))
+		return false;
+
+	std::cout << "[ Ingest INFO ]: metrics served at " << address << std::endl;
+	return true;
+}
+
+/**
+ * @brief Publishes the samples of every device to local subscribers (see PublishProtocol.h)
+ *
+ * @param address "host:port" (TCP, 127.0.0.1 by default) or a Unix socket path
+ *
+ * @return false if the address can not be bound
+ */
+bool Ingest::publish(const std::string& address)
+{
+	if (!this->m_publisher.begin(address, this->m_epoll, static_cast<uint64_t>(SOURCE_PUBLISHER) << 32))
+		return false;
+
+	std::cout << "[ Ingest INFO ]: samples published at " << address << std::endl;
+	return true;
+}
+
+/**
+ * @brief Keeps the newest samples of every device in a shared memory ring (see SampleRing.h)
+ *
+ * @details The ring of /dev/ttyUSB0 with the prefix "/ingest" is "/ingest-ttyUSB0". Call it after the devices
+ * are added.
+ *
+ * @param prefix Shared memory name prefix, starts with a '/'
+ *
+ * @return false if a ring can not be created
+ */
+bool Ingest::share(const std::string& prefix)
+{
+	for (std::unique_ptr<Device>& device : this->m_devices)
+	{
+		this->m_rings.emplace_back(new SharedRing);
+		if (!this->m_rings.back()->create(prefix + "-" + portId(device->name()), device->name()))
+			return false;
+		std::cout << "[ Ingest INFO ]: " << device->name() << " shared at " << this->m_rings.back()->name() << std::endl;
+	}
+	return true;
+}
+
+/**
+ * @brief Records the samples of every device into the store (ChunkFile.h), one file per device
+ *
+ * @details /dev/ttyUSB0 is recorded to directory/ttyUSB0.tsc, new chunks are appended to an existing file.
+ * Call it after the devices are added.
+ *
+ * @param directory Existing directory
+ *
+ * @return false if a file can not be opened
+ */
+bool Ingest::record(const std::string& directory)
+{
+	for (std::unique_ptr<Device>& device : this->m_devices)
+	{
+		std::string path = directory + "/" + portId(device->name()) + STORE_FILE_EXTENSION;
+		if (!this->m_recorder.add(path))
+			return false;
+		std::cout << "[ Ingest INFO ]: " << device->name() << " recorded to " << path << std::endl;
+	}
+	this->m_recording = true;
+	return true;
+}
+
+/**
+ * @brief Appends the counters and gauges of every device in the Prometheus text format.
+ *
+ * @details Called by the metrics server on a scrape. The devices only bump plain counters owned by the event
+ * loop thread, they are read and formatted here.
+ */
+void Ingest::writeMetrics(std::string* text)
+{
+	double now = this->now();
+	char line[512];
+	auto metric = [&](const char* name, const char* type, const char* help, std::function<double(Device&)> value)
+	{
+		snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+		*text += line;
+		for (std::unique_ptr<Device>& device : this->m_devices)
+		{
+			double result = value(*device);
+			if (std::isnan(result))
+				continue; // The device has no value yet
+			snprintf(line, sizeof(line), "%s{device=\"%s\"} %.15g\n", name, device->name().c_str(), result);
+			*text += line;
+		}
+	};
+
+	metric("ingest_port_up", "gauge", "1 while the port is open.", [](Device& device) { return device.isOpen() ? 1.0 : 0.0; });
+	metric("ingest_bytes_total", "counter", "Bytes read from the port.", [](Device& device) { return double(device.counters().bytes); });
+	metric("ingest_bytes_per_second", "gauge", "Bytes read per second over the last second.", [](Device& device) { return device.byteRate(); });
+	metric("ingest_input_queue_bytes", "gauge", "Bytes received by the driver and not read yet.", [](Device& device) { return double(device.inputQueue()); });
+	metric("ingest_messages_total", "counter", "Message frames received.", [](Device& device) { return double(device.counters().messages); });
+	metric("ingest_packets_total", "counter", "Packets received.", [](Device& device) { return double(device.counters().packets); });
+	metric("ingest_checksum_errors_total", "counter", "Frames dropped for a bad check sum.", [](Device& device) { return double(device.parserStats().checksumErrors); });
+	metric("ingest_resyncs_total", "counter", "Times the parser searched for the next start byte.", [](Device& device) { return double(device.parserStats().resyncs); });
+	metric("ingest_line_errors_total", "counter", "Framing, overrun, parity and driver overflow errors.", [](Device& device)
+		   {
+			   const SerialErrors& errors = device.lineErrors();
+			   return double(errors.frame + errors.overrun + errors.parity + errors.rxOverflow);
+		   });
+	metric("ingest_port_lost_total", "counter", "Times the port went away.", [](Device& device) { return double(device.counters().readErrors); });
+	metric("ingest_samples_total", "counter", "Live samples received.", [](Device& device) { return double(device.counters().samples); });
+	metric("ingest_lost_samples_total", "counter", "Samples missing from the sequence.", [](Device& device) { return double(device.sequence().lost()); });
+	metric("ingest_recovered_samples_total", "counter", "Missing samples replayed from the device backlog.", [](Device& device) { return double(device.counters().recovered); });
+	metric("ingest_dropped_blocks_total", "counter", "Compressed stream blocks dropped after a gap.", [](Device& device) { return double(device.droppedBlocks()); });
+	metric("ingest_last_sample_age_seconds", "gauge", "Seconds since the newest sample arrived.", [now](Device& device)
+		   { return device.counters().lastSample > 0.0 ? now - device.counters().lastSample : NAN; });
+	metric("ingest_clock_skew_ppm", "gauge", "Device clock rate error.", [](Device& device) { return device.clock().isSynced() ? device.clock().skew() : NAN; });
+
+	if (this->m_recording)
+	{
+		snprintf(line, sizeof(line),
+				 "# HELP ingest_store_chunks_total Chunks appended to the store.\n# TYPE ingest_store_chunks_total counter\ningest_store_chunks_total %llu\n"
+				 "# HELP ingest_store_bytes_total Bytes appended to the store.\n# TYPE ingest_store_bytes_total counter\ningest_store_bytes_total %llu\n",
+				 static_cast<unsigned long long>(this->m_recorder.chunks()), static_cast<unsigned long long>(this->m_recorder.bytes()));
+		*text += line;
+	}
+
+	if (this->m_publisher.isOpen())
+	{
+		snprintf(line, sizeof(line),
+				 "# HELP ingest_subscribers Connected subscribers.\n# TYPE ingest_subscribers gauge\ningest_subscribers %zu\n"
+				 "# HELP ingest_publish_queue_samples Samples queued for the slowest subscriber.\n# TYPE ingest_publish_queue_samples gauge\ningest_publish_queue_samples %zu\n",
+				 this->m_publisher.subscribers(), this->m_publisher.queued());
+		*text += line;
+		snprintf(line, sizeof(line),
+				 "# HELP ingest_publish_dropped_total Samples dropped for slow subscribers.\n# TYPE ingest_publish_dropped_total counter\ningest_publish_dropped_total %llu\n",
+				 static_cast<unsigned long long>(this->m_publisher.dropped()));
+		*text += line;
+	}
+
+	snprintf(line, sizeof(line),
+			 "# HELP ingest_wakeups_total Event loop iterations.\n# TYPE ingest_wakeups_total counter\ningest_wakeups_total %llu\n"
+			 "# HELP ingest_uptime_seconds Seconds since the daemon started.\n# TYPE ingest_uptime_seconds gauge\ningest_uptime_seconds %.3f\n",
+			 static_cast<unsigned long long>(this->m_wakeups), now);
+	*text += line;
+}
+
+/**
+ * @brief Converts a host time to wall clock time, seconds since the Unix epoch
+ */
+double Ingest::wallClock(double time) const
+{
+	return std::chrono::duration<double>(this->m_startWallClock.time_since_epoch()).count() + time;
+}
+
+/**
+ * @brief Number of devices
+ */
+size_t Ingest::size() const
+{
+	return this->m_devices.size();
+}
+
+/**
+ * @brief Returns a device
+ */
+Device& Ingest::device(size_t index)
+{
+	return *this->m_devices[index];
+}
+
+/**
+ * @brief Seconds since the daemon started, the host time base of every device
+ */
+double Ingest::now() const
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - this->m_startTime).count();
+}
+
+//==================================================================================================
+/**
+ * @brief Opens the port of a device and registers it for input
+ */
+void Ingest::open(size_t index)
+{
+	Device& device = *this->m_devices[index];
+	if (!device.open())
+		return;
+
+	epoll_event event = {};
+	event.events = EPOLLIN | EPOLLRDHUP;
+	event.data.u64 = index;
+	if (epoll_ctl(this->m_epoll, EPOLL_CTL_ADD, device.fd(), &event) != 0)
+	{
+		std::cerr << "[ Ingest ERR ]: " << device.name() << ": epoll_ctl: " << strerror(errno) << std::endl;
+		device.close();
+		return;
+	}
+}
+
+/**
+ * @brief Unregisters and closes the port of a device, it is retried later
+ */
+void Ingest::drop(size_t index)
+{
+	Device& device = *this->m_devices[index];
+	epoll_ctl(this->m_epoll, EPOLL_CTL_DEL, device.fd(), nullptr);
+	device.close();
+}
+
+/**
+ * @brief Hands a new value of a device to the consumers
+ */
+void Ingest::onSample(size_t index, uint16_t sequence, double time, float sonic, float photo)
+{
+	double unixTime = this->wallClock(time);
+	if (index < this->m_rings.size())
+		this->m_rings[index]->push(sequence, unixTime, sonic, photo);
+	if (this->m_recording)
+		this->m_recorder.push(index, static_cast<int64_t>(llround(unixTime * 1e6)), sonic, photo);
+	if (this->m_publisher.isOpen())
+		this->m_publisher.publish({static_cast<uint16_t>(index), sequence, unixTime, sonic, photo});
+}
+
+/**
+ * @brief Prints one line per device: sample rate, last value, losses and errors.
+ */
+void Ingest::printStats(double now)
+{
+	double elapsed = now - this->m_lastStats;
+	this->m_lastStats = now;
+
+	for (size_t i = 0; i < this->m_devices.size(); i++)
+	{
+		Device& device = *this->m_devices[i];
+		const DeviceCounters& counters = device.counters();
+		const ParserStats& parser = device.parserStats();
+		const SerialErrors& errors = device.lineErrors();
+		double rate = (counters.samples - this->m_reportedSamples[i]) / elapsed;
+		this->m_reportedSamples[i] = counters.samples;
+
+		const History& history = device.history();
+		float sonic = history.size() > 0 ? history.at(history.size() - 1).sonic : 0.0f;
+		float photo = history.size() > 0 ? history.at(history.size() - 1).photo : 0.0f;
+
+		printf("[ Ingest INFO ]: %s %s %.1f samples/s, last %.2f cm %.0f, lost %llu +%llu, checksum %llu, resync %llu, "
+			   "line %lu, skew %+.0f ppm\n",
+			   device.name().c_str(), device.isOpen() ? "up" : "DOWN", rate, sonic, photo,
+			   static_cast<unsigned long long>(device.sequence().lost()),
+			   static_cast<unsigned long long>(device.sequence().recovered()),
+			   static_cast<unsigned long long>(parser.checksumErrors), static_cast<unsigned long long>(parser.resyncs),
+			   errors.frame + errors.overrun + errors.parity + errors.rxOverflow, device.clock().skew());
+	}
+	fflush(stdout);
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Device.h"
+#include "MetricsServer.h"
+#include "Publisher.h"
+#include "SharedRing.h"
+#include "Recorder.h"
+
+#define INGEST_MAX_EVENTS 64		 // Ready descriptors handled per epoll_wait
+#define INGEST_TICK 100				 // [ms] Longest wait, the periodic work runs at least this often
+#define INGEST_REOPEN_INTERVAL 2.0	 // [s] Retry period of ports that are missing or were unplugged
+#define INGEST_STATS_INTERVAL 10.0	 // [s] Default stats period
+
+// Owner of a ready descriptor, the high half of its epoll data (the low half is the index within the owner)
+enum IngestSource : uint32_t
+{
+	SOURCE_DEVICE,
+	SOURCE_METRICS,
+	SOURCE_PUBLISHER
+};
+
+// Serves every device from one thread: the ports are multiplexed with epoll, a device never blocks the others.
+class Ingest
+{
+public:
+	Ingest(unsigned long baudRate);
+	~Ingest();
+
+	void add(const std::string& portName);
+	int run();
+	void stop();
+
+	void setStatsInterval(double interval);
+	bool serveMetrics(const std::string& address);
+	bool publish(const std::string& address);
+	bool share(const std::string& prefix);
+	bool record(const std::string& directory);
+	void writeMetrics(std::string* text);
+	size_t size() const;
+	Device& device(size_t index);
+	double now() const;
+	double wallClock(double time) const;
+
+private:
+	void open(size_t index);
+	void drop(size_t index);
+	void printStats(double now);
+	void onSample(size_t index, uint16_t sequence, double time, float sonic, float photo);
+
+	unsigned long m_baudRate;
+	int m_epoll = -1;
+	std::atomic<bool> m_running{false};
+	std::vector<std::unique_ptr<Device>> m_devices;
+	std::vector<uint64_t> m_reportedSamples; // Samples of every device at the last stats print
+	std::chrono::steady_clock::time_point m_startTime = std::chrono::steady_clock::now();
+	std::chrono::system_clock::time_point m_startWallClock = std::chrono::system_clock::now();
+	double m_statsInterval = INGEST_STATS_INTERVAL;
+	double m_lastStats = 0.0;
+	double m_lastReopen = 0.0;
+	uint64_t m_wakeups = 0; // epoll_wait returns
+	Publisher m_publisher;
+	std::vector<std::unique_ptr<SharedRing>> m_rings; // Per device, empty unless shared
+	Recorder m_recorder;
+	bool m_recording = false;
+	MetricsServer m_metrics{[this](std::string* text) { this->writeMetrics(text); }};
+};
@@ -0,0 +1,222 @@
+#include "MetricsServer.h"
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include "Socket.h"
+
+/**
+ * @brief Construct a new metrics server object, it listens after begin()
+ *
+ * @param writer Appends the metrics text, called once per scrape
+ */
+MetricsServer::MetricsServer(Writer writer) : m_writer(writer)
+{
+}
+
+/**
+ * @brief Closes the clients and the listener
+ */
+MetricsServer::~MetricsServer()
+{
+	for (Client& client : this->m_clients)
+		this->close(client);
+	closeListener(this->m_listener, this->m_address);
+}
+
+/**
+ * @brief Starts listening and registers the listener with the event loop
+ *
+ * @param address "host:port" (TCP, 127.0.0.1 by default) or a Unix socket path
+ * @param epoll Event loop
+ * @param tag epoll data of the server, the index of the descriptor is added: 0 - listener, 1.. - clients
+ *
+ * @return false if the address can not be bound
+ */
+bool MetricsServer::begin(const std::string& address, int epoll, uint64_t tag)
+{
+	this->m_listener = listenLocal(address);
+	if (this->m_listener < 0)
+		return false;
+
+	this->m_address = address;
+	this->m_epoll = epoll;
+	this->m_tag = tag;
+
+	epoll_event event = {};
+	event.events = EPOLLIN;
+	event.data.u64 = tag;
+	return epoll_ctl(epoll, EPOLL_CTL_ADD, this->m_listener, &event) == 0;
+}
+
+/**
+ * @brief Handles a ready descriptor of the server
+ *
+ * @param index 0 - listener, 1.. - client
+ * @param events epoll events
+ * @param now [s] Host time
+ */
+void MetricsServer::onEvent(uint32_t index, uint32_t events, double now)
+{
+	if (index == 0)
+		this->accept(now);
+	else if (index <= METRICS_MAX_CLIENTS && this->m_clients[index - 1].fd >= 0)
+		this->onClient(this->m_clients[index - 1], events);
+}
+
+/**
+ * @brief Cuts the scrapes that got stuck
+ *
+ * @param now [s] Host time
+ */
+void MetricsServer::service(double now)
+{
+	for (Client& client : this->m_clients)
+	{
+		if (client.fd >= 0 && now - client.opened > METRICS_CLIENT_TIMEOUT)
+			this->close(client);
+	}
+}
+
+/**
+ * @brief true if the server is listening
+ */
+bool MetricsServer::isOpen() const
+{
+	return this->m_listener >= 0;
+}
+
+/**
+ * @brief Number of answered requests
+ */
+uint64_t MetricsServer::scrapes() const
+{
+	return this->m_scrapes;
+}
+
+//==================================================================================================
+/**
+ * @brief Takes the pending connections while there are free slots
+ */
+void MetricsServer::accept(double now)
+{
+	for (size_t i = 0; i < METRICS_MAX_CLIENTS; i++)
+	{
+		Client& client = this->m_clients[i];
+		if (client.fd >= 0)
+			continue;
+
+		client.fd = acceptClient(this->m_listener);
+		if (client.fd < 0)
+			return;
+
+		client.opened = now;
+		client.request.clear();
+		client.response.clear();
+		client.sent = 0;
+
+		epoll_event event = {};
+		event.events = EPOLLIN | EPOLLRDHUP;
+		event.data.u64 = this->m_tag + i + 1;
+		if (epoll_ctl(this->m_epoll, EPOLL_CTL_ADD, client.fd, &event) != 0)
+			this->close(client);
+	}
+
+	// Every slot is busy: turn the rest away, or the listener stays ready and the loop spins
+	int fd;
+	while ((fd = acceptClient(this->m_listener)) >= 0)
+		::close(fd);
+}
+
+/**
+ * @brief Reads the request head, then writes the answer as far as the socket takes it
+ */
+void MetricsServer::onClient(Client& client, uint32_t events)
+{
+	if (client.response.empty())
+	{
+		char buffer[1024];
+		ssize_t result;
+		while ((result = recv(client.fd, buffer, sizeof(buffer), 0)) > 0)
+			client.request.append(buffer, static_cast<size_t>(result));
+
+		bool closed = result == 0 || (result < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR);
+		if (client.request.find("\r\n\r\n") == std::string::npos)
+		{
+			if (closed || client.request.size() > METRICS_REQUEST_SIZE)
+				this->close(client);
+			return;
+		}
+		this->respond(client);
+	}
+	else if (events & (EPOLLHUP | EPOLLERR))
+	{
+		this->close(client);
+		return;
+	}
+
+	while (client.sent < client.response.size())
+	{
+		ssize_t result = send(client.fd, client.response.data() + client.sent, client.response.size() - client.sent, MSG_NOSIGNAL);
+		if (result < 0)
+		{
+			if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+				this->close(client);
+			return;
+		}
+		client.sent += static_cast<size_t>(result);
+	}
+	this->close(client);
+}
+
+/**
+ * @brief Builds the answer and waits for the socket to take it
+ */
+void MetricsServer::respond(Client& client)
+{
+	const std::string& request = client.request;
+	bool head = request.compare(0, 5, "HEAD ") == 0;
+	bool found = request.compare(0, 13, "GET /metrics ") == 0 || request.compare(0, 6, "GET / ") == 0 ||
+				 request.compare(0, 14, "HEAD /metrics ") == 0;
+
+	std::string body;
+	if (found)
+	{
+		this->m_writer(&body);
+		this->m_scrapes++;
+	}
+	else
+	{
+		body = "Not found, try /metrics\n";
+	}
+
+	char header[192];
+	snprintf(header, sizeof(header),
+			 "HTTP/1.1 %s\r\nContent-Type: text/plain; version=0.0.4; charset=utf-8\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n",
+			 found ? "200 OK" : "404 Not Found", body.size());
+	client.response = header;
+	if (!head)
+		client.response += body;
+
+	epoll_event event = {};
+	event.events = EPOLLOUT;
+	event.data.u64 = this->m_tag + static_cast<uint64_t>(&client - this->m_clients) + 1;
+	epoll_ctl(this->m_epoll, EPOLL_CTL_MOD, client.fd, &event);
+}
+
+/**
+ * @brief Ends a connection and frees its slot
+ */
+void MetricsServer::close(Client& client)
+{
+	if (client.fd < 0)
+		return;
+
+	epoll_ctl(this->m_epoll, EPOLL_CTL_DEL, client.fd, nullptr);
+	::close(client.fd);
+	client.fd = -1;
+	client.request.clear();
+	client.response.clear();
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <functional>
+#include <string>
+
+#define METRICS_MAX_CLIENTS 8	   // Scrapes served at once, more connections wait in the listen queue
+#define METRICS_REQUEST_SIZE 4096  // Longest request head accepted
+#define METRICS_CLIENT_TIMEOUT 5.0 // [s] A scrape that takes longer is cut
+
+// Minimal HTTP/1.1 server for Prometheus scrapes, driven by the epoll loop of the daemon. GET /metrics answers
+// with the text exposition format, every connection serves one request. The text is only written when a scrape
+// arrives, so the counters it shows cost nothing in between.
+class MetricsServer
+{
+public:
+	typedef std::function<void(std::string* text)> Writer;
+
+	MetricsServer(Writer writer);
+	~MetricsServer();
+
+	bool begin(const std::string& address, int epoll, uint64_t tag);
+	void onEvent(uint32_t index, uint32_t events, double now);
+	void service(double now);
+
+	bool isOpen() const;
+	uint64_t scrapes() const;
+
+private:
+	struct Client
+	{
+		int fd = -1;
+		double opened = 0.0; // [s]
+		std::string request;
+		std::string response;
+		size_t sent = 0;
+	};
+
+	void accept(double now);
+	void onClient(Client& client, uint32_t events);
+	void respond(Client& client);
+	void close(Client& client);
+
+	Writer m_writer;
+	std::string m_address;
+	int m_listener = -1;
+	int m_epoll = -1;
+	uint64_t m_tag = 0;
+	uint64_t m_scrapes = 0;
+	Client m_clients[METRICS_MAX_CLIENTS];
+};
@@ -0,0 +1,234 @@
+#include "PosixSerial.h"
+#include <iostream>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#ifdef __linux__
+#include <linux/serial.h>
+#endif
+
+/**
+ * @brief Maps a baud rate to its termios speed constant
+ *
+ * @return B0 if the rate is not supported
+ */
+static speed_t toSpeed(unsigned long baudRate)
+{
+	switch (baudRate)
+	{
+	case 9600:
+		return B9600;
+	case 19200:
+		return B19200;
+	case 38400:
+		return B38400;
+	case 57600:
+		return B57600;
+	case 115200:
+		return B115200;
+#ifdef B230400
+	case 230400:
+		return B230400;
+#endif
+#ifdef B500000
+	case 500000:
+		return B500000;
+#endif
+#ifdef B1000000
+	case 1000000:
+		return B1000000;
+#endif
+	default:
+		return B0;
+	}
+}
+
+/**
+ * @brief Construct a new serial port object
+ *
+ */
+PosixSerial::PosixSerial()
+{
+}
+
+/**
+ * @brief Closes the port if it is still open
+ *
+ */
+PosixSerial::~PosixSerial()
+{
+	this->close();
+}
+
+/**
+ * @brief Opens the port in raw, non-blocking mode: 8 data bits, 1 stop bit, no parity, no flow control.
+ *
+ * @param portName Device path, e.g. /dev/ttyUSB0
+ * @param baudRate
+ *
+ * @return	1 - Connection established
+ * @return -1 - Serial port not available
+ * @return -2 - Could not connect to serial port
+ * @return -3 - Could not get serial port parameters
+ * @return -4 - Could not set serial port parameters
+ */
+int PosixSerial::begin(const std::string& portName, unsigned long baudRate)
+{
+	this->close();
+	this->m_portName = portName;
+	this->m_baudRate = baudRate;
+
+	this->m_fd = ::open(portName.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+	if (this->m_fd < 0)
+	{
+		int error = errno;
+		std::cerr << "[ Serial ERR ]: " << portName << (error == ENOENT ? " not available" : ": could not connect to serial port")
+				  << std::endl;
+		return error == ENOENT ? -1 : -2;
+	}
+
+	termios serialParam;
+	if (tcgetattr(this->m_fd, &serialParam) != 0)
+	{
+		std::cerr << "[ Serial ERR ]: " << portName << ": could not get serial port parameters" << std::endl;
+		this->close();
+		return -3;
+	}
+
+	speed_t speed = toSpeed(baudRate);
+	cfmakeraw(&serialParam);
+	serialParam.c_cflag |= CLOCAL | CREAD;
+	serialParam.c_cflag &= ~(CSTOPB | PARENB | CRTSCTS);
+	serialParam.c_cc[VMIN] = 0;
+	serialParam.c_cc[VTIME] = 0;
+	if (speed == B0 || cfsetispeed(&serialParam, speed) != 0 || cfsetospeed(&serialParam, speed) != 0 ||
+		tcsetattr(this->m_fd, TCSANOW, &serialParam) != 0)
+	{
+		std::cerr << "[ Serial ERR ]: " << portName << ": could not set serial port parameters (" << baudRate << " baud)"
+				  << std::endl;
+		this->close();
+		return -4;
+	}
+
+	tcflush(this->m_fd, TCIOFLUSH);
+	this->m_errorBase = {};
+	this->m_errors = {};
+	this->getErrors();
+	this->m_errorBase = this->m_errors;
+	this->m_errors = {};
+	return 1;
+}
+
+/**
+ * @brief Closes down the serial port
+ */
+void PosixSerial::close()
+{
+	if (this->m_fd >= 0)
+		::close(this->m_fd);
+	this->m_fd = -1;
+}
+
+/**
+ * @brief Reads what the driver already received, never blocks.
+ *
+ * @param buffer The buffer to store the read data.
+ * @param bufferSize The size of the buffer.
+ *
+ * @return The number of bytes read, 0 if nothing is pending
+ * @return -1 - The port is gone (unplugged) or broken
+ */
+int PosixSerial::read(uint8_t* buffer, size_t bufferSize)
+{
+	if (this->m_fd < 0)
+		return -1;
+
+	ssize_t result = ::read(this->m_fd, buffer, bufferSize);
+	if (result > 0)
+		return static_cast<int>(result);
+	if (result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+		return 0;
+	// A tty returns 0 only after a hang up
+	return -1;
+}
+
+/**
+ * @brief Writes a short command to the port
+ *
+ * @param buffer The buffer to write to the serial port
+ * @param bufferSize The size of the buffer
+ *
+ * @return true - Write successful
+ * @return false - Could not write the whole buffer (the driver TX buffer is full or the port is gone)
+ */
+bool PosixSerial::write(const uint8_t* buffer, size_t bufferSize)
+{
+	if (this->m_fd < 0)
+		return false;
+
+	ssize_t result = ::write(this->m_fd, buffer, bufferSize);
+	if (result != static_cast<ssize_t>(bufferSize))
+	{
+		std::cerr << "[ Serial ERR ]: " << this->m_portName << ": could not write to serial port" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+/**
+ * @brief File descriptor to wait on, -1 if the port is closed
+ */
+int PosixSerial::fd() const
+{
+	return this->m_fd;
+}
+
+/**
+ * @brief Bytes received by the driver and not read yet
+ */
+size_t PosixSerial::available() const
+{
+	int count = 0;
+	if (this->m_fd < 0 || ioctl(this->m_fd, FIONREAD, &count) != 0)
+		return 0;
+	return static_cast<size_t>(count);
+}
+
+/**
+ * @brief Returns the baud rate the port is configured to
+ */
+unsigned long PosixSerial::getBaudRate() const
+{
+	return this->m_baudRate;
+}
+
+/**
+ * @brief Returns the line error counters collected since the port was opened
+ *
+ * @note The counters come from the driver (TIOCGICOUNT), drivers without it report zeros.
+ */
+const SerialErrors& PosixSerial::getErrors()
+{
+#if defined(__linux__) && defined(TIOCGICOUNT)
+	serial_icounter_struct counters;
+	if (this->m_fd >= 0 && ioctl(this->m_fd, TIOCGICOUNT, &counters) == 0)
+	{
+		this->m_errors.frame = counters.frame - this->m_errorBase.frame;
+		this->m_errors.overrun = counters.overrun - this->m_errorBase.overrun;
+		this->m_errors.parity = counters.parity - this->m_errorBase.parity;
+		this->m_errors.rxOverflow = counters.buf_overrun - this->m_errorBase.rxOverflow;
+	}
+#endif
+	return this->m_errors;
+}
+
+/**
+ * @brief Checks if the serial port is open
+ */
+bool PosixSerial::isConnected() const
+{
+	return this->m_fd >= 0;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+typedef struct
+{
+	unsigned long frame;	  // Framing errors, usually a baud rate mismatch
+	unsigned long overrun;	  // Character buffer overrun in the UART
+	unsigned long parity;	  // Parity errors
+	unsigned long rxOverflow; // Driver input buffer overflow
+} SerialErrors;
+
+// Non-blocking termios serial port, the POSIX counterpart of SerialHandler.
+// The descriptor is meant to be waited on with epoll, read() never blocks.
+class PosixSerial
+{
+public:
+	PosixSerial();
+	~PosixSerial();
+
+	int begin(const std::string& portName, unsigned long baudRate);
+	void close();
+
+	int read(uint8_t* buffer, size_t bufferSize);
+	bool write(const uint8_t* buffer, size_t bufferSize);
+
+	int fd() const;
+	size_t available() const;
+	unsigned long getBaudRate() const;
+	const SerialErrors& getErrors();
+	bool isConnected() const;
+
+private:
+	std::string m_portName;
+	int m_fd = -1;
+	unsigned long m_baudRate = 0;
+	SerialErrors m_errors = {};
+	SerialErrors m_errorBase = {}; // Driver counters when the port was opened
+};
@@ -0,0 +1,29 @@
+#pragma once
+#include <stdint.h>
+
+// Sample stream of the ingest daemon (-p), for any number of local subscribers.
+//
+// A subscriber connects to the Unix socket or TCP port and only reads. Every frame is
+//   type (1 byte) | payload length (1 byte) | payload
+// with little endian fields. On connect the daemon sends one PUBLISH_DEVICE frame per device, then the samples
+// of every device as they are decoded. A subscriber that reads too slowly loses its oldest queued samples, the
+// number is reported in a PUBLISH_DROPPED frame before the next sample.
+
+#define PUBLISH_FRAME_HEADER 2
+
+#define PUBLISH_DEVICE 0x01	 // uint16 device | port name (no terminator)
+#define PUBLISH_SAMPLE 0x02	 // uint16 device | uint16 sequence | double time [Unix s] | float sonic [cm] | float photo [ADC]
+#define PUBLISH_DROPPED 0x03 // uint32 samples dropped for this subscriber since the last report
+
+#define PUBLISH_SAMPLE_SIZE 20
+#define PUBLISH_DROPPED_SIZE 4
+#define PUBLISH_NAME_SIZE 255 // Longest device name
+
+typedef struct
+{
+	uint16_t device;   // Index of the device, as in its PUBLISH_DEVICE frame
+	uint16_t sequence; // Device sequence number, 0 for Message frames (they have none)
+	double time;	   // [s] Unix time the device took the sample
+	float sonic;	   // [cm]
+	float photo;	   // [ADC]
+} PublishedSample;
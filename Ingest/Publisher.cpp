@@ -0,0 +1,307 @@
+#include "Publisher.h"
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include "Socket.h"
+
+/**
+ * @brief Appends one frame to an encode buffer
+ */
+static void appendFrame(std::string* buffer, uint8_t type, const void* payload, size_t payloadSize)
+{
+	buffer->push_back(static_cast<char>(type));
+	buffer->push_back(static_cast<char>(payloadSize));
+	buffer->append(static_cast<const char*>(payload), payloadSize);
+}
+
+/**
+ * @brief Construct a new publisher object, it listens after begin()
+ */
+Publisher::Publisher()
+{
+	static_assert((PUBLISH_QUEUE_SAMPLES & (PUBLISH_QUEUE_SAMPLES - 1)) == 0, "PUBLISH_QUEUE_SAMPLES must be a power of two");
+}
+
+/**
+ * @brief Disconnects the subscribers and closes the listener
+ */
+Publisher::~Publisher()
+{
+	for (Subscriber& subscriber : this->m_subscribers)
+		this->close(subscriber);
+	closeListener(this->m_listener, this->m_address);
+}
+
+/**
+ * @brief Starts listening for subscribers and registers the listener with the event loop
+ *
+ * @param address "host:port" (TCP, 127.0.0.1 by default) or a Unix socket path
+ * @param epoll Event loop
+ * @param tag epoll data of the publisher, the index of the descriptor is added: 0 - listener, 1.. - subscribers
+ *
+ * @return false if the address can not be bound
+ */
+bool Publisher::begin(const std::string& address, int epoll, uint64_t tag)
+{
+	this->m_listener = listenLocal(address);
+	if (this->m_listener < 0)
+		return false;
+
+	this->m_address = address;
+	this->m_epoll = epoll;
+	this->m_tag = tag;
+
+	epoll_event event = {};
+	event.events = EPOLLIN;
+	event.data.u64 = tag;
+	return epoll_ctl(epoll, EPOLL_CTL_ADD, this->m_listener, &event) == 0;
+}
+
+/**
+ * @brief Adds a device to the list sent to new subscribers, its index is the device field of its samples
+ */
+void Publisher::addDevice(const std::string& name)
+{
+	this->m_devices.push_back(name.substr(0, PUBLISH_NAME_SIZE - 2));
+}
+
+/**
+ * @brief Queues a sample for every subscriber, it is sent by the next flush()
+ */
+void Publisher::publish(const PublishedSample& sample)
+{
+	for (Subscriber& subscriber : this->m_subscribers)
+	{
+		if (subscriber.fd < 0)
+			continue;
+
+		if (subscriber.head - subscriber.tail == PUBLISH_QUEUE_SAMPLES)
+		{
+			subscriber.tail++;
+			subscriber.dropped++;
+			this->m_dropped++;
+		}
+		subscriber.queue[subscriber.head & (PUBLISH_QUEUE_SAMPLES - 1)] = sample;
+		subscriber.head++;
+	}
+}
+
+/**
+ * @brief Sends what is queued to every subscriber that can take it, call it once per loop iteration
+ */
+void Publisher::flush()
+{
+	for (Subscriber& subscriber : this->m_subscribers)
+	{
+		if (subscriber.fd >= 0 && !subscriber.waiting &&
+			(subscriber.head != subscriber.tail || subscriber.dropped > 0 || !subscriber.pending.empty()))
+			this->send(subscriber);
+	}
+}
+
+/**
+ * @brief Handles a ready descriptor of the publisher
+ *
+ * @param index 0 - listener, 1.. - subscriber
+ * @param events epoll events
+ */
+void Publisher::onEvent(uint32_t index, uint32_t events)
+{
+	if (index == 0)
+	{
+		this->accept();
+		return;
+	}
+	if (index > PUBLISH_MAX_SUBSCRIBERS || this->m_subscribers[index - 1].fd < 0)
+		return;
+
+	Subscriber& subscriber = this->m_subscribers[index - 1];
+	if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+	{
+		// Subscribers only read, anything they write is discarded. End of file is the disconnect.
+		char buffer[256];
+		ssize_t result;
+		while ((result = recv(subscriber.fd, buffer, sizeof(buffer), 0)) > 0)
+			;
+		if (result == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+		{
+			this->close(subscriber);
+			return;
+		}
+	}
+	if (events & EPOLLOUT)
+	{
+		this->wait(subscriber, false);
+		this->send(subscriber);
+	}
+}
+
+/**
+ * @brief true if the publisher is listening
+ */
+bool Publisher::isOpen() const
+{
+	return this->m_listener >= 0;
+}
+
+/**
+ * @brief Number of connected subscribers
+ */
+size_t Publisher::subscribers() const
+{
+	size_t count = 0;
+	for (const Subscriber& subscriber : this->m_subscribers)
+		count += subscriber.fd >= 0 ? 1 : 0;
+	return count;
+}
+
+/**
+ * @brief Samples dropped for slow subscribers, over all of them
+ */
+uint64_t Publisher::dropped() const
+{
+	return this->m_dropped;
+}
+
+/**
+ * @brief Samples waiting in the fullest subscriber queue
+ */
+size_t Publisher::queued() const
+{
+	uint64_t queued = 0;
+	for (const Subscriber& subscriber : this->m_subscribers)
+	{
+		if (subscriber.fd >= 0 && subscriber.head - subscriber.tail > queued)
+			queued = subscriber.head - subscriber.tail;
+	}
+	return static_cast<size_t>(queued);
+}
+
+//==================================================================================================
+/**
+ * @brief Takes the pending connections while there are free slots, a new subscriber gets the device list first
+ */
+void Publisher::accept()
+{
+	for (size_t i = 0; i < PUBLISH_MAX_SUBSCRIBERS; i++)
+	{
+		Subscriber& subscriber = this->m_subscribers[i];
+		if (subscriber.fd >= 0)
+			continue;
+
+		subscriber.fd = acceptClient(this->m_listener);
+		if (subscriber.fd < 0)
+			return;
+
+		if (!subscriber.queue)
+			subscriber.queue.reset(new PublishedSample[PUBLISH_QUEUE_SAMPLES]);
+		subscriber.head = 0;
+		subscriber.tail = 0;
+		subscriber.dropped = 0;
+		subscriber.waiting = false;
+		subscriber.pending.clear();
+		for (size_t device = 0; device < this->m_devices.size(); device++)
+		{
+			uint8_t payload[PUBLISH_NAME_SIZE];
+			uint16_t index = static_cast<uint16_t>(device);
+			memcpy(payload, &index, 2);
+			memcpy(payload + 2, this->m_devices[device].data(), this->m_devices[device].size());
+			appendFrame(&subscriber.pending, PUBLISH_DEVICE, payload, 2 + this->m_devices[device].size());
+		}
+
+		epoll_event event = {};
+		event.events = EPOLLIN | EPOLLRDHUP;
+		event.data.u64 = this->m_tag + i + 1;
+		if (epoll_ctl(this->m_epoll, EPOLL_CTL_ADD, subscriber.fd, &event) != 0)
+			this->close(subscriber);
+	}
+
+	// Every slot is busy: turn the rest away, or the listener stays ready and the loop spins
+	int fd;
+	while ((fd = acceptClient(this->m_listener)) >= 0)
+		::close(fd);
+}
+
+/**
+ * @brief Encodes the queue and writes until it is empty or the socket is full
+ */
+void Publisher::send(Subscriber& subscriber)
+{
+	while (true)
+	{
+		if (subscriber.pending.empty())
+		{
+			if (subscriber.dropped > 0)
+			{
+				uint32_t dropped = static_cast<uint32_t>(subscriber.dropped);
+				appendFrame(&subscriber.pending, PUBLISH_DROPPED, &dropped, PUBLISH_DROPPED_SIZE);
+				subscriber.dropped = 0;
+			}
+
+			while (subscriber.tail != subscriber.head && subscriber.pending.size() + PUBLISH_FRAME_HEADER + PUBLISH_SAMPLE_SIZE <= PUBLISH_SEND_SIZE)
+			{
+				const PublishedSample& sample = subscriber.queue[subscriber.tail & (PUBLISH_QUEUE_SAMPLES - 1)];
+				uint8_t payload[PUBLISH_SAMPLE_SIZE];
+				memcpy(payload, &sample.device, 2);
+				memcpy(payload + 2, &sample.sequence, 2);
+				memcpy(payload + 4, &sample.time, 8);
+				memcpy(payload + 12, &sample.sonic, 4);
+				memcpy(payload + 16, &sample.photo, 4);
+				appendFrame(&subscriber.pending, PUBLISH_SAMPLE, payload, sizeof(payload));
+				subscriber.tail++;
+			}
+
+			if (subscriber.pending.empty())
+				return;
+		}
+
+		ssize_t result = ::send(subscriber.fd, subscriber.pending.data(), subscriber.pending.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+		if (result < 0)
+		{
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				this->wait(subscriber, true);
+			else if (errno != EINTR)
+				this->close(subscriber);
+			return;
+		}
+
+		subscriber.pending.erase(0, static_cast<size_t>(result));
+		if (!subscriber.pending.empty())
+		{
+			// The socket took part of it, it is full
+			this->wait(subscriber, true);
+			return;
+		}
+	}
+}
+
+/**
+ * @brief Registers / unregisters a subscriber for EPOLLOUT
+ */
+void Publisher::wait(Subscriber& subscriber, bool waiting)
+{
+	if (subscriber.waiting == waiting)
+		return;
+
+	subscriber.waiting = waiting;
+	epoll_event event = {};
+	event.events = EPOLLIN | EPOLLRDHUP | (waiting ? static_cast<uint32_t>(EPOLLOUT) : 0);
+	event.data.u64 = this->m_tag + static_cast<uint64_t>(&subscriber - this->m_subscribers) + 1;
+	epoll_ctl(this->m_epoll, EPOLL_CTL_MOD, subscriber.fd, &event);
+}
+
+/**
+ * @brief Disconnects a subscriber and frees its slot (the queue memory is kept for the next one)
+ */
+void Publisher::close(Subscriber& subscriber)
+{
+	if (subscriber.fd < 0)
+		return;
+
+	epoll_ctl(this->m_epoll, EPOLL_CTL_DEL, subscriber.fd, nullptr);
+	::close(subscriber.fd);
+	subscriber.fd = -1;
+	subscriber.pending.clear();
+}
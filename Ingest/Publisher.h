@@ -0,0 +1,59 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include "PublishProtocol.h"
+
+#define PUBLISH_MAX_SUBSCRIBERS 16
+#define PUBLISH_QUEUE_SAMPLES 8192 // Samples queued per subscriber, power of two, the oldest are dropped
+#define PUBLISH_SEND_SIZE 16384	   // Bytes handed to the socket at once
+
+// Fans the decoded samples out to local subscribers (see PublishProtocol.h), driven by the epoll loop.
+//
+// Every subscriber has its own queue: publish() only copies the sample into each queue, flush() writes once per
+// loop iteration with non-blocking sends. A subscriber whose socket is full waits for EPOLLOUT while its queue
+// drops the oldest samples, so a slow consumer never stalls the serial ports or the other subscribers.
+class Publisher
+{
+public:
+	Publisher();
+	~Publisher();
+
+	bool begin(const std::string& address, int epoll, uint64_t tag);
+	void addDevice(const std::string& name);
+	void publish(const PublishedSample& sample);
+	void flush();
+	void onEvent(uint32_t index, uint32_t events);
+
+	bool isOpen() const;
+	size_t subscribers() const;
+	uint64_t dropped() const;
+	size_t queued() const;
+
+private:
+	struct Subscriber
+	{
+		int fd = -1;
+		bool waiting = false; // Socket full, EPOLLOUT is registered
+		std::unique_ptr<PublishedSample[]> queue;
+		uint64_t head = 0; // Samples ever queued
+		uint64_t tail = 0; // Samples ever sent (or dropped)
+		uint64_t dropped = 0; // Not reported yet
+		std::string pending; // Encoded bytes the socket did not take yet
+	};
+
+	void accept();
+	void send(Subscriber& subscriber);
+	void wait(Subscriber& subscriber, bool waiting);
+	void close(Subscriber& subscriber);
+
+	std::string m_address;
+	int m_listener = -1;
+	int m_epoll = -1;
+	uint64_t m_tag = 0;
+	std::vector<std::string> m_devices;
+	Subscriber m_subscribers[PUBLISH_MAX_SUBSCRIBERS];
+	uint64_t m_dropped = 0; // Over all subscribers
+};
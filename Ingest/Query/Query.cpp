@@ -0,0 +1,260 @@
+#include "Query.h"
+#include <iostream>
+#include <thread>
+
+/**
+ * @brief Adds one value to a bucket
+ */
+static inline void accumulate(QueryAggregate& aggregate, float value)
+{
+	if (aggregate.count == 0 || value < aggregate.min)
+		aggregate.min = value;
+	if (aggregate.count == 0 || value > aggregate.max)
+		aggregate.max = value;
+	aggregate.count++;
+	aggregate.sum += value;
+}
+
+/**
+ * @brief Adds the values of one bucket to another
+ */
+static inline void merge(QueryAggregate& aggregate, const QueryAggregate& other)
+{
+	if (other.count == 0)
+		return;
+	if (aggregate.count == 0 || other.min < aggregate.min)
+		aggregate.min = other.min;
+	if (aggregate.count == 0 || other.max > aggregate.max)
+		aggregate.max = other.max;
+	aggregate.count += other.count;
+	aggregate.sum += other.sum;
+}
+
+/**
+ * @brief Floor of a / b for b > 0, the integer division rounds towards zero
+ */
+static inline int64_t floorDivide(int64_t a, int64_t b)
+{
+	return a / b - (a % b < 0 ? 1 : 0);
+}
+
+/**
+ * @brief Maps a store file, its samples are part of every following run()
+ *
+ * @return false if the file can not be read
+ */
+bool Query::add(const std::string& path)
+{
+	std::unique_ptr<ChunkFile> file(new ChunkFile);
+	if (!file->open(path))
+	{
+		std::cerr << "[ Query ERR ]: could not read " << path << std::endl;
+		return false;
+	}
+	this->m_files.push_back(std::move(file));
+	return true;
+}
+
+/**
+ * @brief Aggregates the samples of every file in a time range
+ *
+ * @param from [us] Unix time, INT64_MIN for the oldest sample
+ * @param to [us] Unix time, exclusive, INT64_MAX for after the newest sample
+ * @param bucket [us] Bucket length, 0 for one bucket over the whole range
+ * @param column Values to aggregate
+ * @param threads Decoding threads, 0 for one per core
+ *
+ * @return false if the range has too many buckets
+ */
+bool Query::run(int64_t from, int64_t to, int64_t bucket, QueryColumn column, unsigned threads)
+{
+	this->m_buckets.clear();
+	this->m_tasks.clear();
+	this->m_next = 0;
+	this->m_chunks = 0;
+	this->m_summarized = 0;
+	this->m_column = column;
+
+	// An open end is where the data ends
+	int64_t first = INT64_MAX;
+	int64_t last = INT64_MIN;
+	for (const std::unique_ptr<ChunkFile>& file : this->m_files)
+	{
+		for (size_t i = 0; i < file->size(); i++)
+		{
+			const ChunkHeader& header = file->header(i);
+			first = header.timeMin < first ? header.timeMin : first;
+			last = header.timeMax > last ? header.timeMax : last;
+		}
+	}
+	if (first > last)
+		return true;
+	this->m_from = from == INT64_MIN ? first : from;
+	this->m_to = to == INT64_MAX ? last + 1 : to;
+	if (this->m_to <= this->m_from)
+		return true;
+
+	if (bucket > 0)
+	{
+		this->m_bucket = bucket;
+		this->m_start = floorDivide(this->m_from, bucket) * bucket;
+	}
+	else
+	{
+		this->m_bucket = this->m_to - this->m_from;
+		this->m_start = this->m_from;
+	}
+	int64_t buckets = floorDivide(this->m_to - 1 - this->m_start, this->m_bucket) + 1;
+	if (buckets > QUERY_MAX_BUCKETS)
+	{
+		std::cerr << "[ Query ERR ]: " << buckets << " buckets, at most " << QUERY_MAX_BUCKETS << " are allowed" << std::endl;
+		return false;
+	}
+	this->m_buckets.assign(static_cast<size_t>(buckets), QueryAggregate{});
+
+	// Headers decide what is skipped, answered by the summary or decoded
+	for (const std::unique_ptr<ChunkFile>& file : this->m_files)
+	{
+		for (size_t i = 0; i < file->size(); i++)
+		{
+			const ChunkHeader& header = file->header(i);
+			if (header.timeMax < this->m_from || header.timeMin >= this->m_to)
+				continue;
+			this->m_chunks++;
+
+			int64_t index = floorDivide(header.timeMin - this->m_start, this->m_bucket);
+			if (header.timeMin >= this->m_from && header.timeMax < this->m_to && index == floorDivide(header.timeMax - this->m_start, this->m_bucket))
+			{
+				QueryAggregate summary;
+				summary.count = header.count;
+				summary.sum = column == QUERY_SONIC ? header.sonicSum : header.photoSum;
+				summary.min = column == QUERY_SONIC ? header.sonicMin : header.photoMin;
+				summary.max = column == QUERY_SONIC ? header.sonicMax : header.photoMax;
+				merge(this->m_buckets[static_cast<size_t>(index)], summary);
+				this->m_summarized++;
+			}
+			else
+			{
+				this->m_tasks.push_back({file.get(), i});
+			}
+		}
+	}
+
+	if (threads == 0)
+		threads = std::thread::hardware_concurrency();
+	if (threads > this->m_tasks.size())
+		threads = static_cast<unsigned>(this->m_tasks.size());
+	if (threads <= 1)
+	{
+		this->work(&this->m_buckets);
+		return true;
+	}
+
+	std::vector<std::vector<QueryAggregate>> partials(threads);
+	std::vector<std::thread> workers;
+	for (unsigned i = 0; i < threads; i++)
+	{
+		partials[i].assign(this->m_buckets.size(), QueryAggregate{});
+		workers.emplace_back(&Query::work, this, &partials[i]);
+	}
+	for (unsigned i = 0; i < threads; i++)
+	{
+		workers[i].join();
+		for (size_t j = 0; j < this->m_buckets.size(); j++)
+			merge(this->m_buckets[j], partials[i][j]);
+	}
+	return true;
+}
+
+/**
+ * @brief Number of buckets of the last run(), empty ones included
+ */
+size_t Query::size() const
+{
+	return this->m_buckets.size();
+}
+
+/**
+ * @brief Start of a bucket [us], Unix time
+ */
+int64_t Query::time(size_t index) const
+{
+	return this->m_start + static_cast<int64_t>(index) * this->m_bucket;
+}
+
+/**
+ * @brief Values of a bucket, count is 0 if it has none
+ */
+const QueryAggregate& Query::aggregate(size_t index) const
+{
+	return this->m_buckets[index];
+}
+
+/**
+ * @brief Chunks the last run() did not skip
+ */
+size_t Query::chunks() const
+{
+	return this->m_chunks;
+}
+
+/**
+ * @brief Chunks the last run() answered from their header
+ */
+size_t Query::summarized() const
+{
+	return this->m_summarized;
+}
+
+/**
+ * @brief Chunks the last run() decoded
+ */
+size_t Query::decoded() const
+{
+	return this->m_tasks.size();
+}
+
+//==================================================================================================
+/**
+ * @brief Decodes tasks until none is left
+ *
+ * @param buckets Buckets of the calling thread
+ */
+void Query::work(std::vector<QueryAggregate>* buckets)
+{
+	std::vector<int64_t> times;
+	std::vector<float> values;
+	for (size_t task = this->m_next++; task < this->m_tasks.size(); task = this->m_next++)
+	{
+		const ChunkFile& file = *this->m_tasks[task].file;
+		size_t index = this->m_tasks[task].index;
+		uint32_t count = file.header(index).count;
+		if (times.size() < count)
+		{
+			times.resize(count);
+			values.resize(count);
+		}
+		if (this->m_column == QUERY_SONIC)
+			file.decode(index, times.data(), values.data(), nullptr);
+		else
+			file.decode(index, times.data(), nullptr, values.data());
+
+		// Samples mostly come in order, the bucket of the previous one is tried first
+		int64_t begin = 0;
+		int64_t end = 0;
+		size_t bucket = 0;
+		for (uint32_t i = 0; i < count; i++)
+		{
+			int64_t time = times[i];
+			if (time < this->m_from || time >= this->m_to)
+				continue;
+			if (time < begin || time >= end)
+			{
+				bucket = static_cast<size_t>((time - this->m_start) / this->m_bucket);
+				begin = this->m_start + static_cast<int64_t>(bucket) * this->m_bucket;
+				end = begin + this->m_bucket;
+			}
+			accumulate((*buckets)[bucket], values[i]);
+		}
+	}
+}
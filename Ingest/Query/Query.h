@@ -0,0 +1,68 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include "ChunkFile.h"
+
+#define QUERY_MAX_BUCKETS 10000000 // A query asking for more buckets is refused
+
+enum QueryColumn
+{
+	QUERY_SONIC,
+	QUERY_PHOTO
+};
+
+typedef struct
+{
+	uint64_t count;
+	double sum;
+	float min;
+	float max;
+} QueryAggregate;
+
+// Time range aggregates (count, min, max, mean per bucket) over store files (ChunkFile.h). Buckets are aligned to
+// multiples of their length in Unix time, like the chunks.
+//
+// A chunk outside the range is skipped by its header. A chunk inside the range whose samples all fall into one
+// bucket is answered by its header summary. Only the rest is decoded, the time column and the queried column,
+// by a pool of threads each filling its own buckets, which are merged at the end.
+class Query
+{
+public:
+	bool add(const std::string& path);
+	bool run(int64_t from, int64_t to, int64_t bucket, QueryColumn column, unsigned threads);
+
+	size_t size() const;
+	int64_t time(size_t index) const;
+	const QueryAggregate& aggregate(size_t index) const;
+
+	size_t chunks() const;
+	size_t summarized() const;
+	size_t decoded() const;
+
+private:
+	struct Task
+	{
+		const ChunkFile* file;
+		size_t index;
+	};
+
+	void work(std::vector<QueryAggregate>* buckets);
+
+	std::vector<std::unique_ptr<ChunkFile>> m_files;
+	std::vector<Task> m_tasks;
+	std::atomic<size_t> m_next{0};
+	std::vector<QueryAggregate> m_buckets;
+
+	int64_t m_from = 0;	 // [us] Range, to is exclusive
+	int64_t m_to = 0;
+	int64_t m_start = 0; // [us] Start of the first bucket
+	int64_t m_bucket = 0;
+	QueryColumn m_column = QUERY_SONIC;
+
+	size_t m_chunks = 0;
+	size_t m_summarized = 0;
+};
@@ -0,0 +1,149 @@
+/**
+ * @file main.cpp
+ * @brief Query tool: time range aggregates over the store files of the ingest daemon.
+ *
+ * Usage: query [-v sonic | photo] [-f from] [-t to] [-b bucket] [-j threads] file.tsc ...
+ *
+ * Times are local, "2026-10-13", "2026-10-13 14:00", "2026-10-13 14:00:05" or Unix seconds, an omitted end is
+ * where the data ends. The bucket is seconds or a number with an s / m / h / d suffix, e.g. "1m", without it
+ * the whole range is one bucket. The samples of all given files are aggregated together. Prints one CSV line
+ * per bucket that has samples: start, count, min, max, mean.
+ */
+
+#include <iostream>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "Query.h"
+
+/**
+ * @brief Parses a local date and time or Unix seconds
+ *
+ * @param result Out [us] Unix time
+ *
+ * @return false if the text is neither
+ */
+static bool parseTime(const char* text, int64_t* result)
+{
+	char* end;
+	long long seconds = strtoll(text, &end, 10);
+	if (*end == '\0' && end != text)
+	{
+		*result = seconds * 1000000;
+		return true;
+	}
+
+	const char* formats[] = {"%Y-%m-%d %H:%M:%S", "%Y-%m-%dT%H:%M:%S", "%Y-%m-%d %H:%M", "%Y-%m-%dT%H:%M", "%Y-%m-%d"};
+	for (const char* format : formats)
+	{
+		tm local = {};
+		const char* rest = strptime(text, format, &local);
+		if (rest != nullptr && *rest == '\0')
+		{
+			local.tm_isdst = -1;
+			*result = static_cast<int64_t>(mktime(&local)) * 1000000;
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * @brief Parses a bucket length, "90", "30s", "1m", "1h", "1d"
+ *
+ * @param result Out [us]
+ *
+ * @return false if the text is not a positive length
+ */
+static bool parseDuration(const char* text, int64_t* result)
+{
+	char* end;
+	double value = strtod(text, &end);
+	double unit = 1.0;
+	if (strcmp(end, "m") == 0)
+		unit = 60.0;
+	else if (strcmp(end, "h") == 0)
+		unit = 3600.0;
+	else if (strcmp(end, "d") == 0)
+		unit = 86400.0;
+	else if (*end != '\0' && strcmp(end, "s") != 0)
+		return false;
+
+	*result = static_cast<int64_t>(value * unit * 1e6);
+	return end != text && *result > 0;
+}
+
+int main(int argc, char** argv)
+{
+	QueryColumn column = QUERY_SONIC;
+	int64_t from = INT64_MIN;
+	int64_t to = INT64_MAX;
+	int64_t bucket = 0;
+	unsigned threads = 0;
+	Query query;
+	size_t files = 0;
+
+	for (int i = 1; i < argc; i++)
+	{
+		bool valid = true;
+		if (strcmp(argv[i], "-v") == 0 && i + 1 < argc)
+		{
+			i++;
+			valid = strcmp(argv[i], "sonic") == 0 || strcmp(argv[i], "photo") == 0;
+			column = strcmp(argv[i], "photo") == 0 ? QUERY_PHOTO : QUERY_SONIC;
+		}
+		else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc)
+			valid = parseTime(argv[++i], &from);
+		else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+			valid = parseTime(argv[++i], &to);
+		else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc)
+			valid = parseDuration(argv[++i], &bucket);
+		else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+			threads = static_cast<unsigned>(strtoul(argv[++i], nullptr, 10));
+		else if (argv[i][0] == '-')
+			valid = false;
+		else if (query.add(argv[i]))
+			files++;
+		else
+			return 1;
+
+		if (!valid)
+		{
+			std::cerr << "Usage: " << argv[0] << " [-v sonic | photo] [-f from] [-t to] [-b bucket] [-j threads] file.tsc ..." << std::endl;
+			return 1;
+		}
+	}
+
+	if (files == 0)
+	{
+		std::cerr << "[ Query ERR ]: no files given" << std::endl;
+		return 1;
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	if (!query.run(from, to, bucket, column, threads))
+		return 1;
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	printf("time,count,min,max,mean\n");
+	for (size_t i = 0; i < query.size(); i++)
+	{
+		const QueryAggregate& aggregate = query.aggregate(i);
+		if (aggregate.count == 0)
+			continue;
+
+		time_t seconds = static_cast<time_t>(query.time(i) / 1000000);
+		tm local;
+		localtime_r(&seconds, &local);
+		char date[32];
+		strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", &local);
+		printf("%s,%llu,%.2f,%.2f,%.2f\n", date, static_cast<unsigned long long>(aggregate.count), aggregate.min, aggregate.max,
+			   aggregate.sum / aggregate.count);
+	}
+
+	std::cerr << "[ Query INFO ]: " << query.chunks() << " chunks, " << query.summarized() << " from summary, " << query.decoded()
+			  << " decoded in " << elapsed * 1e3 << " ms" << std::endl;
+	return 0;
+}
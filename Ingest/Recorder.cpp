@@ -0,0 +1,131 @@
+#include "Recorder.h"
+#include <iostream>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * @brief Writes the open chunks and closes the files
+ */
+Recorder::~Recorder()
+{
+	this->flush();
+	for (std::unique_ptr<Series>& series : this->m_series)
+	{
+		if (series->fd >= 0)
+			::close(series->fd);
+	}
+}
+
+/**
+ * @brief Opens (or creates) the store file of the next device
+ *
+ * @param path
+ *
+ * @return false if the file can not be opened
+ */
+bool Recorder::add(const std::string& path)
+{
+	std::unique_ptr<Series> series(new Series);
+	series->path = path;
+	series->fd = ::open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+	if (series->fd < 0)
+	{
+		std::cerr << "[ Ingest ERR ]: " << path << ": " << strerror(errno) << std::endl;
+		return false;
+	}
+	this->m_series.push_back(std::move(series));
+	return true;
+}
+
+/**
+ * @brief Adds a sample of a device to its open chunk, the chunk is sealed first if the sample is past its span
+ *
+ * @details Samples recovered from the device backlog may be older than the open chunk, they go into it anyway,
+ * its header covers their time.
+ *
+ * @param index Device, in the order of add()
+ * @param time [us] Unix time
+ * @param sonic [cm]
+ * @param photo [ADC]
+ */
+void Recorder::push(size_t index, int64_t time, float sonic, float photo)
+{
+	if (index >= this->m_series.size())
+		return;
+
+	Series& series = *this->m_series[index];
+	if (series.chunk.count() > 0 && (time >= series.end || series.chunk.count() >= STORE_CHUNK_SAMPLES))
+		this->seal(series);
+
+	if (series.chunk.count() == 0)
+	{
+		const int64_t duration = int64_t(STORE_CHUNK_DURATION) * 1000000;
+		series.end = (time / duration + 1) * duration;
+	}
+	series.chunk.add(time, sonic, photo);
+}
+
+/**
+ * @brief Seals the chunks of the devices that went quiet, call it from the event loop
+ *
+ * @param now [s] Unix time
+ */
+void Recorder::service(double now)
+{
+	int64_t limit = static_cast<int64_t>((now - RECORDER_SEAL_DELAY) * 1e6);
+	for (std::unique_ptr<Series>& series : this->m_series)
+	{
+		if (series->chunk.count() > 0 && series->end <= limit)
+			this->seal(*series);
+	}
+}
+
+/**
+ * @brief Writes every open chunk, e.g. before exiting
+ */
+void Recorder::flush()
+{
+	for (std::unique_ptr<Series>& series : this->m_series)
+		this->seal(*series);
+}
+
+/**
+ * @brief Chunks written
+ */
+uint64_t Recorder::chunks() const
+{
+	return this->m_chunks;
+}
+
+/**
+ * @brief Bytes written to the store files
+ */
+uint64_t Recorder::bytes() const
+{
+	return this->m_bytes;
+}
+
+//==================================================================================================
+/**
+ * @brief Appends the open chunk of a device to its file
+ */
+void Recorder::seal(Series& series)
+{
+	if (series.chunk.count() == 0 || series.fd < 0)
+		return;
+
+	off_t before = lseek(series.fd, 0, SEEK_END);
+	if (!series.chunk.write(series.fd))
+	{
+		std::cerr << "[ Ingest ERR ]: " << series.path << ": chunk lost, " << strerror(errno) << std::endl;
+		// A partial chunk would hide every later one from the readers
+		if (before >= 0 && ftruncate(series.fd, before) != 0)
+			std::cerr << "[ Ingest ERR ]: " << series.path << ": " << strerror(errno) << std::endl;
+		return;
+	}
+
+	this->m_chunks++;
+	this->m_bytes += static_cast<uint64_t>(lseek(series.fd, 0, SEEK_END) - before);
+}
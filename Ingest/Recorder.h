@@ -0,0 +1,41 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include "ChunkFile.h"
+
+#define RECORDER_SEAL_DELAY 5.0 // [s] The chunk of a quiet device is sealed this long after its time span ended
+
+// Records the samples of every device into its own store file (ChunkFile.h). The samples are encoded as they
+// arrive, a chunk is appended in one write when its time span is over, so the event loop does one write per
+// device per STORE_CHUNK_DURATION. The open chunks are written when the recorder is destroyed.
+class Recorder
+{
+public:
+	~Recorder();
+
+	bool add(const std::string& path);
+	void push(size_t index, int64_t time, float sonic, float photo);
+	void service(double now);
+	void flush();
+
+	uint64_t chunks() const;
+	uint64_t bytes() const;
+
+private:
+	struct Series
+	{
+		std::string path;
+		int fd = -1;
+		ChunkBuilder chunk;
+		int64_t end = 0; // [us] End of the time span of the open chunk
+	};
+
+	void seal(Series& series);
+
+	std::vector<std::unique_ptr<Series>> m_series;
+	uint64_t m_chunks = 0;
+	uint64_t m_bytes = 0;
+};
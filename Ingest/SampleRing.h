@@ -0,0 +1,187 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <atomic>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Shared memory ring of the newest samples of one device, written by the ingest daemon (-r), read by any number
+// of processes on the same machine. The segment is a RingHeader followed by capacity RingSlots.
+//
+// Every slot is a seqlock: the writer makes its lock odd, writes the slot, makes it even again, then publishes
+// the new head. A reader copies the slot between two reads of the lock and retries if they differ or are odd.
+// Readers never write to the segment, so any number of them can poll it without slowing the writer.
+//
+// Include this header in a reader and use SampleRingReader, it needs no other file of the daemon.
+
+#define SAMPLE_RING_MAGIC 0x474E4952 // "RING"
+#define SAMPLE_RING_VERSION 1
+#define SAMPLE_RING_NAME_SIZE 64
+#define SAMPLE_RING_RETRIES 1000 // Reads of a slot the writer is in before giving up (the writer died in it)
+
+typedef struct
+{
+	uint64_t position; // Index of the sample since the daemon started
+	uint16_t sequence; // Device sequence number, 0 for Message frames
+	double time;	   // [s] Unix time the device took the sample
+	float sonic;	   // [cm]
+	float photo;	   // [ADC]
+} RingSample;
+
+struct RingHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t capacity; // Slots, power of two
+	uint32_t slotSize; // sizeof(RingSlot)
+	char device[SAMPLE_RING_NAME_SIZE];
+	std::atomic<uint64_t> head; // Samples ever written, the newest is head - 1
+};
+
+struct RingSlot
+{
+	std::atomic<uint32_t> lock; // Odd while the writer is in the slot
+	uint32_t reserved;
+	RingSample sample;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free,
+			  "The ring needs address free atomics");
+
+// Read side of a sample ring, attaches to the segment read only
+class SampleRingReader
+{
+public:
+	~SampleRingReader()
+	{
+		this->detach();
+	}
+
+	/**
+	 * @brief Maps the ring of a device
+	 *
+	 * @param name Shared memory name, e.g. "/ingest-ttyUSB0"
+	 *
+	 * @return false if the ring does not exist or is not a sample ring
+	 */
+	bool attach(const char* name)
+	{
+		this->detach();
+		int fd = shm_open(name, O_RDONLY, 0);
+		if (fd < 0)
+			return false;
+
+		struct stat status;
+		void* memory = MAP_FAILED;
+		if (fstat(fd, &status) == 0 && static_cast<size_t>(status.st_size) >= sizeof(RingHeader))
+			memory = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_SHARED, fd, 0);
+		::close(fd);
+		if (memory == MAP_FAILED)
+			return false;
+
+		this->m_header = static_cast<const RingHeader*>(memory);
+		this->m_slots = reinterpret_cast<const RingSlot*>(this->m_header + 1);
+		this->m_size = static_cast<size_t>(status.st_size);
+
+		const RingHeader& header = *this->m_header;
+		if (header.magic != SAMPLE_RING_MAGIC || header.version != SAMPLE_RING_VERSION || header.slotSize != sizeof(RingSlot) ||
+			header.capacity == 0 || this->m_size < sizeof(RingHeader) + static_cast<size_t>(header.capacity) * sizeof(RingSlot))
+		{
+			this->detach();
+			return false;
+		}
+		return true;
+	}
+
+	/**
+	 * @brief Unmaps the ring
+	 */
+	void detach()
+	{
+		if (this->m_header != nullptr)
+			munmap(const_cast<RingHeader*>(this->m_header), this->m_size);
+		this->m_header = nullptr;
+		this->m_slots = nullptr;
+	}
+
+	/**
+	 * @brief Device the ring belongs to
+	 */
+	const char* device() const
+	{
+		return this->m_header->device;
+	}
+
+	/**
+	 * @brief Samples ever written, poll it to see if there is something new
+	 */
+	uint64_t head() const
+	{
+		return this->m_header->head.load(std::memory_order_acquire);
+	}
+
+	/**
+	 * @brief Copies one sample
+	 *
+	 * @param position Index of the sample, head() - capacity .. head() - 1 are in the ring
+	 * @param sample Out
+	 *
+	 * @return false if the sample was overwritten (or not written yet)
+	 */
+	bool read(uint64_t position, RingSample* sample) const
+	{
+		const RingSlot& slot = this->m_slots[position & (this->m_header->capacity - 1)];
+		for (int retry = 0; retry < SAMPLE_RING_RETRIES; retry++)
+		{
+			uint32_t lock = slot.lock.load(std::memory_order_acquire);
+			if (lock & 1)
+				continue; // The writer is in the slot, it is a few stores long
+			memcpy(sample, &slot.sample, sizeof(RingSample));
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (slot.lock.load(std::memory_order_relaxed) == lock)
+				return sample->position == position;
+		}
+		return false;
+	}
+
+	/**
+	 * @brief Copies the samples written since the last call
+	 *
+	 * @param position In: next sample to read (start with head()), out: the one after the last copied
+	 * @param samples Out
+	 * @param count Size of samples
+	 * @param lost Out, optional: samples overwritten before they could be read
+	 *
+	 * @return Number of samples copied
+	 */
+	size_t poll(uint64_t* position, RingSample* samples, size_t count, uint64_t* lost = nullptr) const
+	{
+		uint64_t head = this->head();
+		uint64_t skipped = 0;
+		size_t copied = 0;
+		while (*position < head && copied < count)
+		{
+			if (head - *position > this->m_header->capacity)
+			{
+				skipped += head - *position - this->m_header->capacity;
+				*position = head - this->m_header->capacity;
+			}
+			if (this->read(*position, &samples[copied]))
+				copied++;
+			else
+				skipped++;
+			(*position)++;
+		}
+		if (lost != nullptr)
+			*lost = skipped;
+		return copied;
+	}
+
+private:
+	const RingHeader* m_header = nullptr;
+	const RingSlot* m_slots = nullptr;
+	size_t m_size = 0;
+};
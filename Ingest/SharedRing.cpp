@@ -0,0 +1,113 @@
+#include "SharedRing.h"
+#include <iostream>
+#include <errno.h>
+#include <new>
+
+/**
+ * @brief Construct a new shared ring object, the segment is made by create()
+ */
+SharedRing::SharedRing()
+{
+}
+
+/**
+ * @brief Unmaps and removes the segment, attached readers keep their mapping
+ */
+SharedRing::~SharedRing()
+{
+	if (this->m_header == nullptr)
+		return;
+
+	munmap(this->m_header, this->m_size);
+	shm_unlink(this->m_name.c_str());
+}
+
+/**
+ * @brief Creates (or replaces) the shared memory segment
+ *
+ * @param name Shared memory name, e.g. "/ingest-ttyUSB0"
+ * @param device Device name stored in the header for the readers
+ * @param capacity Slots, power of two
+ *
+ * @return false if the segment can not be created
+ */
+bool SharedRing::create(const std::string& name, const std::string& device, uint32_t capacity)
+{
+	if (capacity == 0 || (capacity & (capacity - 1)) != 0)
+		return false;
+
+	// A segment left by a crashed daemon may have another size, start over
+	shm_unlink(name.c_str());
+	int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+	size_t size = sizeof(RingHeader) + static_cast<size_t>(capacity) * sizeof(RingSlot);
+	void* memory = MAP_FAILED;
+	if (fd >= 0 && ftruncate(fd, static_cast<off_t>(size)) == 0)
+		memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (fd >= 0)
+		::close(fd);
+	if (memory == MAP_FAILED)
+	{
+		std::cerr << "[ Ingest ERR ]: " << name << ": " << strerror(errno) << std::endl;
+		shm_unlink(name.c_str());
+		return false;
+	}
+
+	// The new segment is zero filled: every slot is unlocked and holds no sample
+	this->m_name = name;
+	this->m_size = size;
+	this->m_header = new (memory) RingHeader;
+	this->m_slots = reinterpret_cast<RingSlot*>(this->m_header + 1);
+	this->m_header->capacity = capacity;
+	this->m_header->slotSize = sizeof(RingSlot);
+	strncpy(this->m_header->device, device.c_str(), SAMPLE_RING_NAME_SIZE - 1);
+	this->m_header->version = SAMPLE_RING_VERSION;
+	this->m_header->head.store(0, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	this->m_header->magic = SAMPLE_RING_MAGIC;
+	return true;
+}
+
+/**
+ * @brief Appends a sample, overwriting the oldest one
+ *
+ * @param sequence Device sequence number, 0 for Message frames
+ * @param time [s] Unix time the device took the sample
+ * @param sonic [cm]
+ * @param photo [ADC]
+ */
+void SharedRing::push(uint16_t sequence, double time, float sonic, float photo)
+{
+	if (this->m_header == nullptr)
+		return;
+
+	RingSlot& slot = this->m_slots[this->m_head & (this->m_header->capacity - 1)];
+	uint32_t lock = slot.lock.load(std::memory_order_relaxed);
+	slot.lock.store(lock + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	slot.sample.position = this->m_head;
+	slot.sample.sequence = sequence;
+	slot.sample.time = time;
+	slot.sample.sonic = sonic;
+	slot.sample.photo = photo;
+
+	slot.lock.store(lock + 2, std::memory_order_release);
+	this->m_head++;
+	this->m_header->head.store(this->m_head, std::memory_order_release);
+}
+
+/**
+ * @brief Shared memory name of the ring
+ */
+const std::string& SharedRing::name() const
+{
+	return this->m_name;
+}
+
+/**
+ * @brief true once the segment is created
+ */
+bool SharedRing::isOpen() const
+{
+	return this->m_header != nullptr;
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include "SampleRing.h"
+
+#define SHARED_RING_SAMPLES 4096 // Newest samples kept per device, power of two
+
+// Write side of a sample ring (see SampleRing.h): creates the shared memory segment of one device and appends
+// its samples. Only the event loop thread writes, a sample costs a few stores and no system call.
+class SharedRing
+{
+public:
+	SharedRing();
+	~SharedRing();
+
+	bool create(const std::string& name, const std::string& device, uint32_t capacity = SHARED_RING_SAMPLES);
+	void push(uint16_t sequence, double time, float sonic, float photo);
+
+	const std::string& name() const;
+	bool isOpen() const;
+
+private:
+	std::string m_name;
+	RingHeader* m_header = nullptr;
+	RingSlot* m_slots = nullptr;
+	size_t m_size = 0;
+	uint64_t m_head = 0;
+};
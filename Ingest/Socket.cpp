@@ -0,0 +1,111 @@
+#include "Socket.h"
+#include <iostream>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+/**
+ * @brief Opens a listening socket
+ *
+ * @param address Unix socket path (contains a '/') or TCP "host:port"
+ *
+ * @return The descriptor, -1 on error (printed)
+ */
+int listenLocal(const std::string& address)
+{
+	int listener = -1;
+	if (address.find('/') != std::string::npos)
+	{
+		sockaddr_un local = {};
+		local.sun_family = AF_UNIX;
+		if (address.size() >= sizeof(local.sun_path))
+		{
+			std::cerr << "[ Socket ERR ]: " << address << ": path too long" << std::endl;
+			return -1;
+		}
+		memcpy(local.sun_path, address.c_str(), address.size() + 1);
+
+		// A stale socket of an earlier run is replaced, any other file is left alone
+		struct stat status;
+		if (lstat(address.c_str(), &status) == 0)
+		{
+			if (!S_ISSOCK(status.st_mode))
+			{
+				std::cerr << "[ Socket ERR ]: " << address << ": exists and is not a socket" << std::endl;
+				return -1;
+			}
+			unlink(address.c_str());
+		}
+
+		listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+		if (listener >= 0 && bind(listener, reinterpret_cast<sockaddr*>(&local), sizeof(local)) != 0)
+		{
+			::close(listener);
+			listener = -1;
+		}
+	}
+	else
+	{
+		size_t colon = address.rfind(':');
+		std::string host = colon == std::string::npos ? "" : address.substr(0, colon);
+		sockaddr_in local = {};
+		local.sin_family = AF_INET;
+		local.sin_port = htons(static_cast<uint16_t>(atoi(address.c_str() + (colon == std::string::npos ? 0 : colon + 1))));
+		if (host.empty() || host == "localhost")
+			host = "127.0.0.1";
+		if (inet_pton(AF_INET, host.c_str(), &local.sin_addr) != 1 || local.sin_port == 0)
+		{
+			std::cerr << "[ Socket ERR ]: " << address << ": expected host:port" << std::endl;
+			return -1;
+		}
+
+		listener = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+		int reuse = 1;
+		if (listener >= 0 && (setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) != 0 ||
+							  bind(listener, reinterpret_cast<sockaddr*>(&local), sizeof(local)) != 0))
+		{
+			::close(listener);
+			listener = -1;
+		}
+	}
+
+	if (listener < 0 || ::listen(listener, SOCKET_BACKLOG) != 0)
+	{
+		std::cerr << "[ Socket ERR ]: " << address << ": " << strerror(errno) << std::endl;
+		if (listener >= 0)
+			::close(listener);
+		return -1;
+	}
+	return listener;
+}
+
+/**
+ * @brief Accepts one pending connection as a non-blocking descriptor
+ *
+ * @return The descriptor, -1 if nothing is pending
+ */
+int acceptClient(int listener)
+{
+	return accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+}
+
+/**
+ * @brief Closes a listener of listenLocal() and removes its socket file
+ */
+void closeListener(int listener, const std::string& address)
+{
+	if (listener < 0)
+		return;
+
+	::close(listener);
+	struct stat status;
+	if (address.find('/') != std::string::npos && lstat(address.c_str(), &status) == 0 && S_ISSOCK(status.st_mode))
+		unlink(address.c_str());
+}
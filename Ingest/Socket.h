@@ -0,0 +1,11 @@
+#pragma once
+#include <string>
+
+#define SOCKET_BACKLOG 16 // Pending connections of a listener
+
+// Local listening sockets of the daemon, both non-blocking and close-on-exec:
+//  "/path/to/socket"     - Unix domain socket, a stale file is replaced
+//  "host:port" / ":port" - TCP, the host defaults to 127.0.0.1
+int listenLocal(const std::string& address);
+int acceptClient(int listener);
+void closeListener(int listener, const std::string& address);
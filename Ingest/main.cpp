@@ -0,0 +1,154 @@
+/**
+ * @file main.cpp
+ * @brief Ingest daemon: collects the samples of many boards from one process.
+ *
+ * Usage: ingest [-b baud] [-s stats seconds] [-m metrics address] [-p publish address] [-r ring prefix]
+ *               [-d store directory] [-c config] [port | glob ...]
+ *
+ * Ports are given as paths or glob patterns (quote them, e.g. '/dev/ttyUSB*'), the config file lists one path
+ * or pattern per line, '#' starts a comment. Patterns are expanded once at start. The metrics address is
+ * "host:port" or a Unix socket path, so is the publish address subscribers connect to (PublishProtocol.h). The
+ * ring prefix names the shared memory sample rings of the devices, e.g. "/ingest" (SampleRing.h). The store
+ * directory gets one time series file per device (ChunkFile.h).
+ */
+
+#include <iostream>
+#include <fstream>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glob.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "Ingest.h"
+
+static Ingest* running = nullptr;
+
+/**
+ * @brief SIGINT / SIGTERM end the event loop
+ */
+static void onSignal(int)
+{
+	if (running != nullptr)
+		running->stop();
+}
+
+/**
+ * @brief Expands a path or glob pattern, a path without a match is kept (it is retried until it appears)
+ */
+static void expand(const std::string& pattern, std::vector<std::string>* ports)
+{
+	glob_t result;
+	if (glob(pattern.c_str(), 0, nullptr, &result) == 0)
+	{
+		for (size_t i = 0; i < result.gl_pathc; i++)
+			ports->push_back(result.gl_pathv[i]);
+	}
+	else if (pattern.find_first_of("*?[") == std::string::npos)
+	{
+		ports->push_back(pattern);
+	}
+	else
+	{
+		std::cerr << "[ Ingest ERR ]: no port matches " << pattern << std::endl;
+	}
+	globfree(&result);
+}
+
+/**
+ * @brief Reads the ports of a config file
+ *
+ * @return false if the file can not be read
+ */
+static bool readConfig(const char* path, std::vector<std::string>* ports)
+{
+	std::ifstream file(path);
+	if (!file)
+	{
+		std::cerr << "[ Ingest ERR ]: could not read " << path << std::endl;
+		return false;
+	}
+
+	std::string line;
+	while (std::getline(file, line))
+	{
+		line = line.substr(0, line.find('#'));
+		size_t begin = line.find_first_not_of(" \t\r");
+		if (begin == std::string::npos)
+			continue;
+		size_t end = line.find_last_not_of(" \t\r");
+		expand(line.substr(begin, end - begin + 1), ports);
+	}
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	unsigned long baudRate = LINK_DEFAULT_BAUD;
+	double statsInterval = INGEST_STATS_INTERVAL;
+	const char* metricsAddress = nullptr;
+	const char* publishAddress = nullptr;
+	const char* ringPrefix = nullptr;
+	const char* storeDirectory = nullptr;
+	std::vector<std::string> ports;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-b") == 0 && i + 1 < argc)
+			baudRate = strtoul(argv[++i], nullptr, 10);
+		else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+			statsInterval = atof(argv[++i]);
+		else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc)
+			metricsAddress = argv[++i];
+		else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc)
+			publishAddress = argv[++i];
+		else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+			ringPrefix = argv[++i];
+		else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc)
+			storeDirectory = argv[++i];
+		else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+		{
+			if (!readConfig(argv[++i], &ports))
+				return 1;
+		}
+		else if (argv[i][0] == '-')
+		{
+			std::cerr << "Usage: " << argv[0] << " [-b baud] [-s stats seconds] [-m metrics address] [-p publish address] [-r ring prefix] [-d store directory] [-c config] [port | glob ...]" << std::endl;
+			return 1;
+		}
+		else
+			expand(argv[i], &ports);
+	}
+
+	if (ports.empty())
+	{
+		std::cerr << "[ Ingest ERR ]: no ports given" << std::endl;
+		return 1;
+	}
+
+	Ingest ingest(baudRate);
+	ingest.setStatsInterval(statsInterval);
+	if (metricsAddress != nullptr && !ingest.serveMetrics(metricsAddress))
+		return 1;
+	if (publishAddress != nullptr && !ingest.publish(publishAddress))
+		return 1;
+	for (size_t i = 0; i < ports.size(); i++)
+	{
+		// A port matched by several patterns is opened once
+		if (std::find(ports.begin(), ports.begin() + i, ports[i]) == ports.begin() + i)
+			ingest.add(ports[i]);
+	}
+	std::cout << "[ Ingest INFO ]: " << ingest.size() << " ports at " << baudRate << " baud" << std::endl;
+	if (ringPrefix != nullptr && !ingest.share(ringPrefix))
+		return 1;
+	if (storeDirectory != nullptr && !ingest.record(storeDirectory))
+		return 1;
+
+	running = &ingest;
+	signal(SIGINT, onSignal);
+	signal(SIGTERM, onSignal);
+	int result = ingest.run();
+	running = nullptr;
+	return result;
+}
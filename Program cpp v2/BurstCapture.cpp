@@ -0,0 +1,108 @@
+#include <string.h>
+#include "BurstCapture.h"
+
+/**
+ * @brief Construct a new burst capture object
+ *
+ */
+BurstCapture::BurstCapture()
+{
+}
+
+/**
+ * @brief Collects one PACKET_BURST_DATA chunk.
+ *
+ * @details Chunks have to arrive in order. A chunk that does not continue the burst being collected (lost
+ * chunk, new burst id) drops that burst, a chunk with offset 0 always starts a new one. The last complete
+ * burst stays available until the next one is complete.
+ *
+ * @param payload Packet payload
+ * @param payloadSize Payload size in bytes
+ *
+ * @return true if the chunk completed a burst
+ */
+bool BurstCapture::add(const uint8_t* payload, size_t payloadSize)
+{
+	if (payloadSize < BURST_CHUNK_HEADER)
+		return false;
+
+	uint8_t id = payload[0];
+	uint16_t rate, total, offset;
+	memcpy(&rate, payload + 1, 2);
+	memcpy(&total, payload + 3, 2);
+	memcpy(&offset, payload + 5, 2);
+	size_t count = payloadSize - BURST_CHUNK_HEADER;
+
+	bool continues = this->m_receiving && id == this->m_current.id && offset == this->m_received;
+	if (!continues)
+	{
+		if (this->m_receiving)
+			this->m_incompleteBursts++;
+		this->m_receiving = false;
+		if (offset != 0)
+			return false;
+
+		this->m_current.id = id;
+		this->m_current.rate = rate;
+		this->m_current.samples.assign(total, 0.0f);
+		this->m_received = 0;
+		this->m_receiving = true;
+	}
+
+	if (offset + count > this->m_current.samples.size())
+	{
+		this->m_incompleteBursts++;
+		this->m_receiving = false;
+		return false;
+	}
+
+	for (size_t i = 0; i < count; i++)
+	{
+		this->m_current.samples[offset + i] = static_cast<float>(payload[BURST_CHUNK_HEADER + i] << 2);
+	}
+	this->m_received += count;
+
+	if (this->m_received < this->m_current.samples.size())
+		return false;
+
+	this->m_burst.id = this->m_current.id;
+	this->m_burst.rate = this->m_current.rate;
+	this->m_burst.samples.swap(this->m_current.samples);
+	this->m_hasBurst = true;
+	this->m_receiving = false;
+	return true;
+}
+
+/**
+ * @brief Drops the burst being collected, the last complete one is kept
+ *
+ */
+void BurstCapture::reset()
+{
+	this->m_receiving = false;
+	this->m_received = 0;
+}
+
+/**
+ * @brief true once a complete burst was received
+ */
+bool BurstCapture::hasBurst() const
+{
+	return this->m_hasBurst;
+}
+
+/**
+ * @brief Last complete burst
+ */
+const Burst& BurstCapture::getBurst() const
+{
+	return this->m_burst;
+}
+
+/**
+ * @brief Number of bursts dropped because a chunk was lost
+ */
+uint64_t BurstCapture::incompleteBursts() const
+{
+	return this->m_incompleteBursts;
+}
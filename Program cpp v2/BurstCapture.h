@@ -0,0 +1,34 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include "Protocol.h"
+
+// One photo cell burst, kept as a single block with its sample rate
+typedef struct
+{
+	uint8_t id;
+	uint16_t rate;			  // [Hz]
+	std::vector<float> samples; // [ADC] 0 - 1023, 8 bit resolution
+} Burst;
+
+class BurstCapture
+{
+public:
+	BurstCapture();
+
+	bool add(const uint8_t* payload, size_t payloadSize);
+	void reset();
+
+	bool hasBurst() const;
+	const Burst& getBurst() const;
+	uint64_t incompleteBursts() const;
+
+private:
+	Burst m_current = {};
+	size_t m_received = 0;
+	bool m_receiving = false;
+	Burst m_burst = {};
+	bool m_hasBurst = false;
+	uint64_t m_incompleteBursts = 0;
+};
@@ -0,0 +1,224 @@
+#include <cmath>
+#include <algorithm>
+#include "DeviceClock.h"
+
+/**
+ * @brief Construct a new device clock object
+ *
+ */
+DeviceClock::DeviceClock()
+{
+	this->m_envelope.reserve(CLOCK_WINDOWS);
+	this->m_exchanges.reserve(CLOCK_EXCHANGES);
+}
+
+/**
+ * @brief Takes a timestamped sample into account and maps it to host time.
+ *
+ * @param deviceTime [us] Device micros() of the sample
+ * @param hostTime [s] Host time the sample arrived at
+ *
+ * @return Host time the sample was taken at [s]
+ */
+double DeviceClock::update(uint32_t deviceTime, double hostTime)
+{
+	int64_t full = this->m_synced ? this->unwrap(deviceTime) : deviceTime;
+	if (!this->m_synced || full > this->m_lastFull)
+	{
+		this->m_last = deviceTime;
+		this->m_lastFull = full;
+	}
+
+	Point point = { full / 1e6, hostTime - full / 1e6 };
+	if (!this->m_synced)
+	{
+		this->m_window = point;
+		this->m_windowStart = point.device;
+		this->m_synced = true;
+	}
+	else if (point.device - this->m_windowStart >= CLOCK_WINDOW)
+	{
+		if (this->m_envelope.size() >= CLOCK_WINDOWS)
+			this->m_envelope.erase(this->m_envelope.begin());
+		this->m_envelope.push_back(this->m_window);
+		this->m_window = point;
+		this->m_windowStart = point.device;
+	}
+	else if (point.offset < this->m_window.offset)
+	{
+		this->m_window = point;
+	}
+
+	this->fit();
+	return this->toHost(deviceTime);
+}
+
+/**
+ * @brief Takes a time exchange into account.
+ *
+ * @param deviceTime [us] Device micros() in the PACKET_TIME reply
+ * @param sent [s] Host time the PACKET_CMD_TIME was sent at
+ * @param received [s] Host time the reply arrived at
+ */
+void DeviceClock::addExchange(uint32_t deviceTime, double sent, double received)
+{
+	if (!this->m_synced)
+		return;
+
+	double device = this->deviceSeconds(deviceTime);
+	if (this->m_exchanges.size() >= CLOCK_EXCHANGES)
+		this->m_exchanges.erase(this->m_exchanges.begin());
+	this->m_exchanges.push_back({ device, sent - device, received - device });
+	this->fit();
+}
+
+/**
+ * @brief Maps a device time to host time.
+ *
+ * @param deviceTime [us] Device micros(), within 35 minutes of the newest sample
+ *
+ * @return Host time [s]
+ */
+double DeviceClock::toHost(uint32_t deviceTime) const
+{
+	double device = this->deviceSeconds(deviceTime);
+	return device + this->line(device) + this->m_correction;
+}
+
+/**
+ * @brief Forgets everything, used when the device restarted
+ */
+void DeviceClock::reset()
+{
+	this->m_synced = false;
+	this->m_envelope.clear();
+	this->m_exchanges.clear();
+	this->m_offset = 0.0;
+	this->m_skew = 0.0;
+	this->m_correction = 0.0;
+	this->m_spread = 0.0;
+	this->m_bound = 0.0;
+}
+
+/**
+ * @brief true once a sample was seen
+ */
+bool DeviceClock::isSynced() const
+{
+	return this->m_synced;
+}
+
+/**
+ * @brief true once a time exchange bounds the latency, before that error() only covers the envelope jitter
+ */
+bool DeviceClock::isBounded() const
+{
+	return !this->m_exchanges.empty();
+}
+
+/**
+ * @brief Unwrapped device time [s]
+ */
+double DeviceClock::deviceSeconds(uint32_t deviceTime) const
+{
+	return this->unwrap(deviceTime) / 1e6;
+}
+
+/**
+ * @brief Rate error of the device clock [ppm], positive if the device runs slow
+ */
+double DeviceClock::skew() const
+{
+	return this->m_skew * 1e6;
+}
+
+/**
+ * @brief Bound of the mapping error [s]
+ */
+double DeviceClock::error() const
+{
+	return this->m_bound + this->m_spread;
+}
+
+/**
+ * @brief Extends a 32 bit device time to the one closest to the newest sample
+ */
+int64_t DeviceClock::unwrap(uint32_t deviceTime) const
+{
+	return this->m_lastFull + static_cast<int32_t>(deviceTime - this->m_last);
+}
+
+/**
+ * @brief Envelope line without the exchange correction [s]
+ */
+double DeviceClock::line(double device) const
+{
+	return this->m_offset + this->m_skew * (device - this->m_reference);
+}
+
+/**
+ * @brief Fits the envelope line and the exchange correction.
+ *
+ * @details The slope is the least squares slope of the envelope points, the line is then lowered onto the
+ * lowest point so that it supports the envelope from below.
+ */
+void DeviceClock::fit()
+{
+	size_t count = this->m_envelope.size() + 1;
+	auto point = [this](size_t i) -> const Point& { return i < this->m_envelope.size() ? this->m_envelope[i] : this->m_window; };
+
+	double meanDevice = 0.0, meanOffset = 0.0;
+	for (size_t i = 0; i < count; i++)
+	{
+		meanDevice += point(i).device;
+		meanOffset += point(i).offset;
+	}
+	meanDevice /= count;
+	meanOffset /= count;
+
+	double covariance = 0.0, variance = 0.0;
+	for (size_t i = 0; i < count; i++)
+	{
+		double dx = point(i).device - meanDevice;
+		covariance += dx * (point(i).offset - meanOffset);
+		variance += dx * dx;
+	}
+
+	this->m_reference = meanDevice;
+	this->m_skew = variance > 0.0 ? covariance / variance : 0.0;
+	this->m_offset = meanOffset;
+
+	double below = 0.0, above = 0.0;
+	for (size_t i = 0; i < count; i++)
+	{
+		double residual = point(i).offset - this->line(point(i).device);
+		below = std::min(below, residual);
+		above = std::max(above, residual);
+	}
+	this->m_offset += below;
+	this->m_spread = above - below;
+
+	// Intersect the exchange intervals relative to the line, the line itself is an upper bound
+	this->m_correction = 0.0;
+	this->m_bound = 0.0;
+	if (this->m_exchanges.empty())
+		return;
+
+	double low = -INFINITY, high = 0.0;
+	for (const Exchange& exchange : this->m_exchanges)
+	{
+		double base = this->line(exchange.device);
+		low = std::max(low, exchange.low - base);
+		high = std::min(high, exchange.high - base);
+	}
+	if (low > high)
+	{
+		// Inconsistent (the skew moved), trust the newest exchange alone
+		const Exchange& newest = this->m_exchanges.back();
+		double base = this->line(newest.device);
+		low = newest.low - base;
+		high = newest.high - base;
+	}
+	this->m_correction = (low + high) / 2.0;
+	this->m_bound = (high - low) / 2.0;
+}
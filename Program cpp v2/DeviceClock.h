@@ -0,0 +1,68 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+#define CLOCK_WINDOW 2.0	  // [s] Device time covered by one lower envelope point
+#define CLOCK_WINDOWS 60	  // Envelope points in the regression, older ones are dropped
+#define CLOCK_EXCHANGES 8	  // Time exchanges kept for the latency correction
+
+// Maps the wrapping device micros() to the host time base with offset and skew estimation.
+//
+// Every timestamped sample is a one-way observation: host time = device time + offset + delay, where the delay
+// (sampling, UART, USB, OS) is never negative. The smallest host - device difference of every CLOCK_WINDOW seconds
+// forms the lower envelope, a least squares line through the envelope gives the offset and the skew of the device
+// resonator. The envelope is still late by the smallest delay, time exchanges (PACKET_CMD_TIME, sent at host time
+// t0 and answered by the device at D, received at t1) bound the true offset to [t0 - D, t1 - D] and pull the line
+// down into that interval. error() is the remaining uncertainty.
+class DeviceClock
+{
+public:
+	DeviceClock();
+
+	double update(uint32_t deviceTime, double hostTime);
+	void addExchange(uint32_t deviceTime, double sent, double received);
+	double toHost(uint32_t deviceTime) const;
+	void reset();
+
+	bool isSynced() const;
+	bool isBounded() const;
+	double deviceSeconds(uint32_t deviceTime) const;
+	double skew() const;
+	double error() const;
+
+private:
+	typedef struct
+	{
+		double device; // [s] Unwrapped device time
+		double offset; // [s] host - device
+	} Point;
+
+	typedef struct
+	{
+		double device; // [s]
+		double low;	   // [s] Smallest possible offset
+		double high;   // [s] Largest possible offset
+	} Exchange;
+
+	int64_t unwrap(uint32_t deviceTime) const;
+	double line(double device) const;
+	void fit();
+
+	bool m_synced = false;
+	uint32_t m_last = 0;	// [us] Newest raw device time
+	int64_t m_lastFull = 0; // [us] Newest device time, unwrapped
+
+	std::vector<Point> m_envelope; // Completed windows, oldest first
+	Point m_window = {};		   // Smallest offset of the current window
+	double m_windowStart = 0.0;	   // [s] Device time the current window started at
+	std::vector<Exchange> m_exchanges;
+
+	// offset(device) = m_offset + m_skew * (device - m_reference) + m_correction
+	double m_reference = 0.0;
+	double m_offset = 0.0;
+	double m_skew = 0.0;
+	double m_correction = 0.0;
+	double m_spread = 0.0;	  // [s] Largest distance of an envelope point above the line
+	double m_bound = 0.0;	  // [s] Half width of the exchange interval
+};
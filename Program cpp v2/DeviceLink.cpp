@@ -0,0 +1,460 @@
+#include "DeviceLink.h"
+#include "FrameParser.h"
+#include <string.h>
+
+/**
+ * @brief Construct a new device link object on an already opened port
+ *
+ * @param port
+ */
+DeviceLink::DeviceLink(SerialHandler& port) : m_port(port)
+{
+}
+
+/**
+ * @brief Frames and sends one packet to the device
+ *
+ * @param type PACKET_CMD_*
+ * @param payload Payload bytes, may be nullptr if payloadSize is 0
+ * @param payloadSize
+ *
+ * @return true - Packet written to the port
+ * @return false - Could not write to the port
+ */
+bool DeviceLink::sendPacket(uint8_t type, const uint8_t* payload, uint8_t payloadSize)
+{
+	uint8_t packet[PACKET_MAX_SIZE];
+	size_t size = FrameParser::encode(type, payload, payloadSize, packet);
+	return this->m_port.write(reinterpret_cast<const char*>(packet), static_cast<unsigned int>(size));
+}
+
+/**
+ * @brief Sets the sample interval of the device, answered with PACKET_ACK
+ *
+ * @param interval [ms]
+ */
+bool DeviceLink::setInterval(uint32_t interval)
+{
+	uint8_t payload[4];
+	memcpy(payload, &interval, sizeof(interval));
+	return this->sendPacket(PACKET_CMD_SET_INTERVAL, payload, sizeof(payload));
+}
+
+/**
+ * @brief Stops sampling on the device, answered with PACKET_ACK
+ */
+bool DeviceLink::pause()
+{
+	return this->sendPacket(PACKET_CMD_PAUSE);
+}
+
+/**
+ * @brief Continues sampling on the device, answered with PACKET_ACK
+ */
+bool DeviceLink::resume()
+{
+	return this->sendPacket(PACKET_CMD_RESUME);
+}
+
+/**
+ * @brief Asks the device for its counters, answered with PACKET_STATS (see getDeviceStats())
+ */
+bool DeviceLink::requestStats()
+{
+	return this->sendPacket(PACKET_CMD_GET_STATS);
+}
+
+/**
+ * @brief Switches the device between Message frames and the compressed stream, answered with PACKET_ACK
+ *
+ * @param enabled
+ */
+bool DeviceLink::setCompression(bool enabled)
+{
+	uint8_t payload = enabled ? 1 : 0;
+	return this->sendPacket(PACKET_CMD_SET_COMPRESSION, &payload, 1);
+}
+
+/**
+ * @brief Sets report on change mode, answered with PACKET_ACK
+ *
+ * @details The device only sends a sample if a channel moved beyond its deadband or nothing was sent for
+ * heartbeat milliseconds.
+ *
+ * @param distance [cm] Distance deadband
+ * @param photo [ADC] Photo cell deadband
+ * @param heartbeat [ms] Longest time without a sample, 0 turns report on change off
+ */
+bool DeviceLink::setDeadband(float distance, uint16_t photo, uint32_t heartbeat)
+{
+	uint16_t hundredths = static_cast<uint16_t>(distance * 100.0f + 0.5f);
+	uint8_t payload[8];
+	memcpy(payload, &hundredths, 2);
+	memcpy(payload + 2, &photo, 2);
+	memcpy(payload + 4, &heartbeat, 4);
+	return this->sendPacket(PACKET_CMD_SET_DEADBAND, payload, sizeof(payload));
+}
+
+/**
+ * @brief Asks the device to capture a high rate photo cell burst, it arrives in PACKET_BURST_DATA chunks.
+ *
+ * @param rate [Hz] Sample rate
+ */
+bool DeviceLink::captureBurst(uint16_t rate)
+{
+	uint8_t payload[2];
+	memcpy(payload, &rate, 2);
+	return this->sendPacket(PACKET_CMD_BURST, payload, sizeof(payload));
+}
+
+/**
+ * @brief Asks the device to replay every sample it still stores, they arrive in PACKET_BACKLOG chunks.
+ */
+bool DeviceLink::requestBacklog()
+{
+	return this->sendPacket(PACKET_CMD_REPLAY);
+}
+
+/**
+ * @brief Starts negotiating the fastest baud rate both sides can run at, service() runs the handshake.
+ *
+ * @details The rates are tried in the given order (fastest first). For every rate the device is asked to switch
+ * at the current rate, then the host switches and confirms at the new rate. If the confirmation does not get
+ * through, both sides return to LINK_DEFAULT_BAUD and the next rate is tried. Frames keep flowing through the
+ * normal receive path meanwhile.
+ *
+ * @param baudRates Candidate baud rates, fastest first. The array must outlive the link.
+ * @param count
+ */
+void DeviceLink::negotiate(const unsigned long* baudRates, size_t count)
+{
+	this->m_baudRates = baudRates;
+	this->m_baudRateCount = count;
+	this->m_phase = Phase::Starting;
+}
+
+/**
+ * @brief Runs the negotiation, keeps a negotiated link alive and falls back on errors. Call it once per update,
+ * it never blocks.
+ *
+ * @details At a negotiated baud rate the device is pinged every LINK_PING_INTERVAL. If no valid frame arrived for
+ * LINK_WATCHDOG_TIMEOUT the host stops pinging, waits for the device watchdog and renegotiates from the default
+ * rate. If more than LINK_MAX_ERRORS_PER_PING errors happened since the last ping, the current rate is dropped
+ * from the candidates and the link is renegotiated.
+ *
+ * @param errorCount Total number of line and check sum errors seen so far
+ *
+ * @return true when a negotiation finished, the bytes received before belong to another baud rate
+ */
+bool DeviceLink::service(uint64_t errorCount)
+{
+	if (this->m_baudRates == nullptr)
+	{
+		this->m_lastErrorCount = errorCount;
+		return false;
+	}
+
+	ULONGLONG now = GetTickCount64();
+	bool received = this->m_statusReceived;
+	this->m_statusReceived = false;
+	const LinkStatus& status = this->m_deviceStatus;
+	uint32_t candidate = this->m_candidate < this->m_baudRateCount ? static_cast<uint32_t>(this->m_baudRates[this->m_candidate]) : 0;
+
+	switch (this->m_phase)
+	{
+	case Phase::Running:
+		return this->watch(now, errorCount);
+
+	case Phase::Starting:
+		this->m_candidate = this->m_firstBaudRate;
+		return this->request(now, errorCount);
+
+	case Phase::Requesting:
+		if (received && status.requestedBaud == candidate && status.state == LINK_STATE_ACCEPTED)
+		{
+			this->m_phase = Phase::Switching;
+			this->m_deadline = now + LINK_SWITCH_DELAY;
+		}
+		else if ((received && status.requestedBaud == candidate && status.state == LINK_STATE_REJECTED) || now >= this->m_deadline)
+		{
+			this->m_candidate++;
+			return this->request(now, errorCount);
+		}
+		return false;
+
+	case Phase::Switching:
+		if (now < this->m_deadline)
+			return false;
+		if (!this->m_port.setBaudRate(candidate))
+		{
+			this->recover(now);
+			return false;
+		}
+		this->m_attempts = 0;
+		this->confirm(now);
+		return false;
+
+	case Phase::Confirming:
+		if (received && status.state != LINK_STATE_ACCEPTED)
+			return this->settle(now, errorCount);
+		if (now < this->m_deadline)
+			return false;
+		if (this->m_attempts < LINK_CONFIRM_ATTEMPTS)
+			this->confirm(now);
+		else
+			this->recover(now);
+		return false;
+
+	case Phase::Recovering:
+		if (now < this->m_deadline)
+			return false;
+		this->m_port.setBaudRate(LINK_DEFAULT_BAUD);
+		this->m_candidate++;
+		return this->request(now, errorCount);
+
+	case Phase::FallingBack:
+		if (now < this->m_deadline)
+			return false;
+		this->m_port.setBaudRate(LINK_DEFAULT_BAUD);
+		this->m_phase = Phase::Starting;
+		return false;
+	}
+	return false;
+}
+
+/**
+ * @brief true while the baud rate is being negotiated
+ */
+bool DeviceLink::isNegotiating() const
+{
+	return this->m_phase != Phase::Running;
+}
+
+/**
+ * @brief Feeds the watchdog, call it for every valid frame
+ */
+void DeviceLink::onFrame()
+{
+	this->m_lastFrame = GetTickCount64();
+}
+
+/**
+ * @brief Picks up link status, stats and ack packets from the normal receive path
+ *
+ * @param type Packet type
+ * @param payload
+ * @param payloadSize
+ */
+void DeviceLink::onPacket(uint8_t type, const uint8_t* payload, size_t payloadSize)
+{
+	switch (type)
+	{
+	case PACKET_LINK_STATUS:
+		if (parseLinkStatus(payload, payloadSize, &this->m_deviceStatus))
+			this->m_statusReceived = true;
+		break;
+	case PACKET_STATS:
+		parseStats(payload, payloadSize, &this->m_deviceStats);
+		break;
+	case PACKET_ACK:
+		if (payloadSize >= 2 && payload[1] != ACK_OK)
+		{
+			std::cerr << "[ Link ERR ]: Command 0x" << std::hex << static_cast<int>(payload[0]) << " rejected ("
+					  << static_cast<int>(payload[1]) << ")" << std::dec << std::endl;
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+/**
+ * @brief Returns the last link status reported by the device
+ */
+const LinkStatus& DeviceLink::getDeviceStatus()
+{
+	return this->m_deviceStatus;
+}
+
+/**
+ * @brief Returns the last counters reported by the device in PACKET_STATS
+ */
+const DeviceStats& DeviceLink::getDeviceStats()
+{
+	return this->m_deviceStats;
+}
+
+/**
+ * @brief Returns how many times the host had to fall back to a slower baud rate
+ */
+unsigned long DeviceLink::getFallbacks()
+{
+	return this->m_fallbacks;
+}
+
+//==================================================================================================
+/**
+ * @brief Pings a negotiated link and starts over if it went silent or too many errors happened
+ *
+ * @return false, the rate only changes once the device watchdog fired
+ */
+bool DeviceLink::watch(ULONGLONG now, uint64_t errorCount)
+{
+	if (this->m_port.getBaudRate() == LINK_DEFAULT_BAUD)
+	{
+		this->m_lastErrorCount = errorCount;
+		return false;
+	}
+
+	if (now - this->m_lastFrame >= LINK_WATCHDOG_TIMEOUT)
+	{
+		std::cerr << "[ Link ERR ]: No frames at " << this->m_port.getBaudRate() << " baud, falling back" << std::endl;
+		this->fallBack(now);
+		return false;
+	}
+
+	if (now - this->m_lastPing >= LINK_PING_INTERVAL)
+	{
+		if (errorCount - this->m_lastErrorCount > LINK_MAX_ERRORS_PER_PING)
+		{
+			std::cerr << "[ Link ERR ]: Too many errors at " << this->m_port.getBaudRate() << " baud, stepping down"
+					  << std::endl;
+			// Never go back to this rate or anything faster
+			for (size_t i = 0; i < this->m_baudRateCount; i++)
+			{
+				if (this->m_baudRates[i] == this->m_port.getBaudRate())
+					this->m_firstBaudRate = i + 1;
+			}
+			this->fallBack(now);
+			return false;
+		}
+
+		this->sendPacket(PACKET_CMD_PING);
+		this->m_lastPing = now;
+		this->m_lastErrorCount = errorCount;
+	}
+	return false;
+}
+
+/**
+ * @brief Asks the device to switch to the current candidate rate, settles at the default rate if none is left
+ *
+ * @return true if the negotiation finished
+ */
+bool DeviceLink::request(ULONGLONG now, uint64_t errorCount)
+{
+	if (this->m_candidate >= this->m_baudRateCount)
+		return this->settle(now, errorCount);
+
+	uint32_t baud = static_cast<uint32_t>(this->m_baudRates[this->m_candidate]);
+	std::cout << "[ Link INFO ]: Trying " << baud << " baud" << std::endl;
+
+	uint8_t payload[4];
+	memcpy(payload, &baud, sizeof(baud));
+	this->sendPacket(PACKET_CMD_BAUD, payload, sizeof(payload));
+	this->m_phase = Phase::Requesting;
+	this->m_deadline = now + LINK_REQUEST_TIMEOUT;
+	return false;
+}
+
+/**
+ * @brief Sends one PACKET_CMD_BAUD_CONFIRM at the candidate rate
+ */
+void DeviceLink::confirm(ULONGLONG now)
+{
+	this->sendPacket(PACKET_CMD_BAUD_CONFIRM);
+	this->m_attempts++;
+	this->m_phase = Phase::Confirming;
+	this->m_deadline = now + LINK_CONFIRM_INTERVAL;
+}
+
+/**
+ * @brief The device switched but did not hear the confirmation, waits at the default rate until it falls back
+ */
+void DeviceLink::recover(ULONGLONG now)
+{
+	this->m_port.setBaudRate(LINK_DEFAULT_BAUD);
+	this->m_phase = Phase::Recovering;
+	this->m_deadline = now + LINK_CONFIRM_TIMEOUT + 200;
+}
+
+/**
+ * @brief Stops pinging so the device watchdog brings it back to the default rate, then renegotiates
+ */
+void DeviceLink::fallBack(ULONGLONG now)
+{
+	this->m_fallbacks++;
+	this->m_phase = Phase::FallingBack;
+	this->m_deadline = now + LINK_WATCHDOG_TIMEOUT;
+}
+
+/**
+ * @brief Ends the negotiation at the current rate of the port
+ *
+ * @return true
+ */
+bool DeviceLink::settle(ULONGLONG now, uint64_t errorCount)
+{
+	this->m_phase = Phase::Running;
+	this->m_lastFrame = now;
+	this->m_lastPing = now;
+	this->m_lastErrorCount = errorCount;
+	std::cout << "[ Link OK ]: Running at " << this->m_port.getBaudRate() << " baud (device: "
+			  << this->m_deviceStatus.effectiveBaud << " effective)" << std::endl;
+	return true;
+}
+
+/**
+ * @brief Decodes the payload of a PACKET_LINK_STATUS
+ *
+ * @details The UART drop counters at the end of the payload are optional (older firmware does not send them).
+ *
+ * @return false if the payload is too short
+ */
+bool DeviceLink::parseLinkStatus(const uint8_t* payload, size_t payloadSize, LinkStatus* status)
+{
+	if (payloadSize < 13)
+		return false;
+
+	status->state = payload[0];
+	memcpy(&status->requestedBaud, payload + 1, 4);
+	memcpy(&status->effectiveBaud, payload + 5, 4);
+	memcpy(&status->rxErrors, payload + 9, 2);
+	memcpy(&status->fallbacks, payload + 11, 2);
+
+	status->txDropped = 0;
+	status->rxOverruns = 0;
+	status->rxFrameErrors = 0;
+	if (payloadSize >= 19)
+	{
+		memcpy(&status->txDropped, payload + 13, 2);
+		memcpy(&status->rxOverruns, payload + 15, 2);
+		memcpy(&status->rxFrameErrors, payload + 17, 2);
+	}
+	return true;
+}
+
+/**
+ * @brief Decodes the payload of a PACKET_STATS
+ *
+ * @return false if the payload is too short
+ */
+bool DeviceLink::parseStats(const uint8_t* payload, size_t payloadSize, DeviceStats* stats)
+{
+	if (payloadSize < 21)
+		return false;
+
+	memcpy(&stats->interval, payload, 4);
+	stats->flags = payload[4];
+	memcpy(&stats->samples, payload + 5, 4);
+	memcpy(&stats->uptime, payload + 9, 4);
+	memcpy(&stats->rxErrors, payload + 13, 2);
+	memcpy(&stats->txDropped, payload + 15, 2);
+	memcpy(&stats->rxOverruns, payload + 17, 2);
+	memcpy(&stats->rxFrameErrors, payload + 19, 2);
+
+	stats->samplesSent = stats->samples;
+	if (payloadSize >= 25)
+		memcpy(&stats->samplesSent, payload + 21, 4);
+	return true;
+}
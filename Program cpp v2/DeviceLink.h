@@ -0,0 +1,104 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "SerialHandler.h"
+#include "Protocol.h"
+
+#define LINK_PING_INTERVAL 1000		 // [ms] Keep alive period at a negotiated baud rate
+#define LINK_MAX_ERRORS_PER_PING 10	 // Line / check sum errors tolerated between two pings before stepping down
+#define LINK_REQUEST_TIMEOUT 500	 // [ms] Wait for the LINK_STATUS answer to PACKET_CMD_BAUD
+#define LINK_SWITCH_DELAY 20		 // [ms] Time the device needs to restart its UART at the new rate
+#define LINK_CONFIRM_INTERVAL 150	 // [ms] Between two PACKET_CMD_BAUD_CONFIRM
+#define LINK_CONFIRM_ATTEMPTS 5
+
+typedef struct
+{
+	uint8_t state;			// LINK_STATE_*
+	uint32_t requestedBaud; // Last baud rate the host asked for
+	uint32_t effectiveBaud; // Calculated from the AVR baud rate divider
+	uint16_t rxErrors;		// Broken packets received by the device
+	uint16_t fallbacks;		// Times the device went back to the default baud rate
+	uint16_t txDropped;		// Frames the device dropped because its TX ring was full
+	uint16_t rxOverruns;	// Bytes the device lost in its UART or RX ring
+	uint16_t rxFrameErrors; // Bytes the device received with a framing error
+} LinkStatus;
+
+typedef struct
+{
+	uint32_t interval;		// [ms] Sample interval
+	uint8_t flags;			// STATS_FLAG_*
+	uint32_t samples;		// Samples taken since reset
+	uint32_t uptime;		// [ms] Device millis()
+	uint16_t rxErrors;		// Broken packets received by the device
+	uint16_t txDropped;		// Frames the device dropped because its TX ring was full
+	uint16_t rxOverruns;	// Bytes the device lost in its UART or RX ring
+	uint16_t rxFrameErrors; // Bytes the device received with a framing error
+	uint32_t samplesSent;	// Samples actually sent (less than samples in report on change mode)
+} DeviceStats;
+
+class DeviceLink
+{
+public:
+	DeviceLink(SerialHandler& port);
+
+	bool sendPacket(uint8_t type, const uint8_t* payload = nullptr, uint8_t payloadSize = 0);
+
+	bool setInterval(uint32_t interval);
+	bool pause();
+	bool resume();
+	bool requestStats();
+	bool setCompression(bool enabled);
+	bool setDeadband(float distance, uint16_t photo, uint32_t heartbeat);
+	bool captureBurst(uint16_t rate);
+	bool requestBacklog();
+
+	void negotiate(const unsigned long* baudRates, size_t count);
+	bool service(uint64_t errorCount);
+	bool isNegotiating() const;
+
+	void onFrame();
+	void onPacket(uint8_t type, const uint8_t* payload, size_t payloadSize);
+
+	const LinkStatus& getDeviceStatus();
+	const DeviceStats& getDeviceStats();
+	unsigned long getFallbacks();
+
+private:
+	// Steps of the baud rate negotiation, service() moves from one to the next by timestamps and LINK_STATUS replies
+	enum class Phase
+	{
+		Running,	// Link up, pinged at a negotiated rate
+		Starting,	// Negotiation asked for, the first PACKET_CMD_BAUD goes out on the next service()
+		Requesting, // PACKET_CMD_BAUD sent at the default rate, waiting for the device to accept
+		Switching,	// Accepted, waiting for the device UART to restart
+		Confirming, // Host at the new rate, PACKET_CMD_BAUD_CONFIRM sent
+		Recovering, // Not confirmed, waiting for the device to fall back to the default rate
+		FallingBack // Link lost at a negotiated rate, waiting for the device watchdog
+	};
+
+	bool watch(ULONGLONG now, uint64_t errorCount);
+	bool request(ULONGLONG now, uint64_t errorCount);
+	void confirm(ULONGLONG now);
+	void recover(ULONGLONG now);
+	void fallBack(ULONGLONG now);
+	bool settle(ULONGLONG now, uint64_t errorCount);
+	static bool parseLinkStatus(const uint8_t* payload, size_t payloadSize, LinkStatus* status);
+	static bool parseStats(const uint8_t* payload, size_t payloadSize, DeviceStats* stats);
+
+	SerialHandler& m_port;
+	const unsigned long* m_baudRates = nullptr;
+	size_t m_baudRateCount = 0;
+	size_t m_firstBaudRate = 0;
+	LinkStatus m_deviceStatus = {};
+	DeviceStats m_deviceStats = {};
+	unsigned long m_fallbacks = 0;
+	uint64_t m_lastErrorCount = 0;
+	ULONGLONG m_lastFrame = 0;
+	ULONGLONG m_lastPing = 0;
+
+	Phase m_phase = Phase::Running;
+	size_t m_candidate = 0;		   // Index of the baud rate being negotiated
+	int m_attempts = 0;			   // PACKET_CMD_BAUD_CONFIRM sent at the candidate rate
+	ULONGLONG m_deadline = 0;	   // End of the current phase
+	bool m_statusReceived = false; // A LINK_STATUS arrived since the last service()
+};
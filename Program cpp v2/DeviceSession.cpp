@@ -0,0 +1,206 @@
+#include "DeviceSession.h"
+#include <string.h>
+
+/**
+ * @brief Construct a new device session object
+ *
+ * @param history Receives the values, kept by the caller
+ * @param sender Sends the replay and time requests to the device
+ */
+DeviceSession::DeviceSession(History& history, PacketSender sender) : m_history(history), m_sender(sender)
+{
+}
+
+/**
+ * @brief Sets the receiver of every new value, e.g. the publisher of the ingest daemon
+ */
+void DeviceSession::setSampleSink(SampleSink sink)
+{
+	this->m_sink = sink;
+}
+
+/**
+ * @brief Decodes the payload of a PACKET_SAMPLE
+ *
+ * @return false if the payload is too short
+ */
+bool DeviceSession::parseSample(const uint8_t* payload, size_t payloadSize, Sample* sample)
+{
+	if (payloadSize < SAMPLE_PAYLOAD_SIZE)
+		return false;
+
+	uint16_t hundredths, photo;
+	memcpy(&sample->sequence, payload, 2);
+	memcpy(&sample->time, payload + 2, 4);
+	memcpy(&hundredths, payload + 6, 2);
+	memcpy(&photo, payload + 8, 2);
+	sample->sonic = hundredths * 0.01f;
+	sample->photo = photo;
+	return true;
+}
+
+/**
+ * @brief Appends the value of a Message frame at its arrival time, it has no sequence number or timestamp.
+ *
+ * @param arrival [s] Host time
+ * @param sonic [cm]
+ * @param photo [ADC]
+ */
+void DeviceSession::addMessage(double arrival, float sonic, float photo)
+{
+	this->m_history.add(arrival, sonic, photo);
+	if (this->m_sink)
+		this->m_sink(0, arrival, sonic, photo);
+}
+
+/**
+ * @brief Accounts a live sample and appends it to the history at the host time the device took it.
+ *
+ * @details A gap in the sequence numbers (and the first sample, for what the device stored before the host
+ * connected) asks the device to replay the missing samples from its backlog. A step back in the sequence or in
+ * the device time means the device reset (see SequenceTracker::push()), the clock mapping starts over.
+ *
+ * @param sample Decoded PACKET_SAMPLE or stream sample
+ * @param arrival [s] Host time the sample arrived at
+ *
+ * @return true if the device reset
+ */
+bool DeviceSession::addSample(const Sample& sample, double arrival)
+{
+	bool first = this->m_sequence.received() == 0;
+	uint64_t gaps = this->m_sequence.gaps();
+	uint64_t restarts = this->m_sequence.restarts();
+	this->m_sequence.push(sample.sequence, sample.time);
+
+	bool restarted = this->m_sequence.restarts() != restarts;
+	if (restarted)
+		this->m_clock.reset();
+	if (this->m_sequence.hasMissing() && (first || restarted || this->m_sequence.gaps() != gaps))
+	{
+		uint16_t from = this->m_sequence.firstMissing();
+		uint8_t payload[2];
+		memcpy(payload, &from, 2);
+		this->m_sender(PACKET_CMD_REPLAY, payload, sizeof(payload));
+	}
+
+	double time = this->m_clock.update(sample.time, arrival);
+	if (this->m_history.size() > 0 && time < this->m_history.at(this->m_history.size() - 1).time)
+		time = this->m_history.at(this->m_history.size() - 1).time;
+	this->m_history.add(time, sample.sonic, static_cast<float>(sample.photo));
+	if (this->m_sink)
+		this->m_sink(sample.sequence, time, sample.sonic, static_cast<float>(sample.photo));
+	return restarted;
+}
+
+/**
+ * @brief Puts the missing samples of a PACKET_BACKLOG chunk into the history at the time they were taken.
+ *
+ * @note Records the host already has (live or from an earlier replay) are skipped.
+ *
+ * @param payload
+ * @param payloadSize
+ * @param arrival [s] Host time the chunk arrived at
+ *
+ * @return Number of samples recovered
+ */
+size_t DeviceSession::handleBacklog(const uint8_t* payload, size_t payloadSize, double arrival)
+{
+	if (payloadSize < BACKLOG_CHUNK_HEADER)
+		return 0;
+
+	uint32_t deviceNow, sequence;
+	memcpy(&deviceNow, payload, 4);
+	memcpy(&sequence, payload + 4, 4);
+	size_t count = (payloadSize - BACKLOG_CHUNK_HEADER) / BACKLOG_RECORD_SIZE;
+
+	size_t recovered = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		if (!this->m_sequence.recover(static_cast<uint16_t>(sequence + i)))
+			continue;
+
+		const uint8_t* record = payload + BACKLOG_CHUNK_HEADER + i * BACKLOG_RECORD_SIZE;
+		uint32_t time;
+		uint16_t hundredths, photo;
+		memcpy(&time, record, 4);
+		memcpy(&hundredths, record + 4, 2);
+		memcpy(&photo, record + 6, 2);
+
+		double hostTime = this->m_clock.isSynced() ? this->m_clock.toHost(time) : arrival - static_cast<uint32_t>(deviceNow - time) / 1e6;
+		this->m_history.insert(hostTime, hundredths * 0.01f, static_cast<float>(photo));
+		if (this->m_sink)
+			this->m_sink(static_cast<uint16_t>(sequence + i), hostTime, hundredths * 0.01f, static_cast<float>(photo));
+		recovered++;
+	}
+	return recovered;
+}
+
+/**
+ * @brief Completes a time exchange started by requestTime(), the device time of the reply lies between the send
+ * and the arrival time.
+ *
+ * @note Replies to exchanges that were overwritten since (more than CLOCK_EXCHANGES in flight) are ignored.
+ *
+ * @param payload
+ * @param payloadSize
+ * @param received [s] Host time the reply arrived at
+ * @param exchange Out, may be nullptr
+ *
+ * @return true if the exchange went into the clock mapping
+ */
+bool DeviceSession::handleTime(const uint8_t* payload, size_t payloadSize, double received, TimeExchange* exchange)
+{
+	if (payloadSize < TIME_PAYLOAD_SIZE || !this->m_clock.isSynced())
+		return false;
+
+	uint32_t tag, deviceTime;
+	memcpy(&tag, payload, 4);
+	memcpy(&deviceTime, payload + 4, 4);
+	if (this->m_timeTag - tag > CLOCK_EXCHANGES || tag == this->m_timeTag)
+		return false;
+
+	double sent = this->m_timeSent[tag % CLOCK_EXCHANGES];
+	this->m_clock.addExchange(deviceTime, sent, received);
+	if (exchange != nullptr)
+		*exchange = {deviceTime, sent, received};
+	return true;
+}
+
+/**
+ * @brief Starts a time exchange, the device answers with its micros() in PACKET_TIME, matched by the tag.
+ *
+ * @param now [s] Host time
+ */
+bool DeviceSession::requestTime(double now)
+{
+	this->m_timeRequested = now;
+	this->m_timeSent[this->m_timeTag % CLOCK_EXCHANGES] = now;
+	uint8_t payload[4];
+	memcpy(payload, &this->m_timeTag, 4);
+	this->m_timeTag++;
+	return this->m_sender(PACKET_CMD_TIME, payload, sizeof(payload));
+}
+
+/**
+ * @brief Loss accounting of the sample sequence numbers
+ */
+const SequenceTracker& DeviceSession::sequence() const
+{
+	return this->m_sequence;
+}
+
+/**
+ * @brief Device to host clock mapping
+ */
+const DeviceClock& DeviceSession::clock() const
+{
+	return this->m_clock;
+}
+
+/**
+ * @brief Host time of the last time exchange [s]
+ */
+double DeviceSession::timeRequested() const
+{
+	return this->m_timeRequested;
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <functional>
+#include "Protocol.h"
+#include "History.h"
+#include "SequenceTracker.h"
+#include "DeviceClock.h"
+
+// Sends one command packet to the device (framed by FrameParser::encode)
+typedef std::function<bool(uint8_t type, const uint8_t* payload, uint8_t payloadSize)> PacketSender;
+
+// Receives every value put into the history: sequence number (0 for Message frames), host time [s]
+typedef std::function<void(uint16_t sequence, double time, float sonic, float photo)> SampleSink;
+
+typedef struct
+{
+	uint32_t deviceTime; // [us] micros() of the device when it answered
+	double sent;		 // [s] Host time of the request
+	double received;	 // [s] Host time of the reply
+} TimeExchange;
+
+// Host side of the sample protocol, shared by the viewer and the ingest daemon: puts the values of Message
+// frames, PACKET_SAMPLE, stream samples and PACKET_BACKLOG into a history on the host time base, accounts the
+// sequence numbers, asks the device for its backlog on gaps and runs the time exchanges of the clock mapping.
+class DeviceSession
+{
+public:
+	DeviceSession(History& history, PacketSender sender);
+
+	void setSampleSink(SampleSink sink);
+
+	static bool parseSample(const uint8_t* payload, size_t payloadSize, Sample* sample);
+	void addMessage(double arrival, float sonic, float photo);
+	bool addSample(const Sample& sample, double arrival);
+	size_t handleBacklog(const uint8_t* payload, size_t payloadSize, double arrival);
+	bool handleTime(const uint8_t* payload, size_t payloadSize, double received, TimeExchange* exchange = nullptr);
+	bool requestTime(double now);
+
+	const SequenceTracker& sequence() const;
+	const DeviceClock& clock() const;
+	double timeRequested() const;
+
+private:
+	History& m_history;
+	PacketSender m_sender;
+	SampleSink m_sink;
+	SequenceTracker m_sequence{BACKLOG_SAMPLES};
+	DeviceClock m_clock;
+
+	uint32_t m_timeTag = 0;					 // Tag of the next time exchange
+	double m_timeSent[CLOCK_EXCHANGES] = {}; // [s] Send time of the last exchanges, indexed by tag % CLOCK_EXCHANGES
+	double m_timeRequested = 0.0;			 // [s] Time of the last time exchange
+};
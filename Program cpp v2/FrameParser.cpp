@@ -0,0 +1,207 @@
+#include "FrameParser.h"
+#include <string.h>
+
+/**
+ * @brief Construct a new frame parser object
+ *
+ */
+FrameParser::FrameParser()
+{
+	this->reset();
+}
+
+/**
+ * @brief Feeds one received byte into the parser.
+ *
+ * @details Both the fixed size Message frame (0x55) and the variable length Packet (0x56) are recognised.
+ * Bytes in front of a start byte are skipped, a frame with a bad check sum or end byte is dropped and the
+ * parser resynchronises on the next start byte inside the dropped bytes.
+ *
+ * @param byte The received byte
+ *
+ * @return FrameType::Message - frame() holds a complete, valid Message
+ * @return FrameType::Packet - packetType() and payload() describe a complete, valid Packet
+ * @return FrameType::Pending - No complete frame yet
+ */
+FrameType FrameParser::push(uint8_t byte)
+{
+	switch (this->m_state)
+	{
+	case State::Start:
+		this->m_size = 0;
+		if (byte == MESSAGE_START)
+		{
+			this->m_buffer[this->m_size++] = byte;
+			this->m_expected = sizeof(Message);
+			this->m_state = State::Message;
+		}
+		else if (byte == PACKET_START)
+		{
+			this->m_buffer[this->m_size++] = byte;
+			this->m_state = State::PacketType;
+		}
+		else
+		{
+			this->m_stats.resyncs++;
+		}
+		return FrameType::Pending;
+
+	case State::Message:
+		this->m_buffer[this->m_size++] = byte;
+		if (this->m_size < this->m_expected)
+			return FrameType::Pending;
+		return this->complete();
+
+	case State::PacketType:
+		this->m_buffer[this->m_size++] = byte;
+		this->m_state = State::PacketLength;
+		return FrameType::Pending;
+
+	case State::PacketLength:
+		this->m_buffer[this->m_size++] = byte;
+		this->m_expected = PACKET_HEADER_SIZE + byte + PACKET_TRAILER_SIZE;
+		this->m_state = State::PacketBody;
+		return FrameType::Pending;
+
+	case State::PacketBody:
+		this->m_buffer[this->m_size++] = byte;
+		if (this->m_size < this->m_expected)
+			return FrameType::Pending;
+		return this->complete();
+	}
+	return FrameType::Pending;
+}
+
+/**
+ * @brief Drops any partially received frame
+ */
+void FrameParser::reset()
+{
+	this->m_state = State::Start;
+	this->m_size = 0;
+	this->m_expected = 0;
+}
+
+/**
+ * @brief Raw bytes of the last complete frame
+ */
+const uint8_t* FrameParser::frame() const
+{
+	return this->m_buffer;
+}
+
+/**
+ * @brief Size of the last complete frame
+ */
+size_t FrameParser::frameSize() const
+{
+	return this->m_size;
+}
+
+/**
+ * @brief Type byte of the last complete Packet
+ */
+uint8_t FrameParser::packetType() const
+{
+	return this->m_buffer[1];
+}
+
+/**
+ * @brief Payload of the last complete Packet
+ */
+const uint8_t* FrameParser::payload() const
+{
+	return this->m_buffer + PACKET_HEADER_SIZE;
+}
+
+/**
+ * @brief Payload size of the last complete Packet
+ */
+size_t FrameParser::payloadSize() const
+{
+	return this->m_buffer[2];
+}
+
+/**
+ * @brief Frame, error and resync counters
+ */
+const ParserStats& FrameParser::stats() const
+{
+	return this->m_stats;
+}
+
+/**
+ * @brief Frames a packet for the device, the inverse of push()
+ *
+ * @param type PACKET_CMD_*
+ * @param payload Payload bytes, may be nullptr if payloadSize is 0
+ * @param payloadSize
+ * @param packet Out, PACKET_MAX_SIZE bytes
+ *
+ * @return Size of the framed packet
+ */
+size_t FrameParser::encode(uint8_t type, const uint8_t* payload, uint8_t payloadSize, uint8_t* packet)
+{
+	size_t size = 0;
+	packet[size++] = PACKET_START;
+	packet[size++] = type;
+	packet[size++] = payloadSize;
+	if (payloadSize > 0)
+	{
+		memcpy(packet + size, payload, payloadSize);
+		size += payloadSize;
+	}
+
+	uint8_t checkSum = 0;
+	for (size_t i = 0; i < size; i++)
+		checkSum ^= packet[i];
+	packet[size++] = checkSum;
+	packet[size++] = PACKET_END;
+	return size;
+}
+
+//==================================================================================================
+/**
+ * @brief Validates the check sum and end byte of a fully received frame.
+ */
+FrameType FrameParser::complete()
+{
+	FrameType type = (this->m_state == State::Message) ? FrameType::Message : FrameType::Packet;
+
+	// Same rule for both frames: XOR of every byte before the check sum
+	uint8_t checkSum = 0;
+	for (size_t i = 0; i < this->m_size - 2; i++)
+	{
+		checkSum ^= this->m_buffer[i];
+	}
+
+	if (checkSum != this->m_buffer[this->m_size - 2] || this->m_buffer[this->m_size - 1] != MESSAGE_END)
+	{
+		this->m_stats.checksumErrors++;
+		this->resync();
+		return FrameType::Pending;
+	}
+
+	this->m_stats.frames++;
+	this->m_state = State::Start;
+	return type;
+}
+
+/**
+ * @brief Drops the start byte of a broken frame and re-parses the bytes after it.
+ *
+ * @note A complete frame hidden inside the dropped bytes is not recovered, the parser only
+ * needs to be in sync again for the next one.
+ */
+void FrameParser::resync()
+{
+	uint8_t pending[PACKET_MAX_SIZE];
+	size_t pendingSize = this->m_size - 1;
+	memcpy(pending, this->m_buffer + 1, pendingSize);
+
+	this->reset();
+	for (size_t i = 0; i < pendingSize; i++)
+	{
+		this->push(pending[i]);
+	}
+}
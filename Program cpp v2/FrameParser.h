@@ -0,0 +1,57 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "Protocol.h"
+
+enum class FrameType
+{
+	Pending,
+	Message,
+	Packet
+};
+
+typedef struct
+{
+	uint64_t frames;		 // Valid frames
+	uint64_t checksumErrors; // Frames dropped because of a bad check sum or end byte
+	uint64_t resyncs;		 // Bytes skipped while looking for a start byte
+} ParserStats;
+
+class FrameParser
+{
+public:
+	FrameParser();
+
+	FrameType push(uint8_t byte);
+	void reset();
+
+	const uint8_t* frame() const;
+	size_t frameSize() const;
+
+	uint8_t packetType() const;
+	const uint8_t* payload() const;
+	size_t payloadSize() const;
+
+	const ParserStats& stats() const;
+
+	static size_t encode(uint8_t type, const uint8_t* payload, uint8_t payloadSize, uint8_t* packet);
+
+private:
+	FrameType complete();
+	void resync();
+
+	enum class State
+	{
+		Start,
+		Message,
+		PacketType,
+		PacketLength,
+		PacketBody
+	};
+
+	State m_state = State::Start;
+	uint8_t m_buffer[PACKET_MAX_SIZE];
+	size_t m_size = 0;
+	size_t m_expected = 0;
+	ParserStats m_stats = {};
+};
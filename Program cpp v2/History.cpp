@@ -0,0 +1,118 @@
+#include "History.h"
+
+/**
+ * @brief Construct a new history object
+ *
+ * @param capacity The oldest point is dropped when more points are added
+ */
+History::History(size_t capacity) : m_points(capacity > 0 ? capacity : 1)
+{
+}
+
+/**
+ * @brief Appends a value that is valid from the given time until the next point.
+ *
+ * @param time [s] Must not be older than the last point
+ * @param sonic
+ * @param photo
+ */
+void History::add(double time, float sonic, float photo)
+{
+	size_t capacity = this->m_points.size();
+	size_t index = (this->m_head + this->m_size) % capacity;
+
+	this->m_points[index] = { time, sonic, photo };
+	if (this->m_size < capacity)
+		this->m_size++;
+	else
+		this->m_head = (this->m_head + 1) % capacity;
+}
+
+/**
+ * @brief Adds a value that is older than the last point, used for samples replayed by the device.
+ *
+ * @details Newer points move up by one. If the history is full the oldest point is dropped, or the
+ * new one if it would be the oldest.
+ *
+ * @param time [s]
+ * @param sonic
+ * @param photo
+ */
+void History::insert(double time, float sonic, float photo)
+{
+	if (this->m_size == 0 || time >= this->at(this->m_size - 1).time)
+	{
+		this->add(time, sonic, photo);
+		return;
+	}
+
+	size_t capacity = this->m_points.size();
+	if (this->m_size == capacity)
+	{
+		if (time < this->at(0).time)
+			return;
+		this->m_head = (this->m_head + 1) % capacity;
+		this->m_size--;
+	}
+
+	// Index of the first point newer than time
+	size_t position = this->find(time);
+	if (this->at(position).time <= time)
+		position++;
+
+	for (size_t i = this->m_size; i > position; i--)
+		this->m_points[(this->m_head + i) % capacity] = this->at(i - 1);
+	this->m_points[(this->m_head + position) % capacity] = { time, sonic, photo };
+	this->m_size++;
+}
+
+/**
+ * @brief Drops every point
+ */
+void History::clear()
+{
+	this->m_head = 0;
+	this->m_size = 0;
+}
+
+/**
+ * @brief Number of stored points
+ */
+size_t History::size() const
+{
+	return this->m_size;
+}
+
+/**
+ * @brief Returns a stored point
+ *
+ * @param index 0 is the oldest point, size() - 1 the newest
+ */
+const HistoryPoint& History::at(size_t index) const
+{
+	return this->m_points[(this->m_head + index) % this->m_points.size()];
+}
+
+/**
+ * @brief Finds the point that holds the value at the given time.
+ *
+ * @param time [s]
+ *
+ * @return Index of the last point not newer than time, 0 if every point is newer
+ */
+size_t History::find(double time) const
+{
+	size_t low = 0;
+	size_t high = this->m_size;
+
+	// Binary search for the first point newer than time
+	while (low < high)
+	{
+		size_t middle = low + (high - low) / 2;
+		if (this->at(middle).time <= time)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	return low > 0 ? low - 1 : 0;
+}
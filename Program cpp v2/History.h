@@ -0,0 +1,33 @@
+#pragma once
+#include <stddef.h>
+#include <vector>
+
+#define HISTORY_CAPACITY 100000 // Points kept per device
+
+typedef struct
+{
+	double time; // [s] Host time the value was valid from
+	float sonic; // [cm]
+	float photo; // ADC value
+} HistoryPoint;
+
+// Bounded, time ordered store of reported values.
+// A point is valid until the next one, so frames the device suppressed (report on change) cost nothing here.
+class History
+{
+public:
+	History(size_t capacity = HISTORY_CAPACITY);
+
+	void add(double time, float sonic, float photo);
+	void insert(double time, float sonic, float photo);
+	void clear();
+
+	size_t size() const;
+	const HistoryPoint& at(size_t index) const;
+	size_t find(double time) const;
+
+private:
+	std::vector<HistoryPoint> m_points;
+	size_t m_head = 0;
+	size_t m_size = 0;
+};
@@ -0,0 +1,163 @@
+#include "LatencyHistogram.h"
+#include <algorithm>
+#include <cmath>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+/**
+ * @brief Position of the highest set bit, value must not be 0
+ */
+static inline int highestBit(uint64_t value)
+{
+#ifdef _MSC_VER
+	unsigned long bit;
+	_BitScanReverse64(&bit, value);
+	return static_cast<int>(bit);
+#else
+	return 63 - __builtin_clzll(value);
+#endif
+}
+
+/**
+ * @brief Construct a new latency histogram object
+ *
+ * @param highestValue Largest value that can be told apart, larger ones are counted as this [ns]
+ * @param significantDigits Decimal digits kept of every value (1 - 5), 3 means 0.1% resolution
+ */
+LatencyHistogram::LatencyHistogram(int64_t highestValue, int significantDigits)
+{
+	// Smallest power of two sub bucket count that resolves the digits
+	int64_t largestSingleUnitResolution = 2 * static_cast<int64_t>(std::pow(10.0, significantDigits));
+	int subBucketCountMagnitude = static_cast<int>(std::ceil(std::log2(static_cast<double>(largestSingleUnitResolution))));
+	this->m_subBucketHalfCountMagnitude = subBucketCountMagnitude - 1;
+	this->m_subBucketHalfCount = int64_t(1) << this->m_subBucketHalfCountMagnitude;
+	this->m_subBucketMask = (int64_t(1) << subBucketCountMagnitude) - 1;
+	this->m_highestValue = highestValue;
+
+	// Every bucket doubles the range of the previous one
+	int bucketCount = 1;
+	for (int64_t smallestUntrackable = int64_t(1) << subBucketCountMagnitude; smallestUntrackable <= highestValue; smallestUntrackable <<= 1)
+		bucketCount++;
+	this->m_counts.assign(static_cast<size_t>((bucketCount + 1) * this->m_subBucketHalfCount), 0);
+}
+
+/**
+ * @brief Counts one value
+ *
+ * @param value [ns] Negative values count as 0
+ */
+void LatencyHistogram::record(int64_t value)
+{
+	if (value < 0)
+		value = 0;
+	if (value > this->m_highestValue)
+		value = this->m_highestValue;
+
+	this->m_counts[this->index(value)]++;
+	this->m_count++;
+	this->m_sum += static_cast<double>(value);
+	if (value < this->m_min)
+		this->m_min = value;
+	if (value > this->m_max)
+		this->m_max = value;
+}
+
+/**
+ * @brief Forgets every value
+ */
+void LatencyHistogram::reset()
+{
+	std::fill(this->m_counts.begin(), this->m_counts.end(), 0);
+	this->m_count = 0;
+	this->m_min = INT64_MAX;
+	this->m_max = 0;
+	this->m_sum = 0.0;
+}
+
+/**
+ * @brief Number of recorded values
+ */
+uint64_t LatencyHistogram::count() const
+{
+	return this->m_count;
+}
+
+/**
+ * @brief Smallest recorded value, 0 if empty
+ */
+int64_t LatencyHistogram::min() const
+{
+	return this->m_count > 0 ? this->m_min : 0;
+}
+
+/**
+ * @brief Largest recorded value
+ */
+int64_t LatencyHistogram::max() const
+{
+	return this->m_max;
+}
+
+/**
+ * @brief Exact mean of the recorded values
+ */
+double LatencyHistogram::mean() const
+{
+	return this->m_count > 0 ? this->m_sum / this->m_count : 0.0;
+}
+
+/**
+ * @brief Value at or below which the given share of the values are.
+ *
+ * @param percent 0 - 100, e.g. 99.9
+ *
+ * @return The highest value of the bucket holding the percentile (never above max()), 0 if empty
+ */
+int64_t LatencyHistogram::percentile(double percent) const
+{
+	if (this->m_count == 0)
+		return 0;
+
+	uint64_t target = static_cast<uint64_t>(std::ceil(percent / 100.0 * this->m_count));
+	if (target < 1)
+		target = 1;
+
+	uint64_t seen = 0;
+	for (size_t i = 0; i < this->m_counts.size(); i++)
+	{
+		seen += this->m_counts[i];
+		if (seen >= target)
+		{
+			int64_t value = this->highestEquivalent(i);
+			return value < this->m_max ? value : this->m_max;
+		}
+	}
+	return this->m_max;
+}
+
+//==================================================================================================
+/**
+ * @brief Counts index of a value: the bucket is given by the highest bit, the sub bucket by the bits below it
+ */
+size_t LatencyHistogram::index(int64_t value) const
+{
+	int bucket = highestBit(static_cast<uint64_t>(value | this->m_subBucketMask)) - this->m_subBucketHalfCountMagnitude;
+	int64_t subBucket = value >> bucket;
+	return static_cast<size_t>((int64_t(bucket) << this->m_subBucketHalfCountMagnitude) + subBucket);
+}
+
+/**
+ * @brief Largest value that lands in the given counts index
+ */
+int64_t LatencyHistogram::highestEquivalent(size_t index) const
+{
+	int bucket = static_cast<int>(index >> this->m_subBucketHalfCountMagnitude) - 1;
+	int64_t subBucket = static_cast<int64_t>(index & (this->m_subBucketHalfCount - 1)) + this->m_subBucketHalfCount;
+	if (bucket < 0)
+	{
+		subBucket -= this->m_subBucketHalfCount;
+		bucket = 0;
+	}
+	return ((subBucket + 1) << bucket) - 1;
+}
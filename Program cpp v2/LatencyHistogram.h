@@ -0,0 +1,37 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+// High dynamic range histogram of latencies (the HdrHistogram layout): values are counted in buckets whose width
+// grows with the value, so every recorded value keeps the given number of significant decimal digits from 1 ns up
+// to the highest trackable value. Recording is O(1) and never allocates, percentiles walk the counts.
+class LatencyHistogram
+{
+public:
+	LatencyHistogram(int64_t highestValue = 60000000000LL, int significantDigits = 3);
+
+	void record(int64_t value);
+	void reset();
+
+	uint64_t count() const;
+	int64_t min() const;
+	int64_t max() const;
+	double mean() const;
+	int64_t percentile(double percent) const;
+
+private:
+	size_t index(int64_t value) const;
+	int64_t highestEquivalent(size_t index) const;
+
+	int m_subBucketHalfCountMagnitude;
+	int64_t m_subBucketHalfCount;
+	int64_t m_subBucketMask;
+	int64_t m_highestValue;
+	std::vector<uint64_t> m_counts;
+
+	uint64_t m_count = 0;
+	int64_t m_min = INT64_MAX;
+	int64_t m_max = 0;
+	double m_sum = 0.0;
+};
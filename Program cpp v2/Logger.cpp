@@ -0,0 +1,187 @@
+#include "Logger.h"
+#include "Tracer.h"
+#include <chrono>
+#include <string.h>
+
+static const char* const levelNames[] = {"DEBUG", "INFO", "WARN", "ERR"};
+
+/**
+ * @brief Construct a new logger object and starts its writer thread
+ *
+ * @param file Output, stdout by default
+ * @param level Lines below this level are discarded at the call site
+ */
+Logger::Logger(FILE* file, LogLevel level) : m_file(file), m_level(level), m_records(new Record[LOG_QUEUE_SIZE])
+{
+	static_assert((LOG_QUEUE_SIZE & (LOG_QUEUE_SIZE - 1)) == 0, "LOG_QUEUE_SIZE must be a power of two");
+	for (size_t i = 0; i < LOG_QUEUE_SIZE; i++)
+		this->m_records[i].sequence.store(i, std::memory_order_relaxed);
+
+	this->m_writer = std::thread(&Logger::run, this);
+}
+
+/**
+ * @brief Writes everything still queued and stops the writer thread
+ */
+Logger::~Logger()
+{
+	this->m_running = false;
+	this->m_writer.join();
+}
+
+/**
+ * @brief Sets the lowest level that is written
+ */
+void Logger::setLevel(LogLevel level)
+{
+	this->m_level.store(level, std::memory_order_relaxed);
+}
+
+/**
+ * @brief true if lines of the level are written, use it to skip preparing arguments
+ */
+bool Logger::enabled(LogLevel level) const
+{
+	return level >= this->m_level.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Queues a hex dump ("0x55 0x00 ..."), it is formatted on the writer thread.
+ *
+ * @param level
+ * @param tag
+ * @param data
+ * @param size Longer dumps are cut at LOG_ARGS_SIZE bytes
+ */
+void Logger::hex(LogLevel level, const char* tag, const void* data, size_t size)
+{
+	Record* record = this->acquire(level, tag);
+	if (record == nullptr)
+		return;
+
+	record->formatter = &Logger::writeHex;
+	record->size = static_cast<uint8_t>(size < LOG_ARGS_SIZE ? size : LOG_ARGS_SIZE);
+	memcpy(record->args, data, record->size);
+	this->publish(record);
+}
+
+/**
+ * @brief Lines lost because the queue was full
+ */
+uint64_t Logger::dropped() const
+{
+	return this->m_dropped.load(std::memory_order_relaxed);
+}
+
+//==================================================================================================
+/**
+ * @brief Claims the next free record, safe from any thread.
+ *
+ * @return nullptr if the level is filtered or the queue is full
+ */
+Logger::Record* Logger::acquire(LogLevel level, const char* tag)
+{
+	if (!this->enabled(level))
+		return nullptr;
+
+	uint64_t position = this->m_enqueue.load(std::memory_order_relaxed);
+	while (true)
+	{
+		Record& record = this->m_records[position & (LOG_QUEUE_SIZE - 1)];
+		int64_t difference = static_cast<int64_t>(record.sequence.load(std::memory_order_acquire) - position);
+		if (difference == 0)
+		{
+			if (this->m_enqueue.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+			{
+				record.level = level;
+				record.tag = tag;
+				return &record;
+			}
+		}
+		else if (difference < 0)
+		{
+			// The writer is a whole queue behind
+			this->m_dropped.fetch_add(1, std::memory_order_relaxed);
+			return nullptr;
+		}
+		else
+		{
+			position = this->m_enqueue.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+/**
+ * @brief Hands a filled record to the writer
+ */
+void Logger::publish(Record* record)
+{
+	uint64_t position = record->sequence.load(std::memory_order_relaxed);
+	record->sequence.store(position + 1, std::memory_order_release);
+}
+
+/**
+ * @brief Writer thread: drains the queue, flushes once per batch and sleeps while it is empty
+ */
+void Logger::run()
+{
+	Tracer::setThreadName("logger");
+	while (this->m_running.load(std::memory_order_relaxed))
+	{
+		size_t count;
+		{
+			TRACE_SCOPE("log write");
+			count = this->drain();
+		}
+		if (count == 0)
+			std::this_thread::sleep_for(std::chrono::milliseconds(LOG_FLUSH_INTERVAL));
+	}
+	this->drain();
+}
+
+/**
+ * @brief Writes every published record
+ *
+ * @return Number of records written
+ */
+size_t Logger::drain()
+{
+	size_t count = 0;
+	while (true)
+	{
+		Record& record = this->m_records[this->m_dequeue & (LOG_QUEUE_SIZE - 1)];
+		if (record.sequence.load(std::memory_order_acquire) != this->m_dequeue + 1)
+			break;
+
+		fprintf(this->m_file, "[ %s %s ]: ", record.tag, levelNames[static_cast<int>(record.level)]);
+		record.formatter(this->m_file, record);
+		fputc('\n', this->m_file);
+
+		record.sequence.store(this->m_dequeue + LOG_QUEUE_SIZE, std::memory_order_release);
+		this->m_dequeue++;
+		count++;
+	}
+
+	if (count > 0)
+		fflush(this->m_file);
+	return count;
+}
+
+/**
+ * @brief Writes a queued hex dump, all bytes in one fwrite
+ */
+void Logger::writeHex(FILE* file, const Record& record)
+{
+	static const char digits[] = "0123456789abcdef";
+	char text[LOG_ARGS_SIZE * 5];
+	size_t size = 0;
+	for (size_t i = 0; i < record.size; i++)
+	{
+		text[size++] = '0';
+		text[size++] = 'x';
+		text[size++] = digits[record.args[i] >> 4];
+		text[size++] = digits[record.args[i] & 0x0F];
+		text[size++] = ' ';
+	}
+	fwrite(text, 1, size, file);
+}
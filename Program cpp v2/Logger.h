@@ -0,0 +1,113 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <atomic>
+#include <memory>
+#include <new>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+
+#define LOG_QUEUE_SIZE 1024	  // Records in flight, power of two
+#define LOG_ARGS_SIZE 96	  // Bytes of captured arguments (or hex dump) per record
+#define LOG_FLUSH_INTERVAL 20 // [ms] Writer wake up period when the queue is empty
+
+enum class LogLevel : uint8_t
+{
+	Debug,
+	Info,
+	Warn,
+	Error
+};
+
+// Asynchronous logger: the caller only copies the format string pointer and the raw arguments into a lock-free
+// queue, a background thread does the printf formatting and the hex dumps in batches and flushes once per batch.
+// Lines look like the rest of the console output: "[ Tag LEVEL ]: message".
+//
+// Arguments are captured by value, so strings must be literals (or otherwise outlive the write). If the queue is
+// full the record is dropped and counted, the caller never waits.
+class Logger
+{
+public:
+	Logger(FILE* file = stdout, LogLevel level = LogLevel::Info);
+	~Logger();
+
+	void setLevel(LogLevel level);
+	bool enabled(LogLevel level) const;
+
+	template <typename... Args>
+	void log(LogLevel level, const char* tag, const char* format, Args... args);
+	void hex(LogLevel level, const char* tag, const void* data, size_t size);
+
+	uint64_t dropped() const;
+
+private:
+	struct Record;
+	typedef void (*Formatter)(FILE* file, const Record& record);
+
+	struct Record
+	{
+		std::atomic<uint64_t> sequence; // Queue position the record is free / full for
+		Formatter formatter;
+		const char* tag;
+		const char* format;
+		LogLevel level;
+		uint8_t size; // Hex dump length
+		alignas(8) uint8_t args[LOG_ARGS_SIZE];
+	};
+
+	Record* acquire(LogLevel level, const char* tag);
+	void publish(Record* record);
+	void run();
+	size_t drain();
+
+	template <typename... Args>
+	static void writeFormat(FILE* file, const Record& record);
+	static void writeHex(FILE* file, const Record& record);
+
+	FILE* m_file;
+	std::atomic<LogLevel> m_level;
+	std::unique_ptr<Record[]> m_records;
+	std::atomic<uint64_t> m_enqueue{0};
+	uint64_t m_dequeue = 0; // Writer thread only
+	std::atomic<uint64_t> m_dropped{0};
+	std::atomic<bool> m_running{true};
+	std::thread m_writer;
+};
+
+/**
+ * @brief Queues a printf style line, the formatting happens on the writer thread.
+ *
+ * @param level
+ * @param tag Source of the line, e.g. "Device"
+ * @param format printf format, must be a literal
+ * @param args Trivially copyable values (numbers, literal strings)
+ */
+template <typename... Args>
+void Logger::log(LogLevel level, const char* tag, const char* format, Args... args)
+{
+	typedef std::tuple<Args...> Values;
+	static_assert(sizeof(Values) <= LOG_ARGS_SIZE, "Too many log arguments");
+	static_assert(alignof(Values) <= 8, "Log argument alignment");
+	static_assert(std::conjunction<std::is_trivially_copyable<Args>...>::value, "Log arguments are copied raw");
+
+	Record* record = this->acquire(level, tag);
+	if (record == nullptr)
+		return;
+
+	record->formatter = &Logger::writeFormat<Args...>;
+	record->format = format;
+	new (record->args) Values(args...);
+	this->publish(record);
+}
+
+/**
+ * @brief Writes one queued printf style line
+ */
+template <typename... Args>
+void Logger::writeFormat(FILE* file, const Record& record)
+{
+	const std::tuple<Args...>& values = *reinterpret_cast<const std::tuple<Args...>*>(record.args);
+	std::apply([&](const Args&... value) { fprintf(file, record.format, value...); }, values);
+}
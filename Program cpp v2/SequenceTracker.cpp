@@ -0,0 +1,203 @@
+#include "SequenceTracker.h"
+
+/**
+ * @brief Construct a new sequence tracker object
+ *
+ * @param depth Samples the device keeps in its backlog, older missing samples are given up
+ */
+SequenceTracker::SequenceTracker(size_t depth) : m_depth(depth)
+{
+}
+
+/**
+ * @brief Accounts one live sample.
+ *
+ * @details The first sample marks everything before it as missing (but not lost), so samples the device stored
+ * before the host connected can be recovered. A jump forward counts the skipped samples as lost, a step back
+ * means the device restarted and starts over.
+ *
+ * A reset at sequence 32768 or above unwraps as a jump forward, so the device time decides as well: a step back
+ * of micros() is a restart, and so is a jump forward over which both the sequence number and micros() wrapped
+ * (micros() wraps every 71.6 minutes, it may be more than 35.8 minutes ahead of the last sample). A gap longer
+ * than 35.8 minutes also counts as a restart, the device clock mapping can not bridge it either.
+ *
+ * @param sequence Sequence number of the sample
+ * @param time [us] Device micros() of the sample
+ *
+ * @return The unwrapped sequence number
+ */
+int64_t SequenceTracker::push(uint16_t sequence, uint32_t time)
+{
+	bool restarted = false;
+	if (this->m_started)
+	{
+		int64_t full = this->unwrap(sequence);
+		bool wrapped = sequence < static_cast<uint16_t>(this->m_next - 1) && time < this->m_lastTime;
+		restarted = full < this->m_next || static_cast<int32_t>(time - this->m_lastTime) < 0 || (full > this->m_next && wrapped);
+	}
+	this->m_lastTime = time;
+
+	if (restarted)
+	{
+		this->m_restarts++;
+		this->m_started = false;
+		this->m_missing.clear();
+	}
+
+	if (!this->m_started)
+	{
+		this->m_started = true;
+		this->m_next = sequence;
+		// Below 0 there is nothing to ask for, e.g. right after a device reset
+		int64_t begin = static_cast<int64_t>(sequence) - static_cast<int64_t>(this->m_depth);
+		if (begin < 0)
+			begin = 0;
+		if (begin < sequence)
+			this->m_missing.push_back({ begin, sequence });
+	}
+
+	int64_t full = this->unwrap(sequence);
+	if (full > this->m_next)
+	{
+		this->m_lost += full - this->m_next;
+		this->m_gaps++;
+		this->m_missing.push_back({ this->m_next, full });
+		if (this->m_missing.size() > SEQUENCE_MAX_RANGES)
+			this->m_missing.erase(this->m_missing.begin());
+	}
+
+	this->m_next = full + 1;
+	this->m_received++;
+	this->prune();
+	return full;
+}
+
+/**
+ * @brief Accounts a sample replayed from the device backlog.
+ *
+ * @param sequence Sequence number of the sample
+ *
+ * @return true if the sample was missing, false if it is already known
+ */
+bool SequenceTracker::recover(uint16_t sequence)
+{
+	if (!this->m_started)
+		return false;
+
+	int64_t full = this->unwrap(sequence);
+	for (size_t i = 0; i < this->m_missing.size(); i++)
+	{
+		Range& range = this->m_missing[i];
+		if (full < range.begin || full >= range.end)
+			continue;
+
+		// Split the range around the recovered sample
+		Range after = { full + 1, range.end };
+		range.end = full;
+		if (after.begin < after.end)
+			this->m_missing.insert(this->m_missing.begin() + i + 1, after);
+		if (this->m_missing[i].begin >= this->m_missing[i].end)
+			this->m_missing.erase(this->m_missing.begin() + i);
+
+		this->m_recovered++;
+		return true;
+	}
+	return false;
+}
+
+/**
+ * @brief Forgets the sequence, the next sample is taken as the first one (counters are kept)
+ */
+void SequenceTracker::reset()
+{
+	this->m_started = false;
+	this->m_missing.clear();
+}
+
+/**
+ * @brief true if samples are missing that the device backlog may still hold
+ */
+bool SequenceTracker::hasMissing() const
+{
+	return !this->m_missing.empty();
+}
+
+/**
+ * @brief Oldest missing sequence number still worth asking for, only valid if hasMissing()
+ */
+uint16_t SequenceTracker::firstMissing() const
+{
+	int64_t first = this->m_next;
+	for (const Range& range : this->m_missing)
+	{
+		if (range.begin < first)
+			first = range.begin;
+	}
+	int64_t oldest = this->m_next - static_cast<int64_t>(this->m_depth);
+	if (first < oldest)
+		first = oldest;
+	return static_cast<uint16_t>(first > 0 ? first : 0);
+}
+
+/**
+ * @brief Number of live samples
+ */
+uint64_t SequenceTracker::received() const
+{
+	return this->m_received;
+}
+
+/**
+ * @brief Samples skipped in the live stream
+ */
+uint64_t SequenceTracker::lost() const
+{
+	return this->m_lost;
+}
+
+/**
+ * @brief Number of jumps in the live stream
+ */
+uint64_t SequenceTracker::gaps() const
+{
+	return this->m_gaps;
+}
+
+/**
+ * @brief Missing samples received from the device backlog
+ */
+uint64_t SequenceTracker::recovered() const
+{
+	return this->m_recovered;
+}
+
+/**
+ * @brief Times the sequence started over
+ */
+uint64_t SequenceTracker::restarts() const
+{
+	return this->m_restarts;
+}
+
+/**
+ * @brief Extends a 16 bit sequence number to the one closest to the next expected sample
+ */
+int64_t SequenceTracker::unwrap(uint16_t sequence) const
+{
+	return this->m_next + static_cast<int16_t>(sequence - static_cast<uint16_t>(this->m_next));
+}
+
+/**
+ * @brief Drops the missing ranges the device backlog has already overwritten
+ */
+void SequenceTracker::prune()
+{
+	int64_t oldest = this->m_next - static_cast<int64_t>(this->m_depth);
+	for (size_t i = 0; i < this->m_missing.size();)
+	{
+		if (this->m_missing[i].end <= oldest)
+			this->m_missing.erase(this->m_missing.begin() + i);
+		else
+			i++;
+	}
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+#define SEQUENCE_MAX_RANGES 64 // Missing ranges remembered for recovery from the device backlog
+
+// Loss accounting on the wrapping 16 bit sequence number of the reported samples.
+// Live samples arrive in order, so a jump forward is a lost frame and a step back (of the sequence number or of the
+// device time) is a device restart.
+// Missing sequence numbers are remembered as long as the device backlog may still hold them.
+class SequenceTracker
+{
+public:
+	SequenceTracker(size_t depth);
+
+	int64_t push(uint16_t sequence, uint32_t time);
+	bool recover(uint16_t sequence);
+	void reset();
+
+	bool hasMissing() const;
+	uint16_t firstMissing() const;
+
+	uint64_t received() const;
+	uint64_t lost() const;
+	uint64_t gaps() const;
+	uint64_t recovered() const;
+	uint64_t restarts() const;
+
+private:
+	typedef struct
+	{
+		int64_t begin;
+		int64_t end; // Exclusive
+	} Range;
+
+	int64_t unwrap(uint16_t sequence) const;
+	void prune();
+
+	size_t m_depth;
+	bool m_started = false;
+	int64_t m_next = 0;		// Next expected sequence, unwrapped
+	uint32_t m_lastTime = 0; // [us] Device time of the newest sample
+	std::vector<Range> m_missing;
+
+	uint64_t m_received = 0;
+	uint64_t m_lost = 0;
+	uint64_t m_gaps = 0;
+	uint64_t m_recovered = 0;
+	uint64_t m_restarts = 0;
+};
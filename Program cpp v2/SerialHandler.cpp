@@ -27,12 +27,13 @@ SerialHandler::~SerialHandler()
  *
  * @details The function initializes the serial port connection with the given port, sets the parameters for the serial port, and sets the timeouts for the serial port.
  * PORT parameters:
- * - Baud rate: 9600
+ * - Baud rate: baudRate (9600 by default)
  * - Data bits: 8
  * - Stop bits: 1
  * - Parity: None
  *
  * @param portName
+ * @param baudRate
  *
  * @return	1 - Connection established
  * @return -1 - Serial port not available
@@ -41,9 +42,10 @@ SerialHandler::~SerialHandler()
  * @return -4 - Could not set serial port parameters
  * @return -5 - Could not set timeouts
  */
-int SerialHandler::begin(const char* portName)
+int SerialHandler::begin(const char* portName, unsigned long baudRate)
 {
 	this->m_portName = portName;
+	this->m_baudRate = baudRate;
 	this->m_connected = false;
 
 	this->m_serialHandler = CreateFileA(static_cast<LPCSTR>(this->m_portName), GENERIC_READ | GENERIC_WRITE, 0, 0, OPEN_EXISTING,
@@ -71,8 +73,8 @@ int SerialHandler::begin(const char* portName)
 		return -3;
 	}
 
-	// Setting up parameters: Baud 9600, 8 bits, 1 stop bit, no parity
-	serialParam.BaudRate = CBR_9600;
+	// Setting up parameters: Baud rate, 8 bits, 1 stop bit, no parity
+	serialParam.BaudRate = this->m_baudRate;
 	serialParam.ByteSize = 8;
 	serialParam.StopBits = ONESTOPBIT;
 	serialParam.Parity = NOPARITY;
@@ -126,8 +128,10 @@ void SerialHandler::close()
 int SerialHandler::read(const char* buffer, unsigned int bufferSize)
 {
 	unsigned int readSize = 0;
+	DWORD errors = 0;
 
-	ClearCommError(this->m_serialHandler, &this->m_dwByte, &this->m_status);
+	ClearCommError(this->m_serialHandler, &errors, &this->m_status);
+	this->countErrors(errors);
 
 	if (this->m_status.cbInQue > 0)
 	{
@@ -154,17 +158,81 @@ int SerialHandler::read(const char* buffer, unsigned int bufferSize)
  * @param buffer The buffer to write to the serial port
  * @param bufferSize The size of the buffer
  *
- * @return 1 - Write successful
- * @return -1 - Could not write to the serial port
+ * @return true - Write successful
+ * @return false - Could not write to the serial port
  */
 bool SerialHandler::write(const char* buffer, unsigned int bufferSize)
 {
 	if (!WriteFile(this->m_serialHandler, buffer, bufferSize, &this->m_dwByte, NULL))
 	{
 		std::cerr << "[Serial ERR]: could not write to serial port\n";
-		return -1;
+		return false;
 	}
-	return 1;
+	return true;
+}
+
+/**
+ * @brief Changes the baud rate of an open port and drops everything received at the old rate
+ *
+ * @param baudRate The new baud rate, any value the driver accepts (e.g. 250000 or 1000000 on FTDI / CH340)
+ *
+ * @return true - Baud rate changed
+ * @return false - Could not change the baud rate
+ */
+bool SerialHandler::setBaudRate(unsigned long baudRate)
+{
+	DCB serialParam = { 0 };
+	serialParam.DCBlength = sizeof(serialParam);
+
+	if (!GetCommState(this->m_serialHandler, &serialParam))
+	{
+		std::cerr << "[ Serial ERR ]: could not get serial port parameters\n";
+		return false;
+	}
+
+	serialParam.BaudRate = baudRate;
+	if (!SetCommState(this->m_serialHandler, &serialParam))
+	{
+		std::cerr << "[ Serial ERR ]: could not set baud rate " << baudRate << "\n";
+		return false;
+	}
+
+	this->m_baudRate = baudRate;
+	PurgeComm(this->m_serialHandler, PURGE_RXCLEAR | PURGE_TXCLEAR);
+	return true;
+}
+
+/**
+ * @brief Returns the baud rate the port is configured to
+ */
+unsigned long SerialHandler::getBaudRate()
+{
+	return this->m_baudRate;
+}
+
+/**
+ * @brief Returns the line error counters collected since the port was opened
+ */
+const SerialErrors& SerialHandler::getErrors()
+{
+	return this->m_errors;
+}
+
+/**
+ * @brief Adds the error flags reported by ClearCommError to the counters
+ *
+ * @param errors CE_* flags
+ */
+void SerialHandler::countErrors(DWORD errors)
+{
+	if (errors & CE_FRAME)
+		this->m_errors.frame++;
+	if (errors & CE_OVERRUN)
+		this->m_errors.overrun++;
+	if (errors & CE_RXPARITY)
+		this->m_errors.parity++;
+	if (errors & CE_RXOVER)
+		this->m_errors.rxOverflow++;
 }
 
 /**
@@ -3,23 +3,39 @@
 #include <iostream>
 
 
+typedef struct
+{
+	unsigned long frame;	  // CE_FRAME - Framing errors, usually a baud rate mismatch
+	unsigned long overrun;	  // CE_OVERRUN - Character buffer overrun in the UART
+	unsigned long parity;	  // CE_RXPARITY - Parity errors
+	unsigned long rxOverflow; // CE_RXOVER - Input buffer overflow
+} SerialErrors;
+
 class SerialHandler
 {
 public:
 	SerialHandler();
 	~SerialHandler();
 
-	int begin(const char* portName);
+	int begin(const char* portName, unsigned long baudRate = CBR_9600);
 	void close();
 
 	int read(const char* buffer, unsigned int bufferSize);
 	bool write(const char* buffer, unsigned int bufferSize);
 
+	bool setBaudRate(unsigned long baudRate);
+	unsigned long getBaudRate();
+	const SerialErrors& getErrors();
+
 	bool isConnected();
 
 private:
+	void countErrors(DWORD errors);
+
 	const char* m_portName = "";
 	bool m_connected = false;
+	unsigned long m_baudRate = CBR_9600;
+	SerialErrors m_errors = {};
 	HANDLE m_serialHandler;
 	COMSTAT m_status;
 	DWORD m_dwByte;
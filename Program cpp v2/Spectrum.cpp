@@ -0,0 +1,337 @@
+#include <cmath>
+#include <algorithm>
+#include "Spectrum.h"
+
+#define SPECTRUM_PI 3.14159265358979323846
+#define SPECTRUM_RANGE_DB 30.0f // [dB] Peaks weaker than the strongest one by this much are dropped (Hann side lobes are at -31 dB)
+
+/**
+ * @brief Construct a new spectrum object and builds the FFT tables
+ *
+ * @param size FFT points, rounded up to a power of two
+ */
+Spectrum::Spectrum(size_t size)
+{
+	this->m_size = 2;
+	this->m_log2Size = 1;
+	while (this->m_size < size)
+	{
+		this->m_size <<= 1;
+		this->m_log2Size++;
+	}
+
+	// Bit reversal permutation, applied while the input is windowed
+	this->m_reverse.resize(this->m_size);
+	for (size_t i = 0; i < this->m_size; i++)
+	{
+		uint32_t reversed = 0;
+		for (size_t bit = 0; bit < this->m_log2Size; bit++)
+			reversed |= ((i >> bit) & 1u) << (this->m_log2Size - 1 - bit);
+		this->m_reverse[i] = reversed;
+	}
+
+	// Twiddles of every radix-4 stage, W^k, W^2k and W^3k of W = exp(-2 pi i / 4m) for k < m
+	for (size_t m = (this->m_log2Size & 1) ? 2 : 1; m * 4 <= this->m_size; m *= 4)
+	{
+		size_t base = this->m_twiddles.size();
+		this->m_twiddles.resize(base + 6 * m);
+		float* tw = &this->m_twiddles[base];
+		for (size_t k = 0; k < m; k++)
+		{
+			for (size_t r = 1; r <= 3; r++)
+			{
+				double angle = -2.0 * SPECTRUM_PI * static_cast<double>(r * k) / static_cast<double>(4 * m);
+				tw[(2 * (r - 1)) * m + k] = static_cast<float>(std::cos(angle));
+				tw[(2 * (r - 1) + 1) * m + k] = static_cast<float>(std::sin(angle));
+			}
+		}
+	}
+
+	this->m_re.resize(this->m_size);
+	this->m_im.resize(this->m_size);
+	this->m_magnitudes.assign(this->m_size / 2 + 1, SPECTRUM_FLOOR_DB);
+	this->m_peaks.reserve(SPECTRUM_MAX_PEAKS + 1);
+}
+
+/**
+ * @brief Computes the spectrum of a block of samples.
+ *
+ * @details The mean is removed and the samples are Hann windowed. Inputs longer than size() are cut to their
+ * last size() samples, shorter ones are zero padded, which interpolates the spectrum but does not improve
+ * the resolution (rate / count).
+ *
+ * @param samples [ADC]
+ * @param count Number of samples
+ * @param rate [Hz] Sample rate
+ */
+void Spectrum::compute(const float* samples, size_t count, float rate)
+{
+	size_t length = std::min(count, this->m_size);
+	const float* input = samples + (count - length);
+	this->m_rate = rate;
+
+	if (this->m_window.size() != length)
+		this->buildWindow(length);
+
+	double sum = 0.0;
+	for (size_t i = 0; i < length; i++)
+		sum += input[i];
+	float mean = length > 0 ? static_cast<float>(sum / length) : 0.0f;
+
+	std::fill(this->m_re.begin(), this->m_re.end(), 0.0f);
+	std::fill(this->m_im.begin(), this->m_im.end(), 0.0f);
+	for (size_t i = 0; i < length; i++)
+		this->m_re[this->m_reverse[i]] = (input[i] - mean) * this->m_window[i];
+
+	this->transform();
+
+	// Sine amplitude of every bin: 2 |X| / sum(window)
+	float scale = this->m_windowGain > 0.0f ? 2.0f / this->m_windowGain : 0.0f;
+	for (size_t bin = 0; bin < this->m_magnitudes.size(); bin++)
+	{
+		float re = this->m_re[bin];
+		float im = this->m_im[bin];
+		float amplitude = std::sqrt(re * re + im * im) * scale;
+		this->m_magnitudes[bin] = std::max(20.0f * std::log10(amplitude + 1e-9f), SPECTRUM_FLOOR_DB);
+	}
+
+	this->findPeaks();
+}
+
+/**
+ * @brief In place FFT of m_re / m_im, the input is already in bit reversed order.
+ */
+void Spectrum::transform()
+{
+	float* re = this->m_re.data();
+	float* im = this->m_im.data();
+	size_t n = this->m_size;
+	size_t m = 1;
+
+	// Odd powers of two start with one radix-2 stage
+	if (this->m_log2Size & 1)
+	{
+		for (size_t i = 0; i < n; i += 2)
+		{
+			float aRe = re[i], aIm = im[i];
+			re[i] = aRe + re[i + 1];
+			im[i] = aIm + im[i + 1];
+			re[i + 1] = aRe - re[i + 1];
+			im[i + 1] = aIm - im[i + 1];
+		}
+		m = 2;
+	}
+
+	// Radix-4 stages: four sub-transforms of m points into one of 4m points. In bit reversed order the four
+	// blocks hold the samples 4n, 4n + 2, 4n + 1 and 4n + 3 of the group.
+	const float* tw = this->m_twiddles.data();
+	for (; m * 4 <= n; m *= 4)
+	{
+		const float* w1Re = tw;
+		const float* w1Im = tw + m;
+		const float* w2Re = tw + 2 * m;
+		const float* w2Im = tw + 3 * m;
+		const float* w3Re = tw + 4 * m;
+		const float* w3Im = tw + 5 * m;
+
+		for (size_t group = 0; group < n; group += 4 * m)
+		{
+			float* re0 = re + group;
+			float* im0 = im + group;
+			float* re1 = re0 + m;
+			float* im1 = im0 + m;
+			float* re2 = re1 + m;
+			float* im2 = im1 + m;
+			float* re3 = re2 + m;
+			float* im3 = im2 + m;
+
+			for (size_t k = 0; k < m; k++)
+			{
+				float aRe = re0[k], aIm = im0[k];
+				float bRe = re1[k] * w2Re[k] - im1[k] * w2Im[k];
+				float bIm = re1[k] * w2Im[k] + im1[k] * w2Re[k];
+				float cRe = re2[k] * w1Re[k] - im2[k] * w1Im[k];
+				float cIm = re2[k] * w1Im[k] + im2[k] * w1Re[k];
+				float dRe = re3[k] * w3Re[k] - im3[k] * w3Im[k];
+				float dIm = re3[k] * w3Im[k] + im3[k] * w3Re[k];
+
+				float t0Re = aRe + bRe, t0Im = aIm + bIm;
+				float t1Re = aRe - bRe, t1Im = aIm - bIm;
+				float t2Re = cRe + dRe, t2Im = cIm + dIm;
+				float t3Re = cRe - dRe, t3Im = cIm - dIm;
+
+				re0[k] = t0Re + t2Re;
+				im0[k] = t0Im + t2Im;
+				re1[k] = t1Re + t3Im; // t1 - j t3
+				im1[k] = t1Im - t3Re;
+				re2[k] = t0Re - t2Re;
+				im2[k] = t0Im - t2Im;
+				re3[k] = t1Re - t3Im; // t1 + j t3
+				im3[k] = t1Im + t3Re;
+			}
+		}
+		tw += 6 * m;
+	}
+}
+
+/**
+ * @brief Periodic Hann window for inputs of the given length
+ *
+ * @param length
+ */
+void Spectrum::buildWindow(size_t length)
+{
+	this->m_window.resize(length);
+	this->m_windowGain = 0.0f;
+	for (size_t i = 0; i < length; i++)
+	{
+		this->m_window[i] = length > 1 ? static_cast<float>(0.5 - 0.5 * std::cos(2.0 * SPECTRUM_PI * i / length)) : 1.0f;
+		this->m_windowGain += this->m_window[i];
+	}
+}
+
+/**
+ * @brief Keeps the strongest local maxima of the spectrum.
+ *
+ * @details A peak has to be the maximum of its Hann main lobe (+-2 bins of the unpadded input) and is refined
+ * with a parabola through the dB values of its neighbours.
+ */
+void Spectrum::findPeaks()
+{
+	this->m_peaks.clear();
+
+	const std::vector<float>& db = this->m_magnitudes;
+	size_t lobe = this->m_window.empty() ? 2 : std::max<size_t>(2 * this->m_size / this->m_window.size(), 1);
+	for (size_t bin = 1; bin + 1 < db.size(); bin++)
+	{
+		if (db[bin] < SPECTRUM_FLOOR_DB + SPECTRUM_PEAK_DB || db[bin] <= db[bin - 1] || db[bin] < db[bin + 1])
+			continue;
+
+		size_t begin = bin > lobe ? bin - lobe : 0;
+		size_t end = std::min(bin + lobe + 1, db.size());
+		if (*std::max_element(db.begin() + begin, db.begin() + end) > db[bin])
+			continue;
+
+		float alpha = db[bin - 1], beta = db[bin], gamma = db[bin + 1];
+		float denominator = alpha - 2.0f * beta + gamma;
+		float offset = denominator != 0.0f ? 0.5f * (alpha - gamma) / denominator : 0.0f;
+		float peakDb = beta - 0.25f * (alpha - gamma) * offset;
+
+		SpectrumPeak peak = { (bin + offset) * this->binFrequency(1), std::pow(10.0f, peakDb / 20.0f) };
+		this->m_peaks.push_back(peak);
+
+		// Keep the strongest ones, sorted by amplitude
+		std::sort(this->m_peaks.begin(), this->m_peaks.end(), [](const SpectrumPeak& a, const SpectrumPeak& b) { return a.amplitude > b.amplitude; });
+		if (this->m_peaks.size() > SPECTRUM_MAX_PEAKS)
+			this->m_peaks.pop_back();
+	}
+
+	// Drop what is only the side lobe of a much stronger peak
+	if (!this->m_peaks.empty())
+	{
+		float limit = this->m_peaks.front().amplitude * std::pow(10.0f, -SPECTRUM_RANGE_DB / 20.0f);
+		while (this->m_peaks.back().amplitude < limit)
+			this->m_peaks.pop_back();
+	}
+}
+
+/**
+ * @brief FFT points
+ */
+size_t Spectrum::size() const
+{
+	return this->m_size;
+}
+
+/**
+ * @brief Number of frequency bins, DC to Nyquist
+ */
+size_t Spectrum::bins() const
+{
+	return this->m_magnitudes.size();
+}
+
+/**
+ * @brief Center frequency of a bin [Hz]
+ */
+float Spectrum::binFrequency(size_t bin) const
+{
+	return bin * this->m_rate / this->m_size;
+}
+
+/**
+ * @brief Bin width of the last compute() [Hz], sample rate / FFT points
+ */
+float Spectrum::resolution() const
+{
+	return this->m_rate / this->m_size;
+}
+
+/**
+ * @brief true if the frequency is mains flicker (50 / 60 Hz or twice that).
+ *
+ * @note The tolerance is at least one bin (rate / size). Bins get wider with the burst rate, above 8192 Hz at 4096
+ * points (e.g. 2.44 Hz at BURST_MAX_RATE, 10 kHz) a single bin is wider than SPECTRUM_MAINS_TOLERANCE.
+ */
+bool Spectrum::isMains(float frequency) const
+{
+	const float mains[] = {50.0f, 60.0f, 100.0f, 120.0f};
+	float tolerance = std::max(SPECTRUM_MAINS_TOLERANCE, this->resolution());
+	for (float f : mains)
+	{
+		if (std::fabs(frequency - f) <= tolerance)
+			return true;
+	}
+	return false;
+}
+
+/**
+ * @brief Magnitude of every bin [dB re 1 ADC sine amplitude], SPECTRUM_FLOOR_DB at least
+ */
+const std::vector<float>& Spectrum::magnitudes() const
+{
+	return this->m_magnitudes;
+}
+
+/**
+ * @brief Strongest peaks of the last spectrum, strongest first
+ */
+const std::vector<SpectrumPeak>& Spectrum::peaks() const
+{
+	return this->m_peaks;
+}
+
+/**
+ * @brief Resamples the spectrum onto a logarithmic frequency axis from minFrequency to Nyquist.
+ *
+ * @details Every column gets the strongest bin it covers, or the nearest bin if it is narrower than a bin.
+ *
+ * @param minFrequency [Hz] Frequency of the first column
+ * @param columns Receives width magnitudes [dB]
+ * @param width
+ */
+void Spectrum::render(float minFrequency, float* columns, size_t width) const
+{
+	float nyquist = this->m_rate / 2.0f;
+	if (width == 0 || this->m_rate <= 0.0f || minFrequency <= 0.0f || minFrequency >= nyquist)
+	{
+		std::fill(columns, columns + width, SPECTRUM_FLOOR_DB);
+		return;
+	}
+
+	float binWidth = this->binFrequency(1);
+	float ratio = std::pow(nyquist / minFrequency, 1.0f / width);
+	float low = minFrequency;
+	for (size_t column = 0; column < width; column++)
+	{
+		float high = low * ratio;
+		size_t first = static_cast<size_t>(std::ceil(low / binWidth));
+		size_t last = std::min(static_cast<size_t>(high / binWidth), this->m_magnitudes.size() - 1);
+
+		if (first <= last)
+			columns[column] = *std::max_element(this->m_magnitudes.begin() + first, this->m_magnitudes.begin() + last + 1);
+		else
+			columns[column] = this->m_magnitudes[std::min(static_cast<size_t>(std::sqrt(low * high) / binWidth + 0.5f), this->m_magnitudes.size() - 1)];
+		low = high;
+	}
+}
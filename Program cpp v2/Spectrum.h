@@ -0,0 +1,58 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+#define SPECTRUM_SIZE 4096		 // FFT points, shorter inputs are zero padded
+#define SPECTRUM_MAX_PEAKS 3	 // Strongest peaks kept per spectrum
+#define SPECTRUM_FLOOR_DB -20.0f // [dB re 1 ADC] Magnitudes are clamped to this
+#define SPECTRUM_PEAK_DB 6.0f	 // [dB] A peak has to stand out this much from the floor
+#define SPECTRUM_MAINS_TOLERANCE 2.0f // [Hz] A peak this close to 50/60 Hz or their double counts as mains flicker, one bin at least
+
+// One spectral line found by Spectrum::compute
+typedef struct
+{
+	float frequency; // [Hz] Interpolated between bins
+	float amplitude; // [ADC] Sine amplitude
+} SpectrumPeak;
+
+// Hann windowed magnitude spectrum of a real signal.
+// Radix-4 (plus one radix-2 stage for odd powers of two) decimation in time FFT. Real and imaginary parts are kept
+// in separate arrays and every stage has its own contiguous twiddle table, so the butterfly loops run with unit
+// stride and the compiler can vectorize them. Tables are built once per size, compute() does not allocate.
+class Spectrum
+{
+public:
+	Spectrum(size_t size = SPECTRUM_SIZE);
+
+	void compute(const float* samples, size_t count, float rate);
+
+	size_t size() const;
+	size_t bins() const;
+	float binFrequency(size_t bin) const;
+	float resolution() const;
+	bool isMains(float frequency) const;
+	const std::vector<float>& magnitudes() const;
+	const std::vector<SpectrumPeak>& peaks() const;
+
+	void render(float minFrequency, float* columns, size_t width) const;
+
+private:
+	void transform();
+	void buildWindow(size_t length);
+	void findPeaks();
+
+	size_t m_size;
+	size_t m_log2Size;
+	float m_rate = 0.0f;
+
+	std::vector<uint32_t> m_reverse; // Bit reversed index of every input sample
+	std::vector<float> m_twiddles;	 // Per stage: w1, w2, w3 real and imaginary parts, one entry per butterfly
+	std::vector<float> m_window;	 // Hann window of the current input length
+	float m_windowGain = 0.0f;		 // Sum of the window, scales a bin back to sine amplitude
+
+	std::vector<float> m_re;
+	std::vector<float> m_im;
+	std::vector<float> m_magnitudes; // [dB re 1 ADC] size / 2 + 1 bins
+	std::vector<SpectrumPeak> m_peaks;
+};
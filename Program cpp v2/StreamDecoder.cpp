@@ -0,0 +1,167 @@
+#include <string.h>
+#include "StreamDecoder.h"
+
+/**
+ * @brief Reads one zigzag encoded varint and advances the cursor.
+ *
+ * @return false if the payload ended in the middle of the value
+ */
+static inline bool readZigzag(const uint8_t*& cursor, const uint8_t* end, int32_t* value)
+{
+	uint32_t raw = 0;
+	int shift = 0;
+
+	// Fast path, slowly changing readings are almost always a single byte
+	if (cursor < end && *cursor < 0x80)
+	{
+		raw = *cursor++;
+	}
+	else
+	{
+		while (true)
+		{
+			if (cursor >= end || shift > 28)
+				return false;
+			uint8_t byte = *cursor++;
+			raw |= (uint32_t)(byte & 0x7F) << shift;
+			if (byte < 0x80)
+				break;
+			shift += 7;
+		}
+	}
+
+	*value = (int32_t)(raw >> 1) ^ -(int32_t)(raw & 1);
+	return true;
+}
+
+/**
+ * @brief Reads one unsigned varint and advances the cursor.
+ *
+ * @return false if the payload ended in the middle of the value
+ */
+static inline bool readVarint(const uint8_t*& cursor, const uint8_t* end, uint32_t* value)
+{
+	uint32_t raw = 0;
+	int shift = 0;
+	while (true)
+	{
+		if (cursor >= end || shift > 28)
+			return false;
+		uint8_t byte = *cursor++;
+		raw |= (uint32_t)(byte & 0x7F) << shift;
+		if (byte < 0x80)
+			break;
+		shift += 7;
+	}
+	*value = raw;
+	return true;
+}
+
+/**
+ * @brief Construct a new stream decoder object
+ *
+ */
+StreamDecoder::StreamDecoder()
+{
+	this->reset();
+}
+
+/**
+ * @brief Decompresses one PACKET_STREAM_KEY or PACKET_STREAM_DELTA block.
+ *
+ * @details The first payload byte is a wrapping block counter, followed by the uint16 sequence number and the uint32
+ * device time [us] of the first sample. Every further sample starts with its time since the sample before it, the
+ * sequence numbers are consecutive. A delta block is only decodable if the block right before it was decoded, after a lost or broken block every delta block is dropped until the next
+ * keyframe arrives. Samples beyond maxSamples are decoded (to stay in sync) but not stored.
+ *
+ * @param type Packet type
+ * @param payload Packet payload
+ * @param payloadSize Payload size in bytes
+ * @param out Array receiving the decoded samples
+ * @param maxSamples Size of the out array
+ *
+ * @return The number of decoded samples
+ * @return 0 - Block dropped while waiting for a keyframe
+ * @return -1 - Malformed block or not a stream packet
+ */
+int StreamDecoder::decode(uint8_t type, const uint8_t* payload, size_t payloadSize, Sample* out, size_t maxSamples)
+{
+	if (payloadSize < STREAM_BLOCK_HEADER)
+		return -1;
+
+	uint8_t block = payload[0];
+	if (type == PACKET_STREAM_KEY)
+	{
+		this->m_lastSonic = 0;
+		this->m_lastPhoto = 0;
+		this->m_synced = true;
+	}
+	else if (type != PACKET_STREAM_DELTA)
+	{
+		return -1;
+	}
+
+	if (!this->m_synced || (type == PACKET_STREAM_DELTA && block != (uint8_t)(this->m_lastBlock + 1)))
+	{
+		this->m_synced = false;
+		this->m_droppedBlocks++;
+		return 0;
+	}
+
+	uint16_t sequence;
+	uint32_t time;
+	memcpy(&sequence, payload + 1, 2);
+	memcpy(&time, payload + 3, 4);
+
+	const uint8_t* cursor = payload + STREAM_BLOCK_HEADER;
+	const uint8_t* end = payload + payloadSize;
+	int32_t sonic = this->m_lastSonic;
+	int32_t photo = this->m_lastPhoto;
+	size_t count = 0;
+
+	for (size_t i = 0; cursor < end; i++)
+	{
+		int32_t dSonic, dPhoto;
+		uint32_t dTime = 0;
+		if ((i > 0 && !readVarint(cursor, end, &dTime)) || !readZigzag(cursor, end, &dSonic) || !readZigzag(cursor, end, &dPhoto))
+		{
+			this->m_synced = false;
+			this->m_droppedBlocks++;
+			return -1;
+		}
+		sonic += dSonic;
+		photo += dPhoto;
+		time += dTime;
+		if (count < maxSamples)
+		{
+			out[count].sonic = sonic * 0.01f;
+			out[count].photo = photo;
+			out[count].sequence = static_cast<uint16_t>(sequence + i);
+			out[count].time = time;
+			count++;
+		}
+	}
+
+	this->m_lastSonic = sonic;
+	this->m_lastPhoto = photo;
+	this->m_lastBlock = block;
+	return (int)count;
+}
+
+/**
+ * @brief Forgets the previous block, the next decodable block is a keyframe
+ */
+void StreamDecoder::reset()
+{
+	this->m_synced = false;
+	this->m_lastSonic = 0;
+	this->m_lastPhoto = 0;
+}
+
+/**
+ * @brief Number of blocks that could not be decoded
+ */
+uint64_t StreamDecoder::droppedBlocks() const
+{
+	return this->m_droppedBlocks;
+}
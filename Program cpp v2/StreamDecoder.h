@@ -0,0 +1,24 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "Protocol.h"
+
+#define STREAM_BLOCK_HEADER 7 // block counter, uint16 sequence, uint32 time [us]
+
+class StreamDecoder
+{
+public:
+	StreamDecoder();
+
+	int decode(uint8_t type, const uint8_t* payload, size_t payloadSize, Sample* out, size_t maxSamples);
+	void reset();
+
+	uint64_t droppedBlocks() const;
+
+private:
+	bool m_synced = false;
+	int32_t m_lastSonic = 0;
+	int32_t m_lastPhoto = 0;
+	uint8_t m_lastBlock = 0;
+	uint64_t m_droppedBlocks = 0;
+};
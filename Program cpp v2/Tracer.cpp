@@ -0,0 +1,140 @@
+#include "Tracer.h"
+#include <stdio.h>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+	struct Event
+	{
+		const char* name;
+		int64_t begin;	  // [ns] Since the start of the program
+		int64_t duration; // [ns]
+	};
+
+	// Ring of one thread, written only by that thread
+	struct ThreadBuffer
+	{
+		int id;
+		const char* name;
+		std::unique_ptr<Event[]> events{new Event[TRACE_BUFFER_EVENTS]};
+		std::atomic<uint64_t> count{0}; // Events ever written, published after the event
+	};
+
+	const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+	// Buffers are never freed, so the events of finished threads are still written
+	std::mutex buffersMutex;
+	std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+
+	thread_local ThreadBuffer* threadBuffer = nullptr;
+	thread_local const char* threadName = nullptr;
+
+	/**
+	 * @brief Buffer of the calling thread, registered at its first event
+	 */
+	ThreadBuffer* currentBuffer()
+	{
+		if (threadBuffer == nullptr)
+		{
+			std::lock_guard<std::mutex> lock(buffersMutex);
+			buffers.emplace_back(new ThreadBuffer);
+			threadBuffer = buffers.back().get();
+			threadBuffer->id = static_cast<int>(buffers.size());
+			threadBuffer->name = threadName;
+		}
+		return threadBuffer;
+	}
+}
+
+std::atomic<bool> Tracer::m_enabled{false};
+
+/**
+ * @brief Starts / stops recording, events already recorded are kept
+ */
+void Tracer::enable(bool enabled)
+{
+	m_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Names the calling thread in the trace, e.g. "render"
+ *
+ * @param name Literal
+ */
+void Tracer::setThreadName(const char* name)
+{
+	threadName = name;
+	if (threadBuffer != nullptr)
+		threadBuffer->name = name;
+}
+
+/**
+ * @brief Trace time base [ns], nanoseconds since the start of the program
+ */
+int64_t Tracer::now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+/**
+ * @brief Records one finished phase of the calling thread
+ *
+ * @param name Literal
+ * @param begin [ns] now() at the start of the phase
+ * @param end [ns] now() at the end of the phase
+ */
+void Tracer::complete(const char* name, int64_t begin, int64_t end)
+{
+	ThreadBuffer* buffer = currentBuffer();
+	uint64_t count = buffer->count.load(std::memory_order_relaxed);
+	Event& event = buffer->events[count % TRACE_BUFFER_EVENTS];
+	event.name = name;
+	event.begin = begin;
+	event.duration = end - begin;
+	buffer->count.store(count + 1, std::memory_order_release);
+}
+
+/**
+ * @brief Writes the events of every thread as Chrome trace event JSON.
+ *
+ * @details Threads keep recording meanwhile. A ring that wrapped is written from a bit after its oldest event,
+ * those slots may be overwritten during the write.
+ *
+ * @param path
+ *
+ * @return false if the file can not be written
+ */
+bool Tracer::write(const char* path)
+{
+	FILE* file = fopen(path, "w");
+	if (file == nullptr)
+		return false;
+
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	std::lock_guard<std::mutex> lock(buffersMutex);
+	bool first = true;
+	for (const std::unique_ptr<ThreadBuffer>& buffer : buffers)
+	{
+		if (buffer->name != nullptr)
+		{
+			fprintf(file, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", first ? "" : ",\n",
+					buffer->id, buffer->name);
+			first = false;
+		}
+
+		uint64_t count = buffer->count.load(std::memory_order_acquire);
+		uint64_t begin = count > TRACE_BUFFER_EVENTS ? count - TRACE_BUFFER_EVENTS + TRACE_BUFFER_EVENTS / 16 : 0;
+		for (uint64_t i = begin; i < count; i++)
+		{
+			const Event& event = buffer->events[i % TRACE_BUFFER_EVENTS];
+			fprintf(file, "%s{\"ph\":\"X\",\"name\":\"%s\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", first ? "" : ",\n", event.name,
+					buffer->id, event.begin * 1e-3, event.duration * 1e-3);
+			first = false;
+		}
+	}
+	fprintf(file, "\n]}\n");
+	return fclose(file) == 0;
+}
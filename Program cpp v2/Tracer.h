@@ -0,0 +1,62 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+#ifndef TRACE_ENABLED
+#define TRACE_ENABLED 1 // 0 compiles every TRACE_SCOPE out
+#endif
+#define TRACE_BUFFER_EVENTS 65536 // Events kept per thread, the oldest are overwritten
+
+// Records what every thread was doing as Chrome / Perfetto trace events (load the file in ui.perfetto.dev or
+// chrome://tracing). Each thread writes complete events ("X", begin time and duration) into its own ring, no
+// lock and no allocation after the first event of the thread. write() collects all rings into one JSON file.
+//
+// Tracing is off until enable(true), a disabled TRACE_SCOPE costs one relaxed load. Names must be literals.
+class Tracer
+{
+public:
+	static void enable(bool enabled);
+	static bool enabled()
+	{
+		return m_enabled.load(std::memory_order_relaxed);
+	}
+
+	static void setThreadName(const char* name);
+	static int64_t now();
+	static void complete(const char* name, int64_t begin, int64_t end);
+	static bool write(const char* path);
+
+private:
+	static std::atomic<bool> m_enabled;
+};
+
+// Times the enclosing block as one trace event
+class TraceScope
+{
+public:
+	TraceScope(const char* name) : m_name(name), m_begin(Tracer::enabled() ? Tracer::now() : -1)
+	{
+	}
+
+	~TraceScope()
+	{
+		if (this->m_begin >= 0)
+			Tracer::complete(this->m_name, this->m_begin, Tracer::now());
+	}
+
+	TraceScope(const TraceScope&) = delete;
+	TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+	const char* m_name;
+	int64_t m_begin; // [ns] -1 if tracing was off when the block was entered
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#if TRACE_ENABLED
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+#else
+#define TRACE_SCOPE(name)
+#endif
@@ -5,11 +5,61 @@
 #include <string.h>
 #include <vector>
 #include <cmath>
+#include <chrono>
+#include <csignal>
 #include "olcPixelGameEngine.h"
 #include "SerialHandler.h"
+#include "Protocol.h"
+#include "FrameParser.h"
+#include "StreamDecoder.h"
+#include "DeviceLink.h"
+#include "History.h"
+#include "BurstCapture.h"
+#include "Spectrum.h"
+#include "DeviceSession.h"
+#include "Logger.h"
+#include "LatencyHistogram.h"
+#include "Tracer.h"
 using namespace std;
 
 #define DATA_FRAME_SIZE 11
+#define READ_CHUNK_SIZE 256
+#define MAX_BLOCK_SAMPLES 64
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LogLevel::Info // LogLevel::Debug adds the per frame dumps
+#endif
+
+// Report on change settings sent with the D key
+#define DEADBAND_DISTANCE 0.5f	// [cm]
+#define DEADBAND_PHOTO 8		// [ADC]
+#define HEARTBEAT_INTERVAL 5000 // [ms]
+#define BURST_RATE 5000			// [Hz] Photo cell burst sample rate (B key)
+#define BURST_REPEAT_TIMEOUT 2.0 // [s] Repeated bursts (F key) are requested again if one got lost
+#define CLOCK_SYNC_INTERVAL 5.0	 // [s] Time exchange period for the device clock mapping
+
+// Headless mode (--headless)
+#define HEADLESS_STATS_INTERVAL 10.0 // [s] Stats line period
+#define HEADLESS_POLL_INTERVAL 5	 // [ms] Sleep when the port had nothing to read
+#define HEADLESS_STATS_FORMAT "%.3f %.1f samples/s, last %.2f cm %d, errors %llu (checksum %llu, line %lu), lost %llu +%llu, skew %+.0f ppm +-%.1f ms"
+
+// Pipeline latency histograms (L key overlay)
+#define LATENCY_DUMP_FILE "latency.txt" // Percentiles are appended here periodically
+#define LATENCY_DUMP_INTERVAL 10.0		// [s]
+#define LATENCY_RENDER_PENDING 4096		// Stored samples waiting for a frame, more are not timed
+
+// Trace export (--trace file), the signal writes the trace without stopping
+#ifdef SIGBREAK
+#define TRACE_SIGNAL SIGBREAK // Ctrl+Break
+#else
+#define TRACE_SIGNAL SIGUSR1
+#endif
+
+// Photo cell spectrum panel next to the graph
+#define SPECTRUM_PANEL_WIDTH 72
+#define SPECTRUM_PANEL_HEIGHT 40
+#define SPECTROGRAM_ROWS 40		// Bursts kept in the spectrogram above the spectrum
+#define SPECTRUM_MIN_FREQUENCY 10.0f // [Hz] Left edge of the logarithmic frequency axis
+#define SPECTRUM_TOP_DB 60.0f		// [dB re 1 ADC] Top of the panel
 
 #define SCREE_WIDTH 500
 #define SCREE_HEIGHT 500
@@ -27,15 +77,44 @@ using namespace std;
 #define sensorX2 REAL_SCREEN_WIDTH
 #define sensorY2 REAL_SCREEN_HEIGHT
 
-// Message structure
-typedef struct
+// Baud rates offered to the device after connecting at LINK_DEFAULT_BAUD, fastest first
+const unsigned long linkBaudRates[] = {1000000, 500000, 250000, 115200};
+
+// Pipeline intervals timed by the latency histograms
+enum LatencyStage
+{
+	LATENCY_DECODE, // Chunk read from the port -> frame complete
+	LATENCY_STORE,	// Frame complete -> sample in the history
+	LATENCY_RENDER, // Sample in the history -> graph drawn
+	LATENCY_TOTAL,	// Chunk read from the port -> graph drawn
+	LATENCY_STAGES
+};
+const char *const latencyStageNames[LATENCY_STAGES] = {"decode", "store", "render", "total"};
+
+// Set by Ctrl+C, SIGTERM or Ctrl+Break / console close in headless mode
+static volatile std::sig_atomic_t headlessStop = 0;
+
+// Trace file of --trace, nullptr if tracing is off
+static const char *tracePath = nullptr;
+static volatile std::sig_atomic_t traceRequested = 0; // Set by TRACE_SIGNAL
+
+/**
+ * @brief Stop handler of the headless mode
+ */
+static void onHeadlessSignal(int)
+{
+	headlessStop = 1;
+}
+
+/**
+ * @brief TRACE_SIGNAL handler. The MSVC CRT resets the handler to SIG_DFL before it calls it, so it installs
+ * itself again, otherwise the second signal would end the program.
+ */
+static void onTraceSignal(int signal)
 {
-	uint8_t start;		  // 1 byte - const 0x55
-	uint8_t sonicData[4]; // 4 bytes - Sonic sensor data (float)
-	uint8_t photoData[4]; // 4 bytes - Photo cell data (int)
-	uint8_t cs;			  // 1 byte - Check sum error handling
-	uint8_t end;		  // 1 byte - const 0xAA
-} Message;
+	std::signal(signal, onTraceSignal);
+	traceRequested = 1;
+}
 
 /*
 Screen: 500x500 pixel size: 2x2 => !250x250!
@@ -54,23 +133,69 @@ Sensor Data: (0, 40) - (250, 250)
 class Draw : public olc::PixelGameEngine
 {
 private:
+	Logger logger{stdout, LOG_LEVEL};
 	SerialHandler port;
+	DeviceLink link{port};
+	FrameParser parser;
+	StreamDecoder streamDecoder;
 	Message buffer;
 
 	const char *_portName = "\\\\.\\COM15";
 
+	char readBuffer[READ_CHUNK_SIZE];
 	char incomingData[DATA_FRAME_SIZE];
+	Sample blockSamples[MAX_BLOCK_SAMPLES];
 
 	float fSonicData = 0.0f;
+	float fSonicRaw = 0.0f; // [cm] Unfiltered distance from PACKET_SONIC_RAW
+	bool sonicFiltered = false;
 	int iPhotoData = 0;
 
-	int window = 200;
+	double window = 60.0; // [s] Plotted time span
+
+	uint32_t sampleInterval = 500; // [ms] Device sample interval, updated from PACKET_STATS
+	bool samplingPaused = false;
+	bool streamCompressed = false;
+	bool reportOnChange = false;
 
-	std::vector<float> sonicReadingVector;
-	std::vector<float> photoReadingVector;
+	std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+	std::chrono::system_clock::time_point startWallClock = std::chrono::system_clock::now();
+	History history;
+	std::vector<float> sonicArrayData; // [cm] Last distance of every sensor of a SonicArray
+	BurstCapture burstCapture;
+	DeviceSession session{history, [this](uint8_t type, const uint8_t *payload, uint8_t payloadSize)
+						  { return link.sendPacket(type, payload, payloadSize); }};
+	Spectrum spectrum;
+	std::vector<float> spectrogram = std::vector<float>(SPECTROGRAM_ROWS * SPECTRUM_PANEL_WIDTH, SPECTRUM_FLOOR_DB);
+	size_t spectrogramRow = 0; // Next row to overwrite, the oldest one
+	bool burstRepeat = false;
+	double burstRequested = 0.0; // [s] Time of the last burst request
+	uint64_t samplesAdded = 0;	 // Live values put into the history
+
+	// Pipeline latency [ns], see LatencyStage
+	struct RenderPending
+	{
+		int64_t read;	// Time the chunk was read
+		int64_t stored; // Time the sample went into the history
+	};
+	LatencyHistogram latency[LATENCY_STAGES];
+	std::vector<RenderPending> renderPending; // Samples stored since the last frame, empty in headless mode
+	bool rendering = false;
+	bool latencyOverlay = false;
+	double latencyDumped = 0.0; // [s] Time of the last dump
 
 	// Function prototypes
 	void handleIncommingData(void);
+	int handleIncommingPacket(void);
+	void handleSample(void);
+	void addSample(const Sample &sample, double arrival);
+	void handleDeviceStats(void);
+	void handleSonicArray(void);
+	void handleSonicRaw(void);
+	void handleBurstData(void);
+	void handleBacklog(void);
+	void handleTime(void);
+	void handleKeys(void);
 	void convertToMessage(float fSonicData, int iPhotoData, Message *buffer);
 	void decodeMessage(Message *buffer, float *fSonicData, int *iPhotoData);
 	bool parseMessage(const char *input, Message *buffer);
@@ -99,18 +224,22 @@ public:
 	// DRAW SETUP
 	bool OnUserCreate() override
 	{
-		std::cout << "[ port INFO ]: Starting a new port on: " << _portName << std::endl;
+		Tracer::setThreadName("pipeline");
+		logger.log(LogLevel::Info, "port", "Starting a new port on: %s", _portName);
 		port.begin(_portName); // Starting connection on port
 
 		// Wait for connection
 		while (port.isConnected() == false)
 		{
-			std::cout << "[ port ERR ]: Connection failed!" << std::endl;
+			logger.log(LogLevel::Error, "port", "Connection failed!");
 			Sleep(1000);
 			port.begin(_portName);
 		}
 
-		std::cout << "[ port OK ]: Connection established at port " << _portName << std::endl;
+		logger.log(LogLevel::Info, "port", "Connection established at port %s", _portName);
+
+		// Runs in receive(), the stats are requested once the link settled
+		link.negotiate(linkBaudRates, sizeof(linkBaudRates) / sizeof(linkBaudRates[0]));
 
 		return true;
 	}
@@ -118,18 +247,18 @@ public:
 	// DRAW UPDATE
 	bool OnUserUpdate(float fElapsedTime) override
 	{
+		TRACE_SCOPE("OnUserUpdate");
+
 		// Clear screen
 		Clear(olc::BLACK);
 
-		// Read sensor data from UART
-		int readResult = port.read(incomingData, DATA_FRAME_SIZE); // Reading from port into incomingData
-		// The got packet is the right size
-		if (readResult == DATA_FRAME_SIZE)
-			handleIncommingData();
+		// Device control from the keyboard
+		handleKeys();
 
-		// Add new sensor data to the beginning of the vector
-		sonicReadingVector.push_back(fSonicData);
-		photoReadingVector.push_back(iPhotoData);
+		// Read and decode what the device sent
+		receive();
+
+		TRACE_SCOPE("draw");
 
 		// Draw x and y axes
 		DrawLine(20, ScreenHeight() - 20, ScreenWidth() - 20, ScreenHeight() - 20, olc::WHITE); // X-axis
@@ -139,14 +268,306 @@ public:
 		DrawLine(0, 40, ScreenWidth(), 40);
 
 		// Draw sensor 1 readings
-		DrawSonic(sonicReadingVector, olc::GREEN);
+		DrawSonic(history, olc::GREEN);
 
 		// Draw sensor 2 readings
-		DrawPhoto(photoReadingVector, olc::BLUE);
+		DrawPhoto(history, olc::BLUE);
+
+		// Everything stored since the last frame is on the graph now
+		recordRendered();
+
+		// Sonic array readings next to the graph
+		DrawSonicArray(ScreenWidth() - 76, 50);
+
+		// Spectrum of the last photo cell burst under them
+		DrawSpectrum(ScreenWidth() - 76, ScreenHeight() - 50 - SPECTRUM_PANEL_HEIGHT - SPECTROGRAM_ROWS);
+
+		if (latencyOverlay)
+			DrawLatency(24, 52);
 
 		return true;
 	}
 
+	/**
+	 * @brief Reads one chunk from the port and runs it through the decode pipeline into the history, then does
+	 * the periodic link work. Shared by the window and the headless mode.
+	 *
+	 * @return int Number of bytes read
+	 */
+	int receive()
+	{
+		TRACE_SCOPE("receive");
+
+		// Read sensor data from UART and feed it through the frame parser
+		int readResult;
+		{
+			TRACE_SCOPE("read");
+			readResult = port.read(readBuffer, READ_CHUNK_SIZE);
+		}
+		int64_t readTime = nanos();
+		for (int i = 0; i < readResult; i++)
+		{
+			FrameType frameType = parser.push(static_cast<uint8_t>(readBuffer[i]));
+			if (frameType == FrameType::Pending)
+				continue;
+
+			TRACE_SCOPE("frame");
+			link.onFrame();
+			int64_t decodedTime = nanos();
+			uint64_t samples = samplesAdded;
+			latency[LATENCY_DECODE].record(decodedTime - readTime);
+
+			if (frameType == FrameType::Message)
+			{
+				memcpy(incomingData, parser.frame(), DATA_FRAME_SIZE);
+				handleIncommingData();
+				TRACE_SCOPE("store");
+				session.addMessage(now(), fSonicData, static_cast<float>(iPhotoData));
+				samplesAdded++;
+			}
+			else if (frameType == FrameType::Packet)
+			{
+				link.onPacket(parser.packetType(), parser.payload(), parser.payloadSize());
+				if (parser.packetType() == PACKET_SAMPLE)
+					handleSample();
+				else if (parser.packetType() == PACKET_STATS)
+					handleDeviceStats();
+				else if (parser.packetType() == PACKET_SONIC_ARRAY)
+					handleSonicArray();
+				else if (parser.packetType() == PACKET_SONIC_RAW)
+					handleSonicRaw();
+				else if (parser.packetType() == PACKET_BURST_DATA)
+					handleBurstData();
+				else if (parser.packetType() == PACKET_BACKLOG)
+					handleBacklog();
+				else if (parser.packetType() == PACKET_TIME)
+					handleTime();
+				handleIncommingPacket();
+			}
+
+			if (samplesAdded != samples)
+				recordStored(readTime, decodedTime, samplesAdded - samples);
+		}
+
+		// Negotiate and keep the baud rate alive, start over once the link settled at a new rate
+		if (link.service(getErrorCount()))
+		{
+			parser.reset();
+			streamDecoder.reset();
+			link.requestStats();
+		}
+
+		// Repeated bursts, request again if the last one got lost
+		if (burstRepeat && now() - burstRequested > BURST_REPEAT_TIMEOUT)
+			requestBurst();
+
+		// Bound the device clock mapping once samples arrive
+		if (session.clock().isSynced() && !link.isNegotiating() && now() - session.timeRequested() > CLOCK_SYNC_INTERVAL)
+			session.requestTime(now());
+
+		if (now() - latencyDumped >= LATENCY_DUMP_INTERVAL)
+			dumpLatency();
+
+		if (traceRequested)
+		{
+			traceRequested = 0;
+			writeTrace();
+		}
+
+		return readResult;
+	}
+
+	/**
+	 * @brief Times a frame that put samples into the history and keeps them for the render stage.
+	 *
+	 * @param readTime [ns] Time the chunk holding the frame was read
+	 * @param decodedTime [ns] Time the frame was complete
+	 * @param count Samples the frame stored
+	 */
+	void recordStored(int64_t readTime, int64_t decodedTime, uint64_t count)
+	{
+		int64_t storedTime = nanos();
+		latency[LATENCY_STORE].record(storedTime - decodedTime);
+		for (uint64_t i = 0; i < count && rendering && renderPending.size() < LATENCY_RENDER_PENDING; i++)
+			renderPending.push_back({readTime, storedTime});
+	}
+
+	/**
+	 * @brief Times the samples stored since the last frame, called once the graph is drawn.
+	 *
+	 * @note The frame is presented after OnUserUpdate returns, the vsync wait is not included.
+	 */
+	void recordRendered()
+	{
+		rendering = true;
+		int64_t renderedTime = nanos();
+		for (const RenderPending &pending : renderPending)
+		{
+			latency[LATENCY_RENDER].record(renderedTime - pending.stored);
+			latency[LATENCY_TOTAL].record(renderedTime - pending.read);
+		}
+		renderPending.clear();
+	}
+
+	/**
+	 * @brief Appends the percentiles of every stage since the start to LATENCY_DUMP_FILE.
+	 */
+	void dumpLatency()
+	{
+		TRACE_SCOPE("latency dump");
+		latencyDumped = now();
+		FILE *file = fopen(LATENCY_DUMP_FILE, "a");
+		if (file == nullptr)
+		{
+			logger.log(LogLevel::Warn, "Latency", "could not open " LATENCY_DUMP_FILE);
+			return;
+		}
+
+		for (int stage = 0; stage < LATENCY_STAGES; stage++)
+		{
+			const LatencyHistogram &histogram = latency[stage];
+			fprintf(file, "%.3f %-6s count %llu, p50 %.1f us, p99 %.1f us, p99.9 %.1f us, max %.1f us\n", wallClock(latencyDumped),
+					latencyStageNames[stage], static_cast<unsigned long long>(histogram.count()), histogram.percentile(50.0) * 1e-3,
+					histogram.percentile(99.0) * 1e-3, histogram.percentile(99.9) * 1e-3, histogram.max() * 1e-3);
+		}
+		fclose(file);
+	}
+
+	/**
+	 * @brief Writes the trace events recorded so far to the --trace file.
+	 */
+	void writeTrace()
+	{
+		if (tracePath == nullptr)
+			return;
+
+		if (Tracer::write(tracePath))
+			logger.log(LogLevel::Info, "Trace", "written to %s", tracePath);
+		else
+			logger.log(LogLevel::Error, "Trace", "could not write %s", tracePath);
+	}
+
+	/**
+	 * @brief Runs the receive pipeline without a window or GL context until Ctrl+C, SIGTERM or (without --trace)
+	 * Ctrl+Break, which the MSVC CRT also raises when the console is closed.
+	 *
+	 * @details The port is drained whenever it has data and polled every HEADLESS_POLL_INTERVAL otherwise. Every
+	 * HEADLESS_STATS_INTERVAL and once more on exit a stats line goes through the logger, or is appended to the
+	 * stats file.
+	 *
+	 * @param statsPath File to append the stats lines to, nullptr for the console
+	 *
+	 * @return int Process exit code
+	 */
+	int RunHeadless(const char *statsPath)
+	{
+		FILE *stats = nullptr;
+		if (statsPath != nullptr && (stats = fopen(statsPath, "a")) == nullptr)
+		{
+			std::cerr << "[ Headless ERR ]: could not open " << statsPath << std::endl;
+			return 1;
+		}
+
+		std::signal(SIGINT, onHeadlessSignal);
+		std::signal(SIGTERM, onHeadlessSignal);
+#ifdef SIGBREAK
+		if (tracePath == nullptr) // Otherwise Ctrl+Break writes the trace
+			std::signal(SIGBREAK, onHeadlessSignal);
+#endif
+		OnUserCreate();
+
+		double lastStats = now();
+		uint64_t lastSamples = samplesAdded;
+		while (!headlessStop)
+		{
+			// A full chunk means more is waiting, read on before sleeping
+			if (receive() < READ_CHUNK_SIZE)
+				Sleep(HEADLESS_POLL_INTERVAL);
+
+			double time = now();
+			if (time - lastStats >= HEADLESS_STATS_INTERVAL)
+			{
+				printHeadlessStats(stats, (samplesAdded - lastSamples) / (time - lastStats));
+				lastStats = time;
+				lastSamples = samplesAdded;
+			}
+		}
+
+		double time = now();
+		printHeadlessStats(stats, time > lastStats ? (samplesAdded - lastSamples) / (time - lastStats) : 0.0);
+		if (stats != nullptr)
+			fclose(stats);
+		return 0;
+	}
+
+	/**
+	 * @brief Writes one compact stats line: rate, last value, errors and losses.
+	 *
+	 * @details Without a stats file the line goes through the logger, so it does not interleave with the log
+	 * lines its writer thread prints to the console.
+	 *
+	 * @param file Stats file, nullptr for the console
+	 * @param rate [1/s] Samples per second since the last line
+	 */
+	void printHeadlessStats(FILE *file, double rate)
+	{
+		const SerialErrors &errors = port.getErrors();
+		double time = wallClock(now());
+		unsigned long long errorCount = getErrorCount();
+		unsigned long long checksumErrors = parser.stats().checksumErrors;
+		unsigned long lineErrors = errors.frame + errors.overrun + errors.parity + errors.rxOverflow;
+		unsigned long long lost = session.sequence().lost();
+		unsigned long long recovered = session.sequence().recovered();
+		double skew = session.clock().skew();
+		double clockError = session.clock().error() * 1e3;
+
+		if (file == nullptr)
+		{
+			logger.log(LogLevel::Info, "Headless", HEADLESS_STATS_FORMAT, time, rate, fSonicData, iPhotoData, errorCount,
+					   checksumErrors, lineErrors, lost, recovered, skew, clockError);
+			return;
+		}
+		fprintf(file, HEADLESS_STATS_FORMAT, time, rate, fSonicData, iPhotoData, errorCount, checksumErrors, lineErrors,
+				lost, recovered, skew, clockError);
+		fputc('\n', file);
+		fflush(file);
+	}
+
+	/**
+	 * @brief Seconds since the program started, the time base of the history.
+	 */
+	double now()
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+	}
+
+	/**
+	 * @brief Nanoseconds since the program started, the time base of the latency histograms.
+	 */
+	int64_t nanos()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+	}
+
+	/**
+	 * @brief Converts a history time to wall clock time, seconds since the Unix epoch.
+	 *
+	 * @note Boards logged by different hosts line up as far as the host clocks do.
+	 */
+	double wallClock(double time)
+	{
+		return std::chrono::duration<double>(startWallClock.time_since_epoch()).count() + time;
+	}
+
+	/**
+	 * @brief Sum of the line errors reported by the port and the check sum errors of the parser.
+	 */
+	uint64_t getErrorCount()
+	{
+		const SerialErrors &errors = port.getErrors();
+		return parser.stats().checksumErrors + errors.frame + errors.overrun + errors.parity + errors.rxOverflow;
+	}
+
 	/**
 	 * @brief Draws RAW HEX, Sonic and Photo data on the screen.
 	 *
@@ -156,6 +577,7 @@ public:
 	void DrawData(int x, int y)
 	{
 		DrawString(x, y, "Raw data: ", olc::WHITE);
+		DrawString(x + 100, y, "Link " + std::to_string(port.getBaudRate()) + " E:" + std::to_string(getErrorCount()), olc::WHITE);
 		int rawDataX = x, rawDataY = y + 10;
 		for (int i = 0; i < (sizeof(incomingData) / sizeof(incomingData[0])); i++)
 		{
@@ -165,60 +587,171 @@ public:
 		}
 
 		DrawString(x, y + 20, "Sonic data: " + std::to_string(fSonicData), olc::WHITE);
+		if (sonicFiltered)
+			DrawString(x + 260, y + 20, "Raw: " + std::to_string(fSonicRaw), olc::GREY);
+		DrawString(x + 180, y + 20, samplingPaused ? "PAUSED" : std::to_string(sampleInterval) + "ms", olc::WHITE);
 		DrawString(x, y + 30, "Photo data: " + std::to_string(iPhotoData), olc::WHITE);
+		if (session.sequence().received() > 0)
+			DrawString(x + 180, y + 30, "Lost " + std::to_string(session.sequence().lost()) + " +" + std::to_string(session.sequence().recovered()),
+					   session.sequence().lost() > session.sequence().recovered() ? olc::RED : olc::WHITE);
+		// Device clock skew and mapping error, grey until a time exchange bounds it
+		if (session.clock().isSynced())
+		{
+			char text[32];
+			snprintf(text, sizeof(text), "Clock %+.0fppm +-%.1fms", session.clock().skew(), session.clock().error() * 1e3);
+			DrawString(x + 22, y + 40, text, session.clock().isBounded() ? olc::WHITE : olc::GREY);
+		}
 	}
 
 	/**
-	 * @brief Draws the Sonic graph.
+	 * @brief Draws the p50 / p99 / p99.9 / max latency of every pipeline stage over the graph.
 	 *
-	 * @param sensorVector The vector containing the sensor data.
-	 * @param color The color of the line.
+	 * @param x The x-coordinate of the starting position.
+	 * @param y The y-coordinate of the starting position.
 	 */
-	void DrawSonic(const std::vector<float> &sensorVector, const olc::Pixel &color)
+	void DrawLatency(int x, int y)
 	{
-		int sensorSize = sensorVector.size();
+		FillRect(x, y, 200, 10 * (LATENCY_STAGES + 1) + 4, olc::BLACK);
+		DrawString(x + 2, y + 2, "[us]     p50   p99 p99.9   max", olc::YELLOW);
 
-		if (sensorSize < 2)
+		char text[48];
+		for (int stage = 0; stage < LATENCY_STAGES; stage++)
+		{
+			const LatencyHistogram &histogram = latency[stage];
+			snprintf(text, sizeof(text), "%-6s%6.0f%6.0f%6.0f%6.0f", latencyStageNames[stage], histogram.percentile(50.0) * 1e-3,
+					 histogram.percentile(99.0) * 1e-3, histogram.percentile(99.9) * 1e-3, histogram.max() * 1e-3);
+			DrawString(x + 2, y + 12 + stage * 10, text, olc::YELLOW);
+		}
+	}
+
+	/**
+	 * @brief Lists the last distance of every sensor of a SonicArray.
+	 *
+	 * @param x The x-coordinate of the starting position.
+	 * @param y The y-coordinate of the starting position.
+	 */
+	void DrawSonicArray(int x, int y)
+	{
+		char text[16];
+		for (size_t i = 0; i < sonicArrayData.size(); i++)
+		{
+			snprintf(text, sizeof(text), "%zu:%6.1f", i, sonicArrayData[i]);
+			DrawString(x, y + static_cast<int>(i) * 10, text, olc::GREEN);
+		}
+	}
+
+	/**
+	 * @brief Draws the spectrogram of the last bursts, the spectrum of the newest one and its peaks.
+	 *
+	 * @details Both share a logarithmic frequency axis from SPECTRUM_MIN_FREQUENCY to Nyquist. The newest
+	 * spectrogram row is at the bottom, right above the spectrum.
+	 *
+	 * @param x The x-coordinate of the starting position.
+	 * @param y The y-coordinate of the starting position.
+	 */
+	void DrawSpectrum(int x, int y)
+	{
+		if (!burstCapture.hasBurst())
 			return;
 
-		float xIncrement = (ScreenWidth() - 100) / static_cast<float>(sensorSize - 1);
-		float yIncrement = (ScreenHeight() - 100) / 35.0f;
+		float range = SPECTRUM_TOP_DB - SPECTRUM_FLOOR_DB;
+		for (int row = 0; row < SPECTROGRAM_ROWS; row++)
+		{
+			const float *columns = &spectrogram[((spectrogramRow + row) % SPECTROGRAM_ROWS) * SPECTRUM_PANEL_WIDTH];
+			for (int column = 0; column < SPECTRUM_PANEL_WIDTH; column++)
+			{
+				float level = std::min(std::max((columns[column] - SPECTRUM_FLOOR_DB) / range, 0.0f), 1.0f);
+				olc::PixelGameEngine::Draw(x + column, y + row, olc::Pixel(static_cast<uint8_t>(255 * level), static_cast<uint8_t>(255 * level * level), 0));
+			}
+		}
 
-		for (size_t i = 0; i < sensorSize - 1; ++i)
+		int baseline = y + SPECTROGRAM_ROWS + SPECTRUM_PANEL_HEIGHT;
+		const float *newest = &spectrogram[((spectrogramRow + SPECTROGRAM_ROWS - 1) % SPECTROGRAM_ROWS) * SPECTRUM_PANEL_WIDTH];
+		for (int column = 0; column < SPECTRUM_PANEL_WIDTH; column++)
 		{
-			int x1 = static_cast<int>(i * xIncrement);
-			int y1 = ScreenHeight() - 50 - static_cast<int>(sensorVector[i] * yIncrement);
-			int x2 = static_cast<int>((i + 1) * xIncrement);
-			int y2 = ScreenHeight() - 50 - static_cast<int>(sensorVector[i + 1] * yIncrement);
+			float level = std::min(std::max((newest[column] - SPECTRUM_FLOOR_DB) / range, 0.0f), 1.0f);
+			DrawLine(x + column, baseline, x + column, baseline - static_cast<int>(level * SPECTRUM_PANEL_HEIGHT), olc::BLUE);
+		}
 
-			DrawLine(x1 + 20, y1, x2 + 20, y2, color);
+		char text[16];
+		const std::vector<SpectrumPeak> &peaks = spectrum.peaks();
+		for (size_t i = 0; i < peaks.size(); i++)
+		{
+			snprintf(text, sizeof(text), "%6.1fHz", peaks[i].frequency);
+			DrawString(x, baseline + 2 + static_cast<int>(i) * 9, text, spectrum.isMains(peaks[i].frequency) ? olc::RED : olc::WHITE);
 		}
 	}
 
+	/**
+	 * @brief Asks the device for a photo cell burst.
+	 */
+	void requestBurst()
+	{
+		link.captureBurst(BURST_RATE);
+		burstRequested = now();
+	}
+
+	/**
+	 * @brief Draws the Sonic graph.
+	 *
+	 * @param sensorHistory The history containing the sensor data.
+	 * @param color The color of the line.
+	 */
+	void DrawSonic(const History &sensorHistory, const olc::Pixel &color)
+	{
+		DrawHistory(sensorHistory, &HistoryPoint::sonic, 35.0f, color);
+	}
+
 	/**
 	 * @brief Draws the Photo graph.
 	 *
-	 * @param sensorVector The vector containing the sensor data.
+	 * @param sensorHistory The history containing the sensor data.
 	 * @param color The color of the line.
 	 */
-	void DrawPhoto(const std::vector<float> &sensorVector, const olc::Pixel &color)
+	void DrawPhoto(const History &sensorHistory, const olc::Pixel &color)
 	{
-		int sensorSize = sensorVector.size();
+		DrawHistory(sensorHistory, &HistoryPoint::photo, 1024.0f, color);
+	}
 
-		if (sensorSize < 2)
+	/**
+	 * @brief Draws one channel of the last window seconds as a step graph.
+	 *
+	 * @details Every value is held until the next point, up to now. A quiet sensor in report on change mode
+	 * sends nothing, and its last value simply stays on the graph.
+	 *
+	 * @param sensorHistory The history containing the sensor data.
+	 * @param channel The channel to draw.
+	 * @param range The value drawn at the top of the graph.
+	 * @param color The color of the line.
+	 */
+	void DrawHistory(const History &sensorHistory, float HistoryPoint::*channel, float range, const olc::Pixel &color)
+	{
+		size_t size = sensorHistory.size();
+		if (size == 0)
 			return;
 
-		float xIncrement = (ScreenWidth() - 100) / static_cast<float>(sensorSize - 1);
-		float yIncrement = (ScreenHeight() - 100) / 1024.0f;
+		double end = now();
+		double begin = end - window;
+		float xIncrement = (ScreenWidth() - 100) / static_cast<float>(window);
+		float yIncrement = (ScreenHeight() - 100) / range;
 
-		for (size_t i = 0; i < sensorSize - 1; ++i)
+		for (size_t i = sensorHistory.find(begin); i < size; ++i)
 		{
-			int x1 = static_cast<int>(i * xIncrement);
-			int y1 = ScreenHeight() - 50 - static_cast<int>(sensorVector[i] * yIncrement);
-			int x2 = static_cast<int>((i + 1) * xIncrement);
-			int y2 = ScreenHeight() - 50 - static_cast<int>(sensorVector[i + 1] * yIncrement);
+			const HistoryPoint &point = sensorHistory.at(i);
+			double holdEnd = (i + 1 < size) ? sensorHistory.at(i + 1).time : end;
+			if (holdEnd < begin)
+				continue;
 
-			DrawLine(x1 + 20, y1, x2 + 20, y2, color);
+			int x1 = static_cast<int>((std::max(point.time, begin) - begin) * xIncrement);
+			int x2 = static_cast<int>((holdEnd - begin) * xIncrement);
+			int y1 = ScreenHeight() - 50 - static_cast<int>(point.*channel * yIncrement);
+
+			DrawLine(x1 + 20, y1, x2 + 20, y1, color);
+			if (i + 1 < size)
+			{
+				int y2 = ScreenHeight() - 50 - static_cast<int>(sensorHistory.at(i + 1).*channel * yIncrement);
+				DrawLine(x2 + 20, y1, x2 + 20, y2, color);
+			}
 		}
 	}
 };
@@ -231,13 +764,47 @@ public:
 | $$ | $$ | $$ /$$__  $$| $$| $$  | $$
 | $$ | $$ | $$|  $$$$$$$| $$| $$  | $$
 |__/ |__/ |__/ \_______/|__/|__/  |__/*/
-int main()
+int main(int argc, char *argv[])
 {
 	Draw diagrams;
-	if (diagrams.Construct(SCREE_WIDTH, SCREE_WIDTH, SCREE_PIXEL_SIZE, SCREE_PIXEL_SIZE))
+	bool headless = false;
+	const char *statsPath = nullptr;
+
+	// Program.exe [--headless [stats file]] [--trace trace.json]
+	for (int i = 1; i < argc; i++)
+	{
+		// Collection hosts without a display
+		if (strcmp(argv[i], "--headless") == 0)
+		{
+			headless = true;
+			if (i + 1 < argc && argv[i + 1][0] != '-')
+				statsPath = argv[++i];
+		}
+		// Pipeline trace, written on exit and on TRACE_SIGNAL
+		else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+		{
+			tracePath = argv[++i];
+		}
+	}
+
+	if (tracePath != nullptr)
+	{
+		Tracer::enable(true);
+		std::signal(TRACE_SIGNAL, onTraceSignal);
+	}
+
+	int result = 0;
+	if (headless)
+	{
+		result = diagrams.RunHeadless(statsPath);
+	}
+	else if (diagrams.Construct(SCREE_WIDTH, SCREE_WIDTH, SCREE_PIXEL_SIZE, SCREE_PIXEL_SIZE))
 	{
 		diagrams.Start();
 	}
+
+	diagrams.writeTrace();
+	return result;
 }
 
 /*/$$$$$$                                 /$$     /$$
@@ -256,14 +823,239 @@ void Draw::handleIncommingData(void)
 	// Writing out the data from the buffer
 	if (parseResult == 0)
 	{
-		for (int i = 0; i < sizeof(Message); i++)
-		{
-			printf("0x%02x ", ((uint8_t *)&buffer)[i]);
-		}
-		std::cout << std::endl;
+		logger.hex(LogLevel::Debug, "Frame", &buffer, sizeof(Message));
 		decodeMessage(&buffer, &fSonicData, &iPhotoData);
-		std::cout << "Sonic data: " << fSonicData << std::endl;
-		std::cout << "Photo data: " << iPhotoData << std::endl;
+		logger.log(LogLevel::Debug, "Frame", "Sonic data: %f, Photo data: %d", fSonicData, iPhotoData);
+	}
+}
+
+//==================================================================================================
+/**
+ * @brief Decompresses the stream packet held by the parser and appends its samples to the history.
+ * Other packet types are ignored.
+ *
+ * @return int The number of samples appended.
+ */
+int Draw::handleIncommingPacket(void)
+{
+	uint8_t type = parser.packetType();
+	if (type != PACKET_STREAM_KEY && type != PACKET_STREAM_DELTA)
+		return 0;
+
+	int count;
+	{
+		TRACE_SCOPE("decode");
+		count = streamDecoder.decode(type, parser.payload(), parser.payloadSize(), blockSamples, MAX_BLOCK_SAMPLES);
+	}
+
+	double arrival = now();
+	for (int i = 0; i < count; i++)
+	{
+		addSample(blockSamples[i], arrival);
+	}
+	return count > 0 ? count : 0;
+}
+
+//==================================================================================================
+/**
+ * @brief Appends the sample of a PACKET_SAMPLE to the history.
+ */
+void Draw::handleSample(void)
+{
+	Sample sample;
+	if (DeviceSession::parseSample(parser.payload(), parser.payloadSize(), &sample))
+		addSample(sample, now());
+}
+
+//==================================================================================================
+/**
+ * @brief Puts a live sample into the session (history, loss accounting, backlog requests) and shows it.
+ *
+ * @param sample The decoded sample.
+ * @param arrival Host time the sample arrived at.
+ */
+void Draw::addSample(const Sample &sample, double arrival)
+{
+	TRACE_SCOPE("store");
+	if (session.addSample(sample, arrival))
+		logger.log(LogLevel::Info, "Device", "sequence restarted, device reset");
+	samplesAdded++;
+
+	fSonicData = sample.sonic;
+	iPhotoData = sample.photo;
+}
+
+//==================================================================================================
+/**
+ * @brief Takes over the sampling state reported by the device and prints its counters.
+ */
+void Draw::handleDeviceStats(void)
+{
+	const DeviceStats &stats = link.getDeviceStats();
+	sampleInterval = stats.interval;
+	samplingPaused = (stats.flags & STATS_FLAG_PAUSED) != 0;
+	streamCompressed = (stats.flags & STATS_FLAG_COMPRESSED) != 0;
+	reportOnChange = (stats.flags & STATS_FLAG_REPORT_ON_CHANGE) != 0;
+
+	logger.log(LogLevel::Info, "Device",
+			   "interval %u ms%s%s%s, samples %u (%u sent), uptime %u ms, rx errors %u, tx dropped %u, rx overruns %u, "
+			   "rx frame errors %u",
+			   stats.interval, samplingPaused ? " (paused)" : "", streamCompressed ? " compressed" : "",
+			   reportOnChange ? " report on change" : "", stats.samples, stats.samplesSent, stats.uptime, stats.rxErrors,
+			   stats.txDropped, stats.rxOverruns, stats.rxFrameErrors);
+	logger.log(LogLevel::Info, "Host", "samples %llu, lost %llu in %llu gaps, recovered %llu, blocks dropped %llu, log dropped %llu",
+			   static_cast<unsigned long long>(session.sequence().received()), static_cast<unsigned long long>(session.sequence().lost()),
+			   static_cast<unsigned long long>(session.sequence().gaps()), static_cast<unsigned long long>(session.sequence().recovered()),
+			   static_cast<unsigned long long>(streamDecoder.droppedBlocks()), static_cast<unsigned long long>(logger.dropped()));
+}
+
+//==================================================================================================
+/**
+ * @brief Takes over the per-sensor distances of a PACKET_SONIC_ARRAY.
+ */
+void Draw::handleSonicArray(void)
+{
+	const uint8_t *payload = parser.payload();
+	size_t payloadSize = parser.payloadSize();
+	if (payloadSize < 1 || payloadSize < 1 + payload[0] * 2u)
+		return;
+
+	sonicArrayData.resize(payload[0]);
+	for (size_t i = 0; i < sonicArrayData.size(); i++)
+	{
+		uint16_t hundredths;
+		memcpy(&hundredths, payload + 1 + i * 2, 2);
+		sonicArrayData[i] = hundredths * 0.01f;
+	}
+}
+
+//==================================================================================================
+/**
+ * @brief Takes over the unfiltered distance of a PACKET_SONIC_RAW, the filtered one arrives with the sample.
+ */
+void Draw::handleSonicRaw(void)
+{
+	if (parser.payloadSize() < 4)
+		return;
+
+	uint16_t hundredths;
+	memcpy(&hundredths, parser.payload(), 2);
+	fSonicRaw = hundredths * 0.01f;
+	sonicFiltered = true;
+}
+
+//==================================================================================================
+/**
+ * @brief Collects the chunks of a photo cell burst.
+ */
+void Draw::handleBurstData(void)
+{
+	if (!burstCapture.add(parser.payload(), parser.payloadSize()))
+		return;
+
+	const Burst &burst = burstCapture.getBurst();
+	logger.log(LogLevel::Info, "Burst", "#%d, %zu samples at %u Hz", static_cast<int>(burst.id), burst.samples.size(),
+			   static_cast<unsigned>(burst.rate));
+
+	spectrum.compute(burst.samples.data(), burst.samples.size(), static_cast<float>(burst.rate));
+	spectrum.render(SPECTRUM_MIN_FREQUENCY, &spectrogram[spectrogramRow * SPECTRUM_PANEL_WIDTH], SPECTRUM_PANEL_WIDTH);
+	spectrogramRow = (spectrogramRow + 1) % SPECTROGRAM_ROWS;
+
+	for (const SpectrumPeak &peak : spectrum.peaks())
+	{
+		logger.log(LogLevel::Info, "Spectrum", "%.1f Hz, amplitude %.1f%s", peak.frequency, peak.amplitude,
+				   spectrum.isMains(peak.frequency) ? " (mains flicker)" : "");
+	}
+
+	if (burstRepeat)
+		requestBurst();
+}
+
+//==================================================================================================
+/**
+ * @brief Puts the missing samples of a PACKET_BACKLOG chunk into the history at the time they were taken.
+ */
+void Draw::handleBacklog(void)
+{
+	size_t recovered = session.handleBacklog(parser.payload(), parser.payloadSize(), now());
+	if (recovered > 0)
+		logger.log(LogLevel::Info, "Backlog", "%zu samples recovered", recovered);
+}
+
+//==================================================================================================
+/**
+ * @brief Completes a time exchange and logs the clock mapping.
+ */
+void Draw::handleTime(void)
+{
+	TimeExchange exchange;
+	if (!session.handleTime(parser.payload(), parser.payloadSize(), now(), &exchange))
+		return;
+
+	const DeviceClock &clock = session.clock();
+	logger.log(LogLevel::Info, "Clock", "round trip %.1f ms, skew %+.1f ppm, error %.2f ms, device %.3f s = %.3f",
+			   (exchange.received - exchange.sent) * 1e3, clock.skew(), clock.error() * 1e3, clock.deviceSeconds(exchange.deviceTime),
+			   wallClock(clock.toHost(exchange.deviceTime)));
+}
+
+//==================================================================================================
+/**
+ * @brief Sends device commands on key presses.
+ *
+ * UP / DOWN - Halve / double the sample interval
+ * P - Pause / resume sampling
+ * C - Toggle the compressed stream
+ * D - Toggle report on change (deadband) mode
+ * S - Request device stats
+ * B - Capture one photo cell burst
+ * F - Capture bursts continuously (flicker spectrum)
+ * L - Show / hide the pipeline latency overlay
+ */
+void Draw::handleKeys(void)
+{
+	// Kept within the limits the device accepts, a rejected value would leave the host out of step
+	if (GetKey(olc::Key::UP).bPressed && sampleInterval > SAMPLE_MIN_INTERVAL)
+	{
+		sampleInterval = sampleInterval / 2 < SAMPLE_MIN_INTERVAL ? SAMPLE_MIN_INTERVAL : sampleInterval / 2;
+		link.setInterval(sampleInterval);
+	}
+	if (GetKey(olc::Key::DOWN).bPressed && sampleInterval < SAMPLE_MAX_INTERVAL)
+	{
+		sampleInterval = sampleInterval > SAMPLE_MAX_INTERVAL / 2 ? SAMPLE_MAX_INTERVAL : sampleInterval * 2;
+		link.setInterval(sampleInterval);
+	}
+	if (GetKey(olc::Key::P).bPressed)
+	{
+		samplingPaused = !samplingPaused;
+		samplingPaused ? link.pause() : link.resume();
+	}
+	if (GetKey(olc::Key::C).bPressed)
+	{
+		streamCompressed = !streamCompressed;
+		link.setCompression(streamCompressed);
+	}
+	if (GetKey(olc::Key::D).bPressed)
+	{
+		reportOnChange = !reportOnChange;
+		link.setDeadband(DEADBAND_DISTANCE, DEADBAND_PHOTO, reportOnChange ? HEARTBEAT_INTERVAL : 0);
+	}
+	if (GetKey(olc::Key::S).bPressed)
+	{
+		link.requestStats();
+	}
+	if (GetKey(olc::Key::B).bPressed)
+	{
+		requestBurst();
+	}
+	if (GetKey(olc::Key::F).bPressed)
+	{
+		burstRepeat = !burstRepeat;
+		if (burstRepeat)
+			requestBurst();
+	}
+	if (GetKey(olc::Key::L).bPressed)
+	{
+		latencyOverlay = !latencyOverlay;
 	}
 }
 
@@ -319,10 +1111,10 @@ bool Draw::parseMessage(const char *input, Message *buffer)
 
 		// Error checking on incomming buffer
 		uint8_t checkSum = calculateCheckSum(buffer);
-		printf("Check sum: %d\n", checkSum);
+		logger.log(LogLevel::Debug, "Frame", "Check sum: %d", checkSum);
 		if (checkSum != buffer->cs)
 		{
-			printf("Check sum error on buffer!");
+			logger.log(LogLevel::Warn, "Frame", "Check sum error on buffer!");
 			return 1;
 		}
 		return 0;